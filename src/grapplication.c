@@ -2,42 +2,62 @@
 
 #include "config.h"
 #include "grcommandlist.h"
+#include "grstats.h"
 #include "grwindow.h"
 
 #include <glib-object.h>
 #include <glib.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
+#include <stdlib.h>
 
 struct _GrApplication
 {
 	GtkApplication parent_instance;
 
 	gboolean silent;
+	gboolean shell;
+	gboolean ignore_case;
+	gboolean lazy_index;
 	gint width;
 	gint height;
 	gint max_height;
 	gboolean max_height_set;
 	gchar* history_path;
+	gint history_size;
 	gboolean no_history;
 	gchar* config_path;
 	gboolean no_config;
+	GArray *history_sources;
 
 	GrWindow *window;
 	GrCommandList *com_list;
 };
 typedef struct _GrApplication GrApplication;
 
+/* a [History NAME] group of the config */
+struct _GrApplicationHistorySource
+{
+	gchar *path;
+	gboolean writable;
+	gdouble weight;
+};
+typedef struct _GrApplicationHistorySource GrApplicationHistorySource;
+
 enum _GrApplicationPropertyID
 {
 	PROP_0, /* 0 is reserved for GObject */
 
 	PROP_SILENT,
+	PROP_SHELL,
+	PROP_IGNORE_CASE,
+	PROP_LAZY_INDEX,
 	PROP_WIDTH,
 	PROP_HEIGHT,
 	PROP_MAX_HEIGHT,
 	PROP_MAX_HEIGHT_SET,
 	PROP_HISTORY_PATH,
+	PROP_HISTORY_SIZE,
 	PROP_NO_HISTORY,
 	PROP_CONFIG_PATH,
 	PROP_NO_CONFIG,
@@ -51,6 +71,15 @@ static GParamSpec *object_props[N_PROPS] = { NULL, };
 
 G_DEFINE_TYPE( GrApplication, gr_application, GTK_TYPE_APPLICATION )
 
+static void
+gr_application_history_source_clear(
+	gpointer data )
+{
+	GrApplicationHistorySource *source = (GrApplicationHistorySource*)data;
+
+	g_free( source->path );
+}
+
 static void
 gr_application_init(
 	GrApplication *self )
@@ -58,13 +87,18 @@ gr_application_init(
 	const GOptionEntry option_entries[]=
 	{
 		{ "silent", 's', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Do not show output", NULL },
+		{ "shell", 'S', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Run command through $SHELL -c", NULL },
+		{ "ignore-case", 'i', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Complete commands regardless of case", NULL },
+		{ "lazy-index", 'l', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Store the index of binaries and read its parts on demand", NULL },
 		{ "width", 'w', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, NULL, "Window width", "WIDTH" },
 		{ "height", 'h', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, NULL, "Window height", "HEIGHT" },
 		{ "max-height", 'm', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, NULL, "Window maximum height", "MAX_HEIGHT" },
 		{ "history-path", 'a', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, NULL, "Path to history file", "HISTORY_PATH" },
+		{ "history-size", 'n', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, NULL, "Maximum number of commands in history file, 0 is unlimited", "HISTORY_SIZE" },
 		{ "no-history", 'A', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Do not use history file", NULL },
 		{ "config", 'c', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, NULL, "Path to configure file", "CONFIG_PATH" },
 		{ "no-config", 'C', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, NULL, "Do not use configure file", NULL },
+		{ "stats", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, NULL, "Print statistics as text or json and exit", "FORMAT" },
 		{ NULL }
 	};
 
@@ -80,14 +114,20 @@ gr_application_init(
 	history_filename = g_filename_from_utf8( PROGRAM_HISTORY_FILE, -1, NULL, NULL, NULL );
 
 	self->silent = FALSE;
+	self->shell = FALSE;
+	self->ignore_case = FALSE;
+	self->lazy_index = FALSE;
 	self->width = MAIN_WINDOW_WIDTH;
 	self->height = MAIN_WINDOW_HEIGHT;
 	self->max_height = MAIN_WINDOW_MAX_HEIGHT;
 	self->max_height_set = FALSE;
 	self->history_path = g_build_filename( g_get_user_cache_dir(), program_name, history_filename, NULL );
+	self->history_size = HISTORY_SIZE;
 	self->no_history = FALSE;
 	self->config_path = g_build_filename( g_get_user_config_dir(), program_name, config_filename, NULL );
 	self->no_config = FALSE;
+	self->history_sources = g_array_new( FALSE, FALSE, sizeof( GrApplicationHistorySource ) );
+	g_array_set_clear_func( self->history_sources, gr_application_history_source_clear );
 
 	g_free( program_name );
 	g_free( config_filename );
@@ -116,6 +156,7 @@ gr_application_finalize(
 
 	g_free( self->history_path );
 	g_free( self->config_path );
+	g_array_unref( self->history_sources );
 
 	G_OBJECT_CLASS( gr_application_parent_class )->finalize( object );
 }
@@ -134,6 +175,15 @@ gr_application_get_property(
 		case PROP_SILENT:
 			g_value_set_boolean( value, self->silent );
 			break;
+		case PROP_SHELL:
+			g_value_set_boolean( value, self->shell );
+			break;
+		case PROP_IGNORE_CASE:
+			g_value_set_boolean( value, self->ignore_case );
+			break;
+		case PROP_LAZY_INDEX:
+			g_value_set_boolean( value, self->lazy_index );
+			break;
 		case PROP_WIDTH:
 			g_value_set_int( value, self->width );
 			break;
@@ -149,6 +199,9 @@ gr_application_get_property(
 		case PROP_HISTORY_PATH:
 			g_value_set_string( value, self->history_path );
 			break;
+		case PROP_HISTORY_SIZE:
+			g_value_set_int( value, self->history_size );
+			break;
 		case PROP_NO_HISTORY:
 			g_value_set_boolean( value, self->no_history );
 			break;
@@ -167,19 +220,76 @@ gr_application_get_property(
 	}
 }
 
+/* returns the statistics of the command list and of the process as text or as JSON */
+static gchar*
+gr_application_format_stats(
+	GrApplication *self,
+	gboolean json )
+{
+	GVariantBuilder builder, process_builder;
+	GVariant *stats, *latency;
+	gchar *str;
+
+	g_variant_builder_init( &process_builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &process_builder, "{sv}", "peak-rss", g_variant_new_uint64( gr_stats_get_peak_rss() ) );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "command-list", gr_command_list_get_stats( self->com_list ) );
+	g_variant_builder_add( &builder, "{sv}", "process", g_variant_builder_end( &process_builder ) );
+	latency = self->window != NULL ? gr_window_get_latency_stats( self->window ) : NULL;
+	if( latency != NULL )
+		g_variant_builder_add( &builder, "{sv}", "latency", latency );
+	stats = g_variant_ref_sink( g_variant_builder_end( &builder ) );
+
+	str = gr_stats_format( stats, json );
+	g_variant_unref( stats );
+
+	return str;
+}
+
+/* prints the statistics on the standard output of the instance, the parameter is "text" or "json" */
+static void
+gr_application_stats_activated(
+	GSimpleAction *action,
+	GVariant *parameter,
+	gpointer user_data )
+{
+	GrApplication *self = GR_APPLICATION( user_data );
+	gchar *str;
+
+	str = gr_application_format_stats( self, g_strcmp0( g_variant_get_string( parameter, NULL ), "json" ) == 0 );
+	g_print( "%s", str );
+	g_free( str );
+}
+
 static void
 gr_application_startup(
 	GApplication *app )
 {
+	const GActionEntry action_entries[] =
+	{
+		{ "stats", gr_application_stats_activated, "s", NULL, NULL, { 0 } }
+	};
+
 	GrApplication *self = GR_APPLICATION( app );
+	GrApplicationHistorySource *source;
+	guint i;
 
 	G_APPLICATION_CLASS( gr_application_parent_class )->startup( app );
 
 	/* create command list */
 	if( self->no_history )
-		self->com_list = gr_command_list_new( NULL );
+		self->com_list = gr_command_list_new( NULL, 0, self->lazy_index );
 	else
-		self->com_list = gr_command_list_new( self->history_path );
+		self->com_list = gr_command_list_new( self->history_path, (guint)self->history_size, self->lazy_index );
+	gr_command_list_set_ignore_case( self->com_list, self->ignore_case );
+	for( i = 0; !self->no_history && i < self->history_sources->len; ++i )
+	{
+		source = &g_array_index( self->history_sources, GrApplicationHistorySource, i );
+		gr_command_list_add_history_source( self->com_list, source->path, !source->writable, source->weight );
+	}
+
+	g_action_map_add_action_entries( G_ACTION_MAP( self ), action_entries, G_N_ELEMENTS( action_entries ), self );
 
 	/* create window */
 	self->window = gr_window_new( self );
@@ -193,15 +303,114 @@ gr_application_activate(
 
 	G_APPLICATION_CLASS( gr_application_parent_class )->activate( app );
 
+	/* a long running instance catches up with the commands run by the others */
+	gr_command_list_reload_history( self->com_list );
+
 	gtk_window_present( GTK_WINDOW( self->window ) );
 }
 
+/* the running instance answers --stats of another one on its command line, otherwise it is activated */
+static gint
+gr_application_command_line(
+	GApplication *app,
+	GApplicationCommandLine *command_line )
+{
+	GrApplication *self = GR_APPLICATION( app );
+	GVariantDict *options;
+	gchar *stats_format, *str;
+
+	options = g_application_command_line_get_options_dict( command_line );
+	if( g_variant_dict_lookup( options, "stats", "s", &stats_format ) )
+	{
+		str = gr_application_format_stats( self, g_strcmp0( stats_format, "json" ) == 0 );
+		g_application_command_line_print( command_line, "%s", str );
+		g_free( str );
+		g_free( stats_format );
+		return EXIT_SUCCESS;
+	}
+
+	g_application_activate( app );
+
+	return EXIT_SUCCESS;
+}
+
+/* every [History NAME] group is a history file merged with the history, read-only by default */
+static void
+gr_application_parse_history_sources(
+	GrApplication *self,
+	GKeyFile *key_file )
+{
+	GrApplicationHistorySource source;
+	GStrv groups;
+	gchar *path;
+	gboolean writable;
+	gdouble weight;
+	GError *error = NULL;
+	guint i;
+
+	groups = g_key_file_get_groups( key_file, NULL );
+	for( i = 0; groups[i] != NULL; ++i )
+	{
+		if( !g_str_has_prefix( groups[i], "History " ) )
+			continue;
+
+		path = g_key_file_get_string( key_file, groups[i], "path", &error );
+		if( error != NULL )
+		{
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+				"MESSAGE", "No path of [%s] in %s: %s", groups[i], self->config_path, error->message,
+				NULL );
+			g_clear_error( &error );
+			continue;
+		}
+
+		writable = g_key_file_get_boolean( key_file, groups[i], "writable", &error );
+		if( error != NULL )
+		{
+			g_clear_error( &error );
+			writable = FALSE;
+		}
+
+		weight = g_key_file_get_double( key_file, groups[i], "weight", &error );
+		if( error != NULL )
+		{
+			g_clear_error( &error );
+			weight = 1.0;
+		}
+		if( weight <= 0.0 )
+		{
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+				"MESSAGE", "Weight of [%s] in %s is not positive", groups[i], self->config_path,
+				NULL );
+			g_free( path );
+			continue;
+		}
+
+		source.path = g_filename_from_utf8( path, -1, NULL, NULL, &error );
+		if( source.path == NULL )
+		{
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+				"MESSAGE", "Path of [%s] in %s is not valid: %s", groups[i], self->config_path, error->message,
+				NULL );
+			g_clear_error( &error );
+			g_free( path );
+			continue;
+		}
+
+		source.writable = writable;
+		source.weight = weight;
+		g_array_append_val( self->history_sources, source );
+		g_free( path );
+	}
+	g_strfreev( groups );
+}
+
 static void
 gr_application_parse_config(
 	GrApplication *self )
 {
-	gboolean silent, no_history;
-	gint width, height, max_height;
+	gboolean silent, shell, ignore_case, lazy_index, no_history;
+	gint width, height, max_height, history_size;
 	gchar *history_path;
 	GKeyFile *key_file;
 	GError *error = NULL;
@@ -220,6 +429,24 @@ gr_application_parse_config(
 	else
 		self->silent = silent;
 
+	shell = g_key_file_get_boolean( key_file, "Main", "shell", &error );
+	if( error != NULL )
+		g_clear_error( &error );
+	else
+		self->shell = shell;
+
+	ignore_case = g_key_file_get_boolean( key_file, "Main", "ignore-case", &error );
+	if( error != NULL )
+		g_clear_error( &error );
+	else
+		self->ignore_case = ignore_case;
+
+	lazy_index = g_key_file_get_boolean( key_file, "Main", "lazy-index", &error );
+	if( error != NULL )
+		g_clear_error( &error );
+	else
+		self->lazy_index = lazy_index;
+
 	width = g_key_file_get_integer( key_file, "Main", "width", &error );
 	if( error != NULL )
 		g_clear_error( &error );
@@ -254,12 +481,24 @@ gr_application_parse_config(
 		g_free( history_path );
 	}
 
+	history_size = g_key_file_get_integer( key_file, "Main", "history-size", &error );
+	if( error != NULL )
+		g_clear_error( &error );
+	else if( history_size < 0 )
+		g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+			"MESSAGE", "History size in %s is negative", self->config_path,
+			NULL );
+	else
+		self->history_size = history_size;
+
 	no_history = g_key_file_get_boolean( key_file, "Main", "no-history", &error );
 	if( error != NULL )
 		g_clear_error( &error );
 	else
 		self->no_history = no_history;
 
+	gr_application_parse_history_sources( self, key_file );
+
 out:
 	g_key_file_free( key_file );
 }
@@ -270,7 +509,8 @@ gr_application_handle_local_options(
 	GVariantDict *options )
 {
 	GrApplication *self = GR_APPLICATION( app );
-	gchar *config_path, *history_path;
+	gchar *config_path, *history_path, *stats_format;
+	GError *error = NULL;
 
 	g_variant_dict_lookup( options, "no-config", "b", &self->no_config );
 
@@ -284,6 +524,9 @@ gr_application_handle_local_options(
 		gr_application_parse_config( self );
 
 	g_variant_dict_lookup( options, "silent", "b", &self->silent );
+	g_variant_dict_lookup( options, "shell", "b", &self->shell );
+	g_variant_dict_lookup( options, "ignore-case", "b", &self->ignore_case );
+	g_variant_dict_lookup( options, "lazy-index", "b", &self->lazy_index );
 	g_variant_dict_lookup( options, "width", "i", &self->width );
 
 	if( g_variant_dict_lookup( options, "height", "i", &self->height ) )
@@ -292,14 +535,52 @@ gr_application_handle_local_options(
 	if( g_variant_dict_lookup( options, "max-height", "i", &self->max_height ) )
 		self->max_height_set = TRUE;
 
+	g_variant_dict_lookup( options, "history-size", "i", &self->history_size );
 	g_variant_dict_lookup( options, "no-history", "b", &self->no_history );
 
+	/* 0 is unlimited, a negative size is not taken for it */
+	if( self->history_size < 0 )
+	{
+		g_printerr( "History size must not be negative: %d\n", self->history_size );
+		return EXIT_FAILURE;
+	}
+
 	if( g_variant_dict_lookup( options, "history-path", "^ay", &history_path ) )
 	{
 		g_free( self->history_path );
 		self->history_path = history_path;
 	}
 
+	/* print statistics instead of showing the window, a running instance prints its own ones
+	 * to this command line */
+	if( g_variant_dict_lookup( options, "stats", "s", &stats_format ) )
+	{
+		if( g_strcmp0( stats_format, "text" ) != 0 && g_strcmp0( stats_format, "json" ) != 0 )
+		{
+			g_printerr( "Unknown statistics format: %s\n", stats_format );
+			g_free( stats_format );
+			return EXIT_FAILURE;
+		}
+
+		if( !g_application_register( app, NULL, &error ) )
+		{
+			g_printerr( "%s\n", error->message );
+			g_error_free( error );
+			g_free( stats_format );
+			return EXIT_FAILURE;
+		}
+
+		if( g_application_get_is_remote( app ) )
+		{
+			g_free( stats_format );
+			return -1;
+		}
+
+		g_action_group_activate_action( G_ACTION_GROUP( app ), "stats", g_variant_new_string( stats_format ) );
+		g_free( stats_format );
+		return EXIT_SUCCESS;
+	}
+
 	return -1;
 }
 
@@ -320,6 +601,24 @@ gr_application_class_init(
 		"Do not show output",
 		FALSE,
 		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_SHELL] = g_param_spec_boolean(
+		"shell",
+		"Shell",
+		"Run command through $SHELL -c",
+		FALSE,
+		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_IGNORE_CASE] = g_param_spec_boolean(
+		"ignore-case",
+		"Ignoring case",
+		"Complete commands regardless of case",
+		FALSE,
+		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_LAZY_INDEX] = g_param_spec_boolean(
+		"lazy-index",
+		"Lazy index",
+		"Store the index of binaries and read its parts on demand",
+		FALSE,
+		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
 	object_props[PROP_WIDTH] = g_param_spec_int(
 		"width",
 		"Width",
@@ -356,6 +655,14 @@ gr_application_class_init(
 		"Path to history file",
 		NULL,
 		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_HISTORY_SIZE] = g_param_spec_int(
+		"history-size",
+		"History size",
+		"Maximum number of commands in history file, 0 is unlimited",
+		0,
+		G_MAXINT,
+		0,
+		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS );
 	object_props[PROP_NO_HISTORY] = g_param_spec_boolean(
 		"no-history",
 		"Not using history",
@@ -384,6 +691,7 @@ gr_application_class_init(
 
 	app_class->startup = gr_application_startup;
 	app_class->activate = gr_application_activate;
+	app_class->command_line = gr_application_command_line;
 	app_class->handle_local_options = gr_application_handle_local_options;
 }
 
@@ -393,7 +701,7 @@ gr_application_new(
 {
 	g_return_val_if_fail( g_application_id_is_valid( application_id ), NULL );
 
-	return GR_APPLICATION( g_object_new( GR_TYPE_APPLICATION, "application-id", application_id, "flags", G_APPLICATION_DEFAULT_FLAGS, NULL ) );
+	return GR_APPLICATION( g_object_new( GR_TYPE_APPLICATION, "application-id", application_id, "flags", G_APPLICATION_HANDLES_COMMAND_LINE, NULL ) );
 }
 
 gboolean
@@ -405,6 +713,33 @@ gr_application_get_silent(
 	return self->silent;
 }
 
+gboolean
+gr_application_get_shell(
+	GrApplication *self )
+{
+	g_return_val_if_fail( GR_IS_APPLICATION( self ), FALSE );
+
+	return self->shell;
+}
+
+gboolean
+gr_application_get_ignore_case(
+	GrApplication *self )
+{
+	g_return_val_if_fail( GR_IS_APPLICATION( self ), FALSE );
+
+	return self->ignore_case;
+}
+
+gboolean
+gr_application_get_lazy_index(
+	GrApplication *self )
+{
+	g_return_val_if_fail( GR_IS_APPLICATION( self ), FALSE );
+
+	return self->lazy_index;
+}
+
 gint
 gr_application_get_width(
 	GrApplication *self )
@@ -450,6 +785,15 @@ gr_application_get_history_path(
 	return g_strdup( self->history_path );
 }
 
+gint
+gr_application_get_history_size(
+	GrApplication *self )
+{
+	g_return_val_if_fail( GR_IS_APPLICATION( self ), 0 );
+
+	return self->history_size;
+}
+
 gboolean
 gr_application_get_no_history(
 	GrApplication *self )
@@ -15,12 +15,16 @@ G_DECLARE_FINAL_TYPE( GrApplication, gr_application, GR, APPLICATION, GtkApplica
 
 GrApplication* gr_application_new( const gchar *application_id );
 gboolean gr_application_get_silent( GrApplication *self );
+gboolean gr_application_get_shell( GrApplication *self );
+gboolean gr_application_get_ignore_case( GrApplication *self );
+gboolean gr_application_get_lazy_index( GrApplication *self );
 gint gr_application_get_width( GrApplication *self );
 gint gr_application_get_height( GrApplication *self );
 gint gr_application_get_max_height( GrApplication *self );
 gboolean gr_application_get_max_height_set( GrApplication *self );
 gchar* gr_application_get_cache_dir( GrApplication *self );
 gboolean gr_application_get_no_cache( GrApplication *self );
+gint gr_application_get_history_size( GrApplication *self );
 gchar* gr_application_get_config_path( GrApplication *self );
 gboolean gr_application_get_no_config( GrApplication *self );
 GrCommandList* gr_application_get_command_list( GrApplication *self );
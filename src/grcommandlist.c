@@ -1,19 +1,94 @@
 #include "grcommandlist.h"
 
 #include "config.h"
+#include "grcompletionprovider.h"
+#include "grdesktopindex.h"
+#include "grfileindex.h"
+#include "grhistory.h"
+#include "grhistorygroup.h"
+#include "grpathindex.h"
+#include "grquerycache.h"
 
 #include <glib-object.h>
 #include <glib.h>
 #include <gio/gio.h>
 
+/* the index of the system directories built by gtkrun-indexer */
+#ifdef SYSTEM_INDEX_DIR
+#define SYSTEM_INDEX_PATH SYSTEM_INDEX_DIR
+#else
+#define SYSTEM_INDEX_PATH NULL
+#endif
+
+/* completions asked of every provider first by a cursor without limit */
+#define COMMAND_LIST_FETCH_SIZE 64
+
+struct _GrCommandListProvider
+{
+	GrCompletionProvider *provider;
+	gint64 budget; /* microseconds */
+};
+typedef struct _GrCommandListProvider GrCommandListProvider;
+
+/* one query fanned out to all providers, shared with the worker threads */
+struct _GrCommandListQuery
+{
+	gint ref_count;
+
+	GMutex mutex;
+	GCond cond;
+
+	gchar *str;
+	guint limit;
+	GCancellable *cancellable;
+
+	guint n_providers;
+	gboolean *done;
+	GPtrArray **results;
+};
+typedef struct _GrCommandListQuery GrCommandListQuery;
+
+struct _GrCommandListTask
+{
+	GrCommandListQuery *query;
+	GrCompletionProvider *provider;
+	guint idx;
+};
+typedef struct _GrCommandListTask GrCommandListTask;
+
+/* the completions of a query merged by gr_command_list_query_next(), a source read up is asked for more */
+struct _GrCommandListCursor
+{
+	GrCommandList *com_list;
+	gchar *str;
+	gboolean fuzzy; /* the only source is the typo corrections */
+
+	guint n_sources;
+	GPtrArray **results; /* the completions fetched from every source, the best first, NULL if none */
+	guint *heads; /* the next completion of every source */
+	guint *limits; /* of the last fetch of every source, 0 if it has no more */
+
+	GHashTable *texts; /* returned already */
+	guint remaining; /* G_MAXUINT if unlimited */
+};
+
 struct _GrCommandList
 {
 	GObject parent_instance;
 
-	gchar *his_file_path;
+	GrHistory *history;
+	GrHistoryGroup *history_group; /* the history and the sources of the config */
+	GrPathIndex *path_index;
+	GrDesktopIndex *desktop_index;
+	GrFileIndex *file_index;
+	gboolean lazy_index;
 
-	GStrv his_arr;
-	GSList *env_list;
+	GArray *providers;
+	GThreadPool *pool;
+
+	/* completions of recent queries, NULL if disabled */
+	GrQueryCache *query_cache;
+	gchar *query_cache_path;
 };
 typedef struct _GrCommandList GrCommandList;
 
@@ -22,6 +97,9 @@ enum _GrCommandListPropertyID
 	PROP_0, /* 0 is reserved for GObject */
 
 	PROP_HISTORY_FILE_PATH,
+	PROP_HISTORY_SIZE,
+	PROP_IGNORE_CASE,
+	PROP_LAZY_INDEX,
 
 	N_PROPS
 };
@@ -31,108 +109,295 @@ static GParamSpec *object_props[N_PROPS] = { NULL, };
 
 G_DEFINE_TYPE( GrCommandList, gr_command_list, G_TYPE_OBJECT )
 
-static void
-gr_command_list_load_history_array(
-	GrCommandList *self )
+static gchar*
+gr_command_list_build_cache_path(
+	const gchar *filename )
 {
-	GFile *file;
-	gchar *text_locale, *text_utf8;
-	gsize size;
-	GStrv arr;
-	guint last_idx;
+	gchar *program_name, *cache_filename, *cache_path;
 
-	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+	program_name = g_filename_from_utf8( PROGRAM_NAME, -1, NULL, NULL, NULL );
+	cache_filename = g_filename_from_utf8( filename, -1, NULL, NULL, NULL );
+	cache_path = g_build_filename( g_get_user_cache_dir(), program_name, cache_filename, NULL );
+	g_free( program_name );
+	g_free( cache_filename );
 
-	/* if the file cannot be loaded, do nothing */
-	if( self->his_file_path == NULL )
-		return;
-	file = g_file_new_for_path( self->his_file_path );
-	if( !g_file_load_contents( file, NULL, &text_locale, &size, NULL, NULL ) )
-	{
-		g_object_unref( G_OBJECT( file ) );
-		return;
-	}
-	g_object_unref( G_OBJECT( file ) );
+	return cache_path;
+}
 
-	/* load array */
-	text_utf8 = g_locale_to_utf8( text_locale, size, NULL, NULL, NULL );
-	g_free( text_locale );
-	arr = g_strsplit( text_utf8, PROGRAM_LINE_BREAKER, -1 );
-	g_free( text_utf8 );
+static GrCommandListQuery*
+gr_command_list_query_new(
+	const gchar *str,
+	guint limit,
+	guint n_providers )
+{
+	GrCommandListQuery *query;
+
+	query = g_new( GrCommandListQuery, 1 );
+	query->ref_count = 1;
+	g_mutex_init( &query->mutex );
+	g_cond_init( &query->cond );
+	query->str = g_strdup( str );
+	query->limit = limit;
+	query->cancellable = g_cancellable_new();
+	query->n_providers = n_providers;
+	query->done = g_new0( gboolean, n_providers );
+	query->results = g_new0( GPtrArray*, n_providers );
+
+	return query;
+}
 
-	/* the last string may be zero-length, removing it */
-	last_idx = g_strv_length( arr ) - 1;
-	if( strlen( arr[last_idx] ) == 0 )
-	{
-		g_free( arr[last_idx] );
-		arr[last_idx] = NULL;
-	}
+static GrCommandListQuery*
+gr_command_list_query_ref(
+	GrCommandListQuery *query )
+{
+	g_atomic_int_inc( &query->ref_count );
 
-	g_strfreev( self->his_arr );
-	self->his_arr = arr;
+	return query;
 }
 
-static GSList*
-gr_command_list_load_environment_binaries_list(
-	const gchar *env_path )
+static void
+gr_command_list_query_unref(
+	GrCommandListQuery *query )
 {
-	const gchar env_delim[] = ":";
-	const gchar *env_str = NULL;
+	guint i;
 
-	GStrv env_arr, a;
-	GFile *dir;
-	GFileEnumerator *dir_enum;
-	GFileInfo *file_info;
-	GSList *list;
+	if( !g_atomic_int_dec_and_test( &query->ref_count ) )
+		return;
 
-	g_return_val_if_fail( env_path != NULL, NULL );
+	for( i = 0; i < query->n_providers; ++i )
+		if( query->results[i] != NULL )
+			g_ptr_array_unref( query->results[i] );
+
+	g_mutex_clear( &query->mutex );
+	g_cond_clear( &query->cond );
+	g_free( query->str );
+	g_object_unref( G_OBJECT( query->cancellable ) );
+	g_free( query->done );
+	g_free( query->results );
+	g_free( query );
+}
 
-	env_str = g_getenv( env_path );
-	if( env_str == NULL )
-		return NULL;
+static void
+gr_command_list_task_run(
+	gpointer data,
+	gpointer user_data )
+{
+	GrCommandListTask *task = (GrCommandListTask*)data;
+	GrCommandListQuery *query = task->query;
+	GPtrArray *results = NULL;
+
+	/* the caller may give up on the query before the task is started */
+	if( !g_cancellable_is_cancelled( query->cancellable ) )
+		results = gr_completion_provider_query( task->provider, query->str, query->limit, query->cancellable );
+
+	g_mutex_lock( &query->mutex );
+	query->results[task->idx] = results;
+	query->done[task->idx] = TRUE;
+	g_cond_broadcast( &query->cond );
+	g_mutex_unlock( &query->mutex );
+
+	gr_command_list_query_unref( query );
+	g_object_unref( G_OBJECT( task->provider ) );
+	g_free( task );
+}
+
+/*
+ * Query the providers concurrently, all of them or the only one if only is not G_MAXUINT. Each
+ * provider is waited for not longer than its budget, a provider missing its deadline is left out.
+ * Sets results to the arrays of GrCompletion of every queried provider, the best first, NULL if
+ * missed, not more than limit if it is not 0.
+ */
+static void
+gr_command_list_query_providers(
+	GrCommandList *self,
+	const gchar *str,
+	guint limit,
+	guint only,
+	GPtrArray **results )
+{
+	GrCommandListQuery *query;
+	GrCommandListProvider *p;
+	GrCommandListTask *task;
+	GrQueryCacheEntry *entry;
+	GPtrArray **cached;
+	guint64 *stamps;
+	gint64 start;
+	guint i;
+
+	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+	g_return_if_fail( results != NULL );
+
+	query = gr_command_list_query_new( str, limit, self->providers->len );
 
-	env_arr = g_strsplit( env_str, env_delim, -1 );
-	list = NULL;
-	for( a = env_arr; *a != NULL; ++a )
+	/* a provider not changed since the same query is not asked again */
+	entry = self->query_cache != NULL ? gr_query_cache_get( self->query_cache, str, limit ) : NULL;
+	stamps = g_new0( guint64, self->providers->len );
+	cached = g_new0( GPtrArray*, self->providers->len );
+
+	/* fan out */
+	start = g_get_monotonic_time();
+	for( i = 0; i < self->providers->len; ++i )
 	{
-		dir = g_file_new_for_path( *a );
-		dir_enum = g_file_enumerate_children( dir, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME, G_FILE_QUERY_INFO_NONE, NULL, NULL );
-		if( dir_enum == NULL )
-		{
-			g_object_unref( G_OBJECT( dir ) );
+		p = &g_array_index( self->providers, GrCommandListProvider, i );
+
+		if( only != G_MAXUINT && i != only )
 			continue;
-		}
 
-		while( TRUE )
+		if( entry != NULL )
 		{
-			if( !g_file_enumerator_iterate( dir_enum, &file_info, NULL, NULL, NULL ) )
-				break;
+			stamps[i] = gr_completion_provider_get_stamp( p->provider );
+			cached[i] = gr_query_cache_lookup( self->query_cache, entry, i, stamps[i] );
+			if( cached[i] != NULL )
+				continue;
+		}
+
+		task = g_new( GrCommandListTask, 1 );
+		task->query = gr_command_list_query_ref( query );
+		task->provider = GR_COMPLETION_PROVIDER( g_object_ref( G_OBJECT( p->provider ) ) );
+		task->idx = i;
+
+		/* if no pool available, query the provider right now */
+		if( self->pool == NULL )
+			gr_command_list_task_run( task, NULL );
+		else
+			g_thread_pool_push( self->pool, task, NULL );
+	}
+
+	/* collect results in the order of providers */
+	for( i = 0; i < self->providers->len; ++i )
+	{
+		p = &g_array_index( self->providers, GrCommandListProvider, i );
 
-			if( file_info == NULL )
-				break;
+		if( only != G_MAXUINT && i != only )
+			continue;
 
-			list = g_slist_insert_sorted( list, g_strdup( g_file_info_get_display_name( file_info ) ), (GCompareFunc)g_strcmp0 );
+		if( cached[i] != NULL )
+		{
+			results[i] = cached[i];
+			continue;
 		}
 
-		g_object_unref( G_OBJECT( dir_enum ) );
-		g_object_unref( G_OBJECT( dir ) );
+		g_mutex_lock( &query->mutex );
+		while( !query->done[i] && g_cond_wait_until( &query->cond, &query->mutex, start + p->budget ) );
+		results[i] = query->results[i];
+		query->results[i] = NULL;
+		if( !query->done[i] )
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+				"MESSAGE", "Completion provider %s missed its deadline", gr_completion_provider_get_name( p->provider ),
+				NULL );
+		g_mutex_unlock( &query->mutex );
+
+		if( results[i] != NULL && entry != NULL )
+			gr_query_cache_store( self->query_cache, entry, i, stamps[i], results[i] );
 	}
-	g_strfreev( env_arr );
+	g_free( stamps );
+	g_free( cached );
 
-	return list;
+	/* let late providers stop */
+	g_cancellable_cancel( query->cancellable );
+	gr_command_list_query_unref( query );
+}
+
+/* a typo is corrected in a command of three characters, two typos in a command of six */
+static GPtrArray*
+gr_command_list_query_fuzzy(
+	GrCommandList *self,
+	const gchar *str,
+	guint limit )
+{
+	gsize len;
+	guint max_distance;
+
+	/* arguments are not corrected */
+	len = strlen( str );
+	if( str[strcspn( str, " \t" )] != '\0' || len < 3 )
+		return g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+
+	max_distance = len < 6 ? 1 : 2;
+	max_distance = MIN( max_distance, TYPO_MAX_DISTANCE );
+
+	return gr_path_index_query_fuzzy( self->path_index, str, max_distance, limit );
+}
+
+static void
+gr_command_list_add_provider(
+	GrCommandList *self,
+	GrCompletionProvider *provider,
+	gint64 budget )
+{
+	GrCommandListProvider p;
+
+	p.provider = GR_COMPLETION_PROVIDER( g_object_ref( G_OBJECT( provider ) ) );
+	p.budget = budget;
+	g_array_append_val( self->providers, p );
 }
 
 static void
 gr_command_list_init(
 	GrCommandList *self )
 {
-	self->his_file_path = NULL;
+	self->history = gr_history_new( NULL, 0, FALSE );
+	self->history_group = gr_history_group_new();
+	self->path_index = NULL;
+	self->desktop_index = NULL;
+	self->file_index = NULL;
+	self->lazy_index = FALSE;
+	self->providers = NULL;
+	self->pool = NULL;
+	self->query_cache = NULL;
+	self->query_cache_path = NULL;
+}
+
+static void
+gr_command_list_constructed(
+	GObject *object )
+{
+	GrCommandList *self = GR_COMMAND_LIST( object );
+	GStrvBuilder *builder;
+	GStrv names;
+	gchar *cache_path, *store_path;
+	guint i;
+
+	/* a lazy index is stored, so the first keystroke maps a part of it instead of holding all of it */
+	cache_path = gr_command_list_build_cache_path( PROGRAM_SLOW_PATHS_FILE );
+	store_path = self->lazy_index ? gr_command_list_build_cache_path( PROGRAM_PATH_INDEX_DIR ) : NULL;
+	self->path_index = gr_path_index_new( PROGRAM_ENVIRONMENT_PATH, cache_path, store_path, SYSTEM_INDEX_PATH );
+	g_free( cache_path );
+	g_free( store_path );
 
-	/* setup empty command array */
-	self->his_arr = g_new( gchar*, 1 );
-	self->his_arr[0] = NULL;
+	cache_path = gr_command_list_build_cache_path( PROGRAM_DESKTOP_CACHE_FILE );
+	self->desktop_index = gr_desktop_index_new( cache_path );
+	g_free( cache_path );
 
-	self->env_list = gr_command_list_load_environment_binaries_list( PROGRAM_ENVIRONMENT_PATH );
+	self->file_index = gr_file_index_new();
+
+	gr_history_group_add( self->history_group, self->history, 1.0 );
+
+	/* the order of providers breaks ties of scores */
+	self->providers = g_array_new( FALSE, FALSE, sizeof( GrCommandListProvider ) );
+	gr_command_list_add_provider( self, GR_COMPLETION_PROVIDER( self->history_group ), COMPLETION_LATENCY_BUDGET * G_TIME_SPAN_MILLISECOND );
+	gr_command_list_add_provider( self, GR_COMPLETION_PROVIDER( self->file_index ), COMPLETION_LATENCY_BUDGET * G_TIME_SPAN_MILLISECOND );
+	gr_command_list_add_provider( self, GR_COMPLETION_PROVIDER( self->path_index ), COMPLETION_LATENCY_BUDGET * G_TIME_SPAN_MILLISECOND );
+	gr_command_list_add_provider( self, GR_COMPLETION_PROVIDER( self->desktop_index ), COMPLETION_LATENCY_BUDGET * G_TIME_SPAN_MILLISECOND );
+
+	self->pool = g_thread_pool_new( gr_command_list_task_run, NULL, (gint)self->providers->len, FALSE, NULL );
+
+	/* completions stored by the previous run answer the first keystrokes */
+	if( QUERY_CACHE_SIZE > 0 )
+	{
+		builder = g_strv_builder_new();
+		for( i = 0; i < self->providers->len; ++i )
+			g_strv_builder_add( builder, gr_completion_provider_get_name( g_array_index( self->providers, GrCommandListProvider, i ).provider ) );
+		names = g_strv_builder_end( builder );
+		g_strv_builder_unref( builder );
+
+		self->query_cache = gr_query_cache_new( QUERY_CACHE_SIZE, (const gchar* const*)names );
+		self->query_cache_path = gr_command_list_build_cache_path( PROGRAM_QUERY_CACHE_FILE );
+		gr_query_cache_load( self->query_cache, self->query_cache_path );
+		g_strfreev( names );
+	}
+
+	G_OBJECT_CLASS( gr_command_list_parent_class )->constructed( object );
 }
 
 static void
@@ -140,10 +405,28 @@ gr_command_list_finalize(
 	GObject *object )
 {
 	GrCommandList *self = GR_COMMAND_LIST( object );
+	guint i;
+
+	/* do not wait for late providers, they hold their own references */
+	if( self->pool != NULL )
+		g_thread_pool_free( self->pool, TRUE, FALSE );
 
-	g_free( self->his_file_path );
-	g_strfreev( self->his_arr );
-	g_slist_free_full( self->env_list, (GDestroyNotify)g_free );
+	if( self->query_cache != NULL )
+	{
+		gr_query_cache_save( self->query_cache, self->query_cache_path );
+		gr_query_cache_free( self->query_cache );
+	}
+	g_free( self->query_cache_path );
+
+	for( i = 0; i < self->providers->len; ++i )
+		g_object_unref( G_OBJECT( g_array_index( self->providers, GrCommandListProvider, i ).provider ) );
+	g_array_unref( self->providers );
+
+	g_object_unref( G_OBJECT( self->history ) );
+	g_object_unref( G_OBJECT( self->history_group ) );
+	g_object_unref( G_OBJECT( self->path_index ) );
+	g_object_unref( G_OBJECT( self->desktop_index ) );
+	g_object_unref( G_OBJECT( self->file_index ) );
 
 	G_OBJECT_CLASS( gr_command_list_parent_class )->finalize( object );
 }
@@ -160,7 +443,16 @@ gr_command_list_get_property(
 	switch( (GrCommandListPropertyID)prop_id )
 	{
 		case PROP_HISTORY_FILE_PATH:
-			g_value_set_string( value, self->his_file_path );
+			g_value_take_string( value, gr_history_get_file_path( self->history ) );
+			break;
+		case PROP_HISTORY_SIZE:
+			g_value_set_uint( value, gr_history_get_size( self->history ) );
+			break;
+		case PROP_IGNORE_CASE:
+			g_value_set_boolean( value, gr_command_list_get_ignore_case( self ) );
+			break;
+		case PROP_LAZY_INDEX:
+			g_value_set_boolean( value, self->lazy_index );
 			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
@@ -182,6 +474,15 @@ gr_command_list_set_property(
 		case PROP_HISTORY_FILE_PATH:
 			gr_command_list_set_history_file_path( self, g_value_get_string( value ) );
 			break;
+		case PROP_HISTORY_SIZE:
+			gr_command_list_set_history_size( self, g_value_get_uint( value ) );
+			break;
+		case PROP_IGNORE_CASE:
+			gr_command_list_set_ignore_case( self, g_value_get_boolean( value ) );
+			break;
+		case PROP_LAZY_INDEX:
+			self->lazy_index = g_value_get_boolean( value );
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
 			break;
@@ -194,6 +495,7 @@ gr_command_list_class_init(
 {
 	GObjectClass *object_class = G_OBJECT_CLASS( klass );
 
+	object_class->constructed = gr_command_list_constructed;
 	object_class->finalize = gr_command_list_finalize;
 	object_class->get_property = gr_command_list_get_property;
 	object_class->set_property = gr_command_list_set_property;
@@ -204,26 +506,37 @@ gr_command_list_class_init(
 		"Path to the file containing the list of commands",
 		NULL,
 		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_HISTORY_SIZE] = g_param_spec_uint(
+		"history-size",
+		"History size",
+		"Maximum number of commands in the history, 0 is unlimited",
+		0,
+		G_MAXUINT,
+		0,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_IGNORE_CASE] = g_param_spec_boolean(
+		"ignore-case",
+		"Ignoring case",
+		"Match commands regardless of case",
+		FALSE,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_LAZY_INDEX] = g_param_spec_boolean(
+		"lazy-index",
+		"Lazy index",
+		"Store the index of binaries and map its parts on demand",
+		FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
 	g_object_class_install_properties( object_class, N_PROPS, object_props );
 }
 
-static gint
-strncmp0(
-	const gchar *s1,
-	const gchar *s2,
-	gsize n )
-{
-	if( s1 == NULL || s2 == NULL )
-		return g_strcmp0( s1, s2 );
-
-	return strncmp( s1, s2, n );
-}
-
 GrCommandList*
 gr_command_list_new(
-	const gchar *his_file_path )
+	const gchar *his_file_path,
+	guint his_size,
+	gboolean lazy_index )
 {
-	return GR_COMMAND_LIST( g_object_new( GR_TYPE_COMMAND_LIST, "history-file-path", his_file_path, NULL ) );
+	/* the size goes first to be applied on loading */
+	return GR_COMMAND_LIST( g_object_new( GR_TYPE_COMMAND_LIST, "lazy-index", lazy_index, "history-size", his_size, "history-file-path", his_file_path, NULL ) );
 }
 
 gchar*
@@ -232,7 +545,7 @@ gr_command_list_get_history_file_path(
 {
 	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
 
-	return g_strdup( self->his_file_path );
+	return gr_history_get_file_path( self->history );
 }
 
 void
@@ -244,168 +557,490 @@ gr_command_list_set_history_file_path(
 
 	g_object_freeze_notify( G_OBJECT( self ) );
 
-	g_free( self->his_file_path );
-	self->his_file_path = g_strdup( path );
-	gr_command_list_load_history_array( self );
+	gr_history_set_file_path( self->history, path );
 
 	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_HISTORY_FILE_PATH] );
 
 	g_object_thaw_notify( G_OBJECT( self ) );
 }
 
+guint
+gr_command_list_get_history_size(
+	GrCommandList *self )
+{
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), 0 );
+
+	return gr_history_get_size( self->history );
+}
+
+void
+gr_command_list_set_history_size(
+	GrCommandList *self,
+	guint size )
+{
+	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+
+	g_object_freeze_notify( G_OBJECT( self ) );
+
+	gr_history_set_size( self->history, size );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_HISTORY_SIZE] );
+
+	g_object_thaw_notify( G_OBJECT( self ) );
+}
+
+gboolean
+gr_command_list_get_ignore_case(
+	GrCommandList *self )
+{
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), FALSE );
+
+	return gr_path_index_get_ignore_case( self->path_index );
+}
+
+/* the desktop entries are always matched regardless of case, the file names never */
+void
+gr_command_list_set_ignore_case(
+	GrCommandList *self,
+	gboolean ignore_case )
+{
+	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+
+	g_object_freeze_notify( G_OBJECT( self ) );
+
+	gr_history_group_set_ignore_case( self->history_group, ignore_case );
+	gr_path_index_set_ignore_case( self->path_index, ignore_case );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_IGNORE_CASE] );
+
+	g_object_thaw_notify( G_OBJECT( self ) );
+}
+
+/*
+ * Looks up the best completion starting with the len bytes of str among the providers, the
+ * highest score, the first provider among equal scores; if folded, str is a key matched
+ * against the keys folded by the providers on indexing. The completion is borrowed.
+ */
+static const gchar*
+gr_command_list_lookup(
+	GrCommandList *self,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	GrCompletionProvider *provider;
+	const gchar *best, *text;
+	gdouble text_score, best_score;
+	guint i;
+
+	best = NULL;
+	best_score = 0.0;
+	for( i = 0; len > 0 && i < self->providers->len; ++i )
+	{
+		provider = g_array_index( self->providers, GrCommandListProvider, i ).provider;
+		text = gr_completion_provider_lookup( provider, str, len, folded, &text_score );
+		if( text != NULL && ( best == NULL || text_score > best_score ) )
+		{
+			best = text;
+			best_score = text_score;
+		}
+	}
+
+	if( best != NULL && score != NULL )
+		*score = best_score;
+
+	return best;
+}
+
+/*
+ * Returns the completion of the highest score starting with str among all providers, the
+ * first provider among equal scores. The providers able to look a completion up are looked
+ * up like gr_command_list_lookup_compared_string() does. The others are asked for their best
+ * completion right here instead of in the worker threads, a query for one completion is
+ * cheap; they put the completions starting with str as it is first.
+ */
 gchar*
 gr_command_list_get_compared_string(
 	GrCommandList *self,
 	const gchar *str )
 {
-	gsize str_len;
-	GStrv a;
-	GSList *l;
-	gint res;
+	GrCompletionProvider *provider;
+	GPtrArray *completions;
+	GrCompletion *completion;
+	const gchar *s;
+	gchar *ret, *key;
+	gdouble best_score;
+	guint i;
 
 	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
 
 	if( str == NULL || *str == '\0' )
 		return NULL;
 
-	str_len = strlen( str );
+	/* list the directory of an argument for the next keystrokes */
+	gr_file_index_prefetch( self->file_index, str );
 
-	for( a = self->his_arr; *a != NULL; ++a )
-		if( strncmp0( *a, str, str_len ) == 0 )
-			return g_strdup( *a );
+	/* the typed text is folded once, the completions are matched by their own keys */
+	best_score = 0.0;
+	if( gr_command_list_get_ignore_case( self ) )
+	{
+		key = gr_completion_fold( str );
+		s = gr_command_list_lookup( self, key, strlen( key ), TRUE, &best_score );
+		g_free( key );
+	}
+	else
+		s = gr_command_list_lookup( self, str, strlen( str ), FALSE, &best_score );
+	ret = g_strdup( s );
 
-	for( l = self->env_list; l != NULL; l = l->next )
+	for( i = 0; i < self->providers->len; ++i )
 	{
-		res = strncmp0( (const gchar*)l->data, str, str_len );
+		provider = g_array_index( self->providers, GrCommandListProvider, i ).provider;
+		if( gr_completion_provider_can_lookup( provider ) )
+			continue;
 
-		if( res > 0 )
-			return NULL;
+		completions = gr_completion_provider_query( provider, str, 1, NULL );
+		if( completions == NULL )
+			continue;
 
-		if( res == 0 )
-			return g_strdup( (const gchar*)l->data );
+		completion = completions->len > 0 ? (GrCompletion*)g_ptr_array_index( completions, 0 ) : NULL;
+		if( completion != NULL && ( ret == NULL || completion->score > best_score ) &&
+			g_str_has_prefix( completion->text, str ) )
+		{
+			g_free( ret );
+			ret = g_strdup( completion->text );
+			best_score = completion->score;
+		}
+		g_ptr_array_unref( completions );
 	}
 
-	return NULL;
+	return ret;
 }
 
-GStrv
-gr_command_list_get_compared_array(
+/*
+ * Looks up the best command starting with the len bytes of str: *match is borrowed from the
+ * indexes and valid until the history is changed, NULL if none. Nothing is allocated, unless
+ * the case is ignored, then the typed text is folded once and matched against the keys the
+ * indexes have folded on loading. Returns FALSE, if str has arguments,
+ * gr_command_list_get_compared_string() completes them then.
+ */
+gboolean
+gr_command_list_lookup_compared_string(
 	GrCommandList *self,
-	const gchar *str )
+	const gchar *str,
+	gsize len,
+	const gchar **match,
+	gsize *match_len )
 {
-	gsize str_len, list_len;
-	GStrv arr, a;
-	GSList *l, *list;
-	gint res;
+	const gchar *s;
+	gchar *key;
+	gsize i;
 
-	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), FALSE );
+	g_return_val_if_fail( str != NULL, FALSE );
+	g_return_val_if_fail( match != NULL, FALSE );
 
-	if( str == NULL || *str == '\0' )
-		return NULL;
+	for( i = 0; i < len; ++i )
+		if( str[i] == ' ' || str[i] == '\t' )
+			return FALSE;
 
-	str_len = strlen( str );
+	if( len > 0 && gr_command_list_get_ignore_case( self ) )
+	{
+		key = gr_completion_fold_len( str, (gssize)len );
+		s = gr_command_list_lookup( self, key, strlen( key ), TRUE, NULL );
+		g_free( key );
+	}
+	else
+		s = gr_command_list_lookup( self, str, len, FALSE, NULL );
 
-	list = NULL;
-	list_len = 0;
-	for( a = self->his_arr; *a != NULL; ++a )
-		if( strncmp0( *a, str, str_len ) == 0 )
-		{
-			list = g_slist_prepend( list, *a );
-			++list_len;
-		}
+	*match = s;
+	if( match_len != NULL )
+		*match_len = s != NULL ? strlen( s ) : 0;
+
+	return TRUE;
+}
+
+/*
+ * Asks the i-th source of cursor for twice as many completions, if it has returned as many as asked.
+ * A provider is asked within its budget like by the first fetch, a provider missing it has no more.
+ */
+static void
+gr_command_list_cursor_fetch(
+	GrCommandListCursor *cursor,
+	guint i )
+{
+	GPtrArray *results, **fetched;
+	guint len, limit;
 
-	for( l = self->env_list; l != NULL; l = l->next )
+	len = cursor->results[i]->len;
+	if( cursor->limits[i] == 0 || len < cursor->limits[i] )
 	{
-		res = strncmp0( (const gchar*)l->data, str, str_len );
+		cursor->limits[i] = 0;
+		return;
+	}
 
-		if( res > 0 )
-			break;
+	/* doubled, so reading n completions costs the fetches of O(n) of them */
+	limit = cursor->limits[i] <= G_MAXUINT / 2 ? 2 * cursor->limits[i] : 0;
+	if( cursor->fuzzy )
+		results = gr_command_list_query_fuzzy( cursor->com_list, cursor->str, limit );
+	else
+	{
+		fetched = g_new0( GPtrArray*, cursor->n_sources );
+		gr_command_list_query_providers( cursor->com_list, cursor->str, limit, i, fetched );
+		results = fetched[i];
+		g_free( fetched );
+	}
+	cursor->limits[i] = limit;
+
+	if( results == NULL )
+	{
+		cursor->limits[i] = 0;
+		return;
+	}
+
+	/* the fetched ones are kept, the returned texts point to them */
+	g_ptr_array_remove_range( results, 0, MIN( len, results->len ) );
+	g_ptr_array_extend_and_steal( cursor->results[i], results );
+}
 
-		/* ignore a string already in the list */
-		if( res == 0 && g_slist_find_custom( list, (const gchar*)l->data, (GCompareFunc)g_strcmp0 ) == NULL )
+/* returns the best head of the sources not returned yet, the first source wins equal scores */
+static const gchar*
+gr_command_list_cursor_next(
+	GrCommandListCursor *cursor )
+{
+	GrCompletion *completion, *best;
+	guint i, best_i;
+
+	for( ;; )
+	{
+		best = NULL;
+		best_i = 0;
+		for( i = 0; i < cursor->n_sources; ++i )
 		{
-			list = g_slist_prepend( list, (gchar*)l->data );
-			++list_len;
+			if( cursor->results[i] == NULL )
+				continue;
+			if( cursor->heads[i] >= cursor->results[i]->len )
+				gr_command_list_cursor_fetch( cursor, i );
+			if( cursor->heads[i] >= cursor->results[i]->len )
+				continue;
+
+			completion = (GrCompletion*)g_ptr_array_index( cursor->results[i], cursor->heads[i] );
+			if( best == NULL || completion->score > best->score )
+			{
+				best = completion;
+				best_i = i;
+			}
 		}
+
+		if( best == NULL )
+			return NULL;
+
+		++cursor->heads[best_i];
+		if( g_hash_table_add( cursor->texts, best->text ) )
+			return best->text;
+	}
+}
+
+/*
+ * Starts reading the completions of str from offset, but not more than limit if it is not 0.
+ * The providers are asked for offset + limit completions first and for more only when they are
+ * read up, so the cost depends on the completions read, not on the number of matches.
+ * The cursor of an empty str returns no completions.
+ */
+GrCommandListCursor*
+gr_command_list_query_begin(
+	GrCommandList *self,
+	const gchar *str,
+	guint limit,
+	guint offset )
+{
+	GrCommandListCursor *cursor;
+	gboolean found;
+	guint i, n;
+
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
+
+	cursor = g_new0( GrCommandListCursor, 1 );
+	cursor->com_list = GR_COMMAND_LIST( g_object_ref( G_OBJECT( self ) ) );
+	cursor->str = g_strdup( str != NULL ? str : "" );
+	cursor->fuzzy = FALSE;
+	cursor->n_sources = self->providers->len;
+	cursor->results = g_new0( GPtrArray*, MAX( cursor->n_sources, 1 ) );
+	cursor->heads = g_new0( guint, MAX( cursor->n_sources, 1 ) );
+	cursor->limits = g_new0( guint, MAX( cursor->n_sources, 1 ) );
+	cursor->texts = g_hash_table_new( g_str_hash, g_str_equal );
+	cursor->remaining = limit > 0 ? limit : G_MAXUINT;
+
+	if( *cursor->str == '\0' )
+		return cursor;
+
+	/* an unlimited cursor fetches by pages too */
+	n = ( limit > 0 ? limit : COMMAND_LIST_FETCH_SIZE );
+	n = n <= G_MAXUINT - offset ? offset + n : 0;
+	gr_command_list_query_providers( self, cursor->str, n, G_MAXUINT, cursor->results );
+
+	found = FALSE;
+	for( i = 0; i < cursor->n_sources; ++i )
+	{
+		if( cursor->results[i] == NULL )
+			continue;
+		cursor->limits[i] = n;
+		found = found || cursor->results[i]->len > 0;
+	}
+
+	/* no command starts with str, it may be mistyped */
+	if( !found )
+	{
+		for( i = 0; i < cursor->n_sources; ++i )
+			g_clear_pointer( &cursor->results[i], g_ptr_array_unref );
+
+		cursor->fuzzy = TRUE;
+		cursor->n_sources = 1;
+		cursor->results[0] = gr_command_list_query_fuzzy( self, cursor->str, n );
+		cursor->limits[0] = n;
 	}
 
-	if( list == NULL )
+	for( i = 0; i < offset && gr_command_list_cursor_next( cursor ) != NULL; ++i );
+
+	return cursor;
+}
+
+/* returns the next completion, it is valid until the cursor is ended, NULL if no more */
+const gchar*
+gr_command_list_query_next(
+	GrCommandListCursor *cursor )
+{
+	const gchar *text;
+
+	g_return_val_if_fail( cursor != NULL, NULL );
+
+	if( cursor->remaining == 0 )
 		return NULL;
 
-	arr = g_new( gchar*, list_len + 1 );
-	arr[list_len] = NULL;
-	for( a = &arr[list_len-1], l = list; l != NULL ; l = l->next, --a )
-		*a = g_strdup( (const gchar*)l->data );
-	g_slist_free( list );
+	text = gr_command_list_cursor_next( cursor );
+	if( text != NULL && cursor->remaining != G_MAXUINT )
+		--cursor->remaining;
 
-	return arr;
+	return text;
 }
 
 void
-gr_command_list_push(
+gr_command_list_query_end(
+	GrCommandListCursor *cursor )
+{
+	guint i;
+
+	if( cursor == NULL )
+		return;
+
+	for( i = 0; i < cursor->n_sources; ++i )
+		g_clear_pointer( &cursor->results[i], g_ptr_array_unref );
+	g_free( cursor->results );
+	g_free( cursor->heads );
+	g_free( cursor->limits );
+	g_hash_table_unref( cursor->texts );
+	g_free( cursor->str );
+	g_object_unref( G_OBJECT( cursor->com_list ) );
+	g_free( cursor );
+}
+
+/*
+ * Pass file completions of the argument in str to chunk_func by chunks, they are not
+ * returned by gr_command_list_query_next(). Returns FALSE, if str has no argument.
+ */
+gboolean
+gr_command_list_get_compared_files_async(
 	GrCommandList *self,
-	const gchar *text )
+	const gchar *str,
+	GCancellable *cancellable,
+	GrFileIndexChunkFunc chunk_func,
+	gpointer user_data )
 {
-	GStrvBuilder *builder;
-	GStrv arr;
-	GFile *file, *dir;
-	gchar *s_locale, *s_utf8;
-	gsize s_locale_len;
-	GError *error = NULL;
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), FALSE );
 
-	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+	return gr_file_index_query_async( self->file_index, str, cancellable, chunk_func, user_data );
+}
 
-	/* nothing to push */
-	if( text == NULL || *text == '\0' )
-		return;
+GStrv
+gr_command_list_search_history(
+	GrCommandList *self,
+	const gchar *str )
+{
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
 
-	/* if his_arr already contains text, do nothing */
-	if( g_strv_contains( (const gchar**)self->his_arr, text ) )
-		return;
+	return gr_history_group_search( self->history_group, str, 0 );
+}
 
-	/* append text to array */
-	builder = g_strv_builder_new();
-	g_strv_builder_addv( builder, (const gchar**)self->his_arr );
-	g_strv_builder_add( builder, g_strdup( text ) );
-	arr = g_strv_builder_end( builder );
-	g_strv_builder_unref( builder );
+/* reads the commands appended to every history by other instances, see gr_history_reload() */
+gboolean
+gr_command_list_reload_history(
+	GrCommandList *self )
+{
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), FALSE );
 
-	g_strfreev( self->his_arr );
-	self->his_arr = arr;
+	return gr_history_group_reload( self->history_group );
+}
 
-	/* if no file path, array will not be stored */
-	if( self->his_file_path == NULL )
-		return;
+/*
+ * Adds the history file to complete with the history, before the first query. The frecencies
+ * of its commands are multiplied by weight. A read-only file is never written, so it may be
+ * shared by other users; the commands run are appended to the writable ones.
+ */
+void
+gr_command_list_add_history_source(
+	GrCommandList *self,
+	const gchar *path,
+	gboolean read_only,
+	gdouble weight )
+{
+	GrHistory *history;
 
-	/* store array to the file */
-	file = g_file_new_for_path( self->his_file_path );
+	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
+	g_return_if_fail( path != NULL );
+	g_return_if_fail( weight > 0.0 );
 
-	/* if it cannot create directory, it will not store array */
-	dir = g_file_get_parent( file );
-	g_file_make_directory_with_parents( dir, NULL, &error );
-	if( error != NULL )
-	{
-		if( error->code != G_IO_ERROR_EXISTS )
-		{
-			g_object_unref( G_OBJECT( dir ) );
-			g_object_unref( G_OBJECT( file ) );
-			g_clear_error( &error );
-			return;
-		}
-		g_clear_error( &error );
-	}
-	g_object_unref( G_OBJECT( dir ) );
+	history = gr_history_new( path, 0, read_only );
+	gr_history_set_ignore_case( history, gr_command_list_get_ignore_case( self ) );
+	gr_history_group_add( self->history_group, history, weight );
+	g_object_unref( G_OBJECT( history ) );
+}
 
-	s_locale = g_strjoinv( PROGRAM_LINE_BREAKER, self->his_arr );
-	s_utf8 = g_strconcat( s_locale, PROGRAM_LINE_BREAKER, NULL );
-	g_free( s_locale );
+GAppInfo*
+gr_command_list_get_app_info(
+	GrCommandList *self,
+	const gchar *text )
+{
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
 
-	s_locale = g_locale_from_utf8( s_utf8, -1, NULL, &s_locale_len, NULL );
-	g_free( s_utf8 );
+	return gr_desktop_index_get_app_info( self->desktop_index, text );
+}
 
-	g_file_replace_contents( file, s_locale, s_locale_len, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, NULL, NULL );
-	g_free( s_locale );
+void
+gr_command_list_push(
+	GrCommandList *self,
+	const gchar *text )
+{
+	g_return_if_fail( GR_IS_COMMAND_LIST( self ) );
 
-	g_object_unref( G_OBJECT( file ) );
+	gr_history_group_push( self->history_group, text );
 }
 
+/* Returns a{sv} of the statistics of every structure, see gr_stats_format() */
+GVariant*
+gr_command_list_get_stats(
+	GrCommandList *self )
+{
+	GVariantBuilder builder;
+
+	g_return_val_if_fail( GR_IS_COMMAND_LIST( self ), NULL );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "history", gr_history_group_get_stats( self->history_group ) );
+	g_variant_builder_add( &builder, "{sv}", "path", gr_path_index_get_stats( self->path_index ) );
+	g_variant_builder_add( &builder, "{sv}", "desktop", gr_desktop_index_get_stats( self->desktop_index ) );
+	g_variant_builder_add( &builder, "{sv}", "files", gr_file_index_get_stats( self->file_index ) );
+	if( self->query_cache != NULL )
+		g_variant_builder_add( &builder, "{sv}", "query-cache", gr_query_cache_get_stats( self->query_cache ) );
+
+	return g_variant_builder_end( &builder );
+}
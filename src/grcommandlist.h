@@ -1,6 +1,8 @@
 #ifndef GRCOMMANDLIST_H
 #define GRCOMMANDLIST_H
 
+#include "grfileindex.h"
+
 #include <glib-object.h>
 #include <glib.h>
 #include <gio/gio.h>
@@ -10,12 +12,27 @@ G_BEGIN_DECLS
 #define GR_TYPE_COMMAND_LIST ( gr_command_list_get_type() )
 G_DECLARE_FINAL_TYPE( GrCommandList, gr_command_list, GR, COMMAND_LIST, GObject )
 
-GrCommandList* gr_command_list_new( const gchar *com_list_path );
+typedef struct _GrCommandListCursor GrCommandListCursor;
+
+GrCommandList* gr_command_list_new( const gchar *com_list_path, guint his_size, gboolean lazy_index );
 gchar* gr_command_list_get_history_file_path( GrCommandList *self );
 void gr_command_list_set_history_file_path( GrCommandList *self, const gchar *path );
+guint gr_command_list_get_history_size( GrCommandList *self );
+void gr_command_list_set_history_size( GrCommandList *self, guint size );
+gboolean gr_command_list_get_ignore_case( GrCommandList *self );
+void gr_command_list_set_ignore_case( GrCommandList *self, gboolean ignore_case );
 gchar* gr_command_list_get_compared_string( GrCommandList *self, const gchar *str );
-GStrv gr_command_list_get_compared_array( GrCommandList *self, const gchar *str );
+gboolean gr_command_list_lookup_compared_string( GrCommandList *self, const gchar *str, gsize len, const gchar **match, gsize *match_len );
+GrCommandListCursor* gr_command_list_query_begin( GrCommandList *self, const gchar *str, guint limit, guint offset );
+const gchar* gr_command_list_query_next( GrCommandListCursor *cursor );
+void gr_command_list_query_end( GrCommandListCursor *cursor );
+gboolean gr_command_list_get_compared_files_async( GrCommandList *self, const gchar *str, GCancellable *cancellable, GrFileIndexChunkFunc chunk_func, gpointer user_data );
+GStrv gr_command_list_search_history( GrCommandList *self, const gchar *str );
+gboolean gr_command_list_reload_history( GrCommandList *self );
+void gr_command_list_add_history_source( GrCommandList *self, const gchar *path, gboolean read_only, gdouble weight );
+GAppInfo* gr_command_list_get_app_info( GrCommandList *self, const gchar *text );
 void gr_command_list_push( GrCommandList *self, const gchar *text );
+GVariant* gr_command_list_get_stats( GrCommandList *self );
 
 G_END_DECLS
 
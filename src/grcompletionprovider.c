@@ -0,0 +1,198 @@
+#include "grcompletionprovider.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_DEFINE_INTERFACE( GrCompletionProvider, gr_completion_provider, G_TYPE_OBJECT )
+
+static void
+gr_completion_provider_default_init(
+	GrCompletionProviderInterface *iface )
+{
+}
+
+GrCompletion*
+gr_completion_new(
+	const gchar *text,
+	gdouble score )
+{
+	GrCompletion *completion;
+
+	completion = g_new( GrCompletion, 1 );
+	completion->text = g_strdup( text );
+	completion->score = score;
+
+	return completion;
+}
+
+GrCompletion*
+gr_completion_copy(
+	const GrCompletion *completion )
+{
+	g_return_val_if_fail( completion != NULL, NULL );
+
+	return gr_completion_new( completion->text, completion->score );
+}
+
+void
+gr_completion_free(
+	GrCompletion *completion )
+{
+	if( completion == NULL )
+		return;
+
+	g_free( completion->text );
+	g_free( completion );
+}
+
+/* returns the key matching str regardless of case and composition of characters */
+gchar*
+gr_completion_fold(
+	const gchar *str )
+{
+	return gr_completion_fold_len( str, -1 );
+}
+
+/* returns the key of the len bytes of str, all of it if len is negative */
+gchar*
+gr_completion_fold_len(
+	const gchar *str,
+	gssize len )
+{
+	gchar *normalized, *folded, *key;
+
+	g_return_val_if_fail( str != NULL, NULL );
+
+	/* an invalid UTF-8 string is its own key */
+	normalized = g_utf8_normalize( str, len, G_NORMALIZE_NFC );
+	if( normalized == NULL )
+		return len < 0 ? g_strdup( str ) : g_strndup( str, (gsize)len );
+
+	/* folding may decompose characters, compose them back */
+	folded = g_utf8_casefold( normalized, -1 );
+	key = g_utf8_normalize( folded, -1, G_NORMALIZE_NFC );
+	g_free( folded );
+	g_free( normalized );
+
+	return key;
+}
+
+/*
+ * Adds the data to the FNV-1a hash, 0 starts a new hash. The result is never 0, so it can
+ * be returned as a stamp.
+ */
+guint64
+gr_completion_hash(
+	guint64 hash,
+	gconstpointer data,
+	gsize size )
+{
+	const guchar *p = (const guchar*)data;
+	gsize i;
+
+	if( hash == 0 )
+		hash = G_GUINT64_CONSTANT( 14695981039346656037 );
+
+	for( i = 0; i < size; ++i )
+	{
+		hash ^= p[i];
+		hash *= G_GUINT64_CONSTANT( 1099511628211 );
+	}
+
+	return hash != 0 ? hash : 1;
+}
+
+const gchar*
+gr_completion_provider_get_name(
+	GrCompletionProvider *self )
+{
+	GrCompletionProviderInterface *iface;
+
+	g_return_val_if_fail( GR_IS_COMPLETION_PROVIDER( self ), NULL );
+
+	iface = GR_COMPLETION_PROVIDER_GET_IFACE( self );
+	if( iface->get_name == NULL )
+		return G_OBJECT_TYPE_NAME( self );
+
+	return iface->get_name( self );
+}
+
+/*
+ * Returns the array of GrCompletion matching str, the best first, but not more than limit
+ * if it is not 0. The function is called from a worker thread, so the provider must be
+ * safe to query concurrently with the main thread.
+ */
+GPtrArray*
+gr_completion_provider_query(
+	GrCompletionProvider *self,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GrCompletionProviderInterface *iface;
+
+	g_return_val_if_fail( GR_IS_COMPLETION_PROVIDER( self ), NULL );
+
+	iface = GR_COMPLETION_PROVIDER_GET_IFACE( self );
+	g_return_val_if_fail( iface->query != NULL, NULL );
+
+	return iface->query( self, str, limit, cancellable );
+}
+
+/*
+ * Returns a value changing whenever the completions of the provider may change, equal for
+ * the same contents in another process, so the completions can be memoized and stored.
+ * Returns 0, if the completions must not be memoized.
+ */
+guint64
+gr_completion_provider_get_stamp(
+	GrCompletionProvider *self )
+{
+	GrCompletionProviderInterface *iface;
+
+	g_return_val_if_fail( GR_IS_COMPLETION_PROVIDER( self ), 0 );
+
+	iface = GR_COMPLETION_PROVIDER_GET_IFACE( self );
+	if( iface->get_stamp == NULL )
+		return 0;
+
+	return iface->get_stamp( self );
+}
+
+gboolean
+gr_completion_provider_can_lookup(
+	GrCompletionProvider *self )
+{
+	g_return_val_if_fail( GR_IS_COMPLETION_PROVIDER( self ), FALSE );
+
+	return GR_COMPLETION_PROVIDER_GET_IFACE( self )->lookup != NULL;
+}
+
+/*
+ * Returns the best completion starting with the len bytes of str, NULL if none or if the
+ * provider cannot look it up. If folded, str is a key of gr_completion_fold() matched
+ * against the keys the provider has folded on indexing, otherwise it is matched as it is.
+ * Sets score to the score the completion has in the results of the query, so the
+ * completions of the providers can be compared. The completion is borrowed from the
+ * provider and valid until the provider is changed or looked up again. Nothing is
+ * allocated, it is called by the main thread on every keystroke.
+ */
+const gchar*
+gr_completion_provider_lookup(
+	GrCompletionProvider *self,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	GrCompletionProviderInterface *iface;
+
+	g_return_val_if_fail( GR_IS_COMPLETION_PROVIDER( self ), NULL );
+
+	iface = GR_COMPLETION_PROVIDER_GET_IFACE( self );
+	if( iface->lookup == NULL )
+		return NULL;
+
+	return iface->lookup( self, str, len, folded, score );
+}
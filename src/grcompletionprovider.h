@@ -0,0 +1,44 @@
+#ifndef GRCOMPLETIONPROVIDER_H
+#define GRCOMPLETIONPROVIDER_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+struct _GrCompletion
+{
+	gchar *text;
+	gdouble score;
+};
+typedef struct _GrCompletion GrCompletion;
+
+#define GR_TYPE_COMPLETION_PROVIDER ( gr_completion_provider_get_type() )
+G_DECLARE_INTERFACE( GrCompletionProvider, gr_completion_provider, GR, COMPLETION_PROVIDER, GObject )
+
+struct _GrCompletionProviderInterface
+{
+	GTypeInterface parent_iface;
+
+	const gchar* (*get_name)( GrCompletionProvider *self );
+	GPtrArray* (*query)( GrCompletionProvider *self, const gchar *str, guint limit, GCancellable *cancellable );
+	guint64 (*get_stamp)( GrCompletionProvider *self );
+	const gchar* (*lookup)( GrCompletionProvider *self, const gchar *str, gsize len, gboolean folded, gdouble *score );
+};
+
+GrCompletion* gr_completion_new( const gchar *text, gdouble score );
+GrCompletion* gr_completion_copy( const GrCompletion *completion );
+void gr_completion_free( GrCompletion *completion );
+gchar* gr_completion_fold( const gchar *str );
+gchar* gr_completion_fold_len( const gchar *str, gssize len );
+guint64 gr_completion_hash( guint64 hash, gconstpointer data, gsize size );
+const gchar* gr_completion_provider_get_name( GrCompletionProvider *self );
+GPtrArray* gr_completion_provider_query( GrCompletionProvider *self, const gchar *str, guint limit, GCancellable *cancellable );
+guint64 gr_completion_provider_get_stamp( GrCompletionProvider *self );
+gboolean gr_completion_provider_can_lookup( GrCompletionProvider *self );
+const gchar* gr_completion_provider_lookup( GrCompletionProvider *self, const gchar *str, gsize len, gboolean folded, gdouble *score );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,719 @@
+#include "grdesktopindex.h"
+
+#include "grcompletionprovider.h"
+#include "grstats.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gdesktopappinfo.h>
+#include <string.h>
+
+#define DESKTOP_GROUP "Desktop Entry"
+#define CACHE_GROUP "Cache"
+#define CACHE_DIRECTORIES_GROUP "Directories"
+
+/* the cache of another version is parsed again, 2 stores the hidden entries */
+#define CACHE_VERSION 2
+
+/* applications go after binaries, the ones matched by a keyword go last */
+#define DESKTOP_NAME_SCORE 0.5
+#define DESKTOP_KEY_SCORE 0.25
+
+struct _GrDesktopEntry
+{
+	gchar *path;
+	gchar *name;
+	gchar *exec;
+	GStrv keywords;
+
+	/* case-folded name, keywords and program name of exec to match */
+	GStrv keys;
+};
+typedef struct _GrDesktopEntry GrDesktopEntry;
+
+struct _GrDesktopIndex
+{
+	GObject parent_instance;
+
+	gchar *cache_path;
+
+	/* entries sorted by name, and the same entries sorted by the key of the name */
+	GPtrArray *entries;
+	GPtrArray *key_entries;
+	guint64 stamp; /* hash of the matched strings */
+};
+typedef struct _GrDesktopIndex GrDesktopIndex;
+
+enum _GrDesktopIndexPropertyID
+{
+	PROP_0, /* 0 is reserved for GObject */
+
+	PROP_CACHE_PATH,
+
+	N_PROPS
+};
+typedef enum _GrDesktopIndexPropertyID GrDesktopIndexPropertyID;
+
+static GParamSpec *object_props[N_PROPS] = { NULL, };
+
+static void gr_desktop_index_completion_provider_init( GrCompletionProviderInterface *iface );
+
+G_DEFINE_TYPE_WITH_CODE( GrDesktopIndex, gr_desktop_index, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE( GR_TYPE_COMPLETION_PROVIDER, gr_desktop_index_completion_provider_init ) )
+
+static void
+gr_desktop_entry_free(
+	GrDesktopEntry *entry )
+{
+	g_free( entry->path );
+	g_free( entry->name );
+	g_free( entry->exec );
+	g_strfreev( entry->keywords );
+	g_strfreev( entry->keys );
+	g_free( entry );
+}
+
+static gint
+gr_desktop_entry_compare(
+	gconstpointer a,
+	gconstpointer b )
+{
+	const GrDesktopEntry *entry_a = *(const GrDesktopEntry**)a;
+	const GrDesktopEntry *entry_b = *(const GrDesktopEntry**)b;
+
+	return g_strcmp0( entry_a->name, entry_b->name );
+}
+
+static gint
+gr_desktop_entry_compare_keys(
+	gconstpointer a,
+	gconstpointer b )
+{
+	const GrDesktopEntry *entry_a = *(const GrDesktopEntry**)a;
+	const GrDesktopEntry *entry_b = *(const GrDesktopEntry**)b;
+
+	return g_strcmp0( entry_a->keys[0], entry_b->keys[0] );
+}
+
+static GStrv
+gr_desktop_index_get_directories(
+	void )
+{
+	const gchar* const *system_dirs, * const *d;
+	GStrvBuilder *builder;
+	GStrv dirs;
+
+	/* user entries shadow system ones, so the user directory goes first */
+	builder = g_strv_builder_new();
+	g_strv_builder_take( builder, g_build_filename( g_get_user_data_dir(), "applications", NULL ) );
+	system_dirs = g_get_system_data_dirs();
+	for( d = system_dirs; *d != NULL; ++d )
+		g_strv_builder_take( builder, g_build_filename( *d, "applications", NULL ) );
+	dirs = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	return dirs;
+}
+
+static gint64
+gr_desktop_index_get_directory_mtime(
+	const gchar *dir )
+{
+	GStatBuf buf;
+
+	if( g_stat( dir, &buf ) != 0 )
+		return -1;
+
+	return (gint64)buf.st_mtime;
+}
+
+/* records the desktop file id, FALSE if it is already shadowed by a previous directory */
+static gboolean
+gr_desktop_index_add_id(
+	GHashTable *ids,
+	const gchar *path )
+{
+	gchar *id;
+
+	id = g_path_get_basename( path );
+	if( g_hash_table_contains( ids, id ) )
+	{
+		g_free( id );
+		return FALSE;
+	}
+	g_hash_table_add( ids, id );
+
+	return TRUE;
+}
+
+static void
+gr_desktop_index_add_entry(
+	GrDesktopIndex *self,
+	GHashTable *ids,
+	const gchar *path,
+	gchar *name,
+	gchar *exec,
+	GStrv keywords )
+{
+	GrDesktopEntry *entry;
+	GStrvBuilder *builder;
+	GStrv argv, k;
+	gchar *program;
+
+	if( !gr_desktop_index_add_id( ids, path ) )
+	{
+		g_free( name );
+		g_free( exec );
+		g_strfreev( keywords );
+		return;
+	}
+
+	builder = g_strv_builder_new();
+	g_strv_builder_take( builder, gr_completion_fold( name ) );
+	if( keywords != NULL )
+		for( k = keywords; *k != NULL; ++k )
+			g_strv_builder_take( builder, gr_completion_fold( *k ) );
+	if( exec != NULL && g_shell_parse_argv( exec, NULL, &argv, NULL ) )
+	{
+		program = g_path_get_basename( argv[0] );
+		g_strv_builder_take( builder, gr_completion_fold( program ) );
+		g_free( program );
+		g_strfreev( argv );
+	}
+
+	entry = g_new( GrDesktopEntry, 1 );
+	entry->path = g_strdup( path );
+	entry->name = name;
+	entry->exec = exec;
+	entry->keywords = keywords;
+	entry->keys = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	g_ptr_array_add( self->entries, entry );
+}
+
+static void
+gr_desktop_index_remove_cached_directory(
+	GKeyFile *key_file,
+	const gchar *dir )
+{
+	GStrv groups, g;
+	gchar *group_dir;
+
+	groups = g_key_file_get_groups( key_file, NULL );
+	for( g = groups; *g != NULL; ++g )
+	{
+		group_dir = g_key_file_get_string( key_file, *g, "Directory", NULL );
+		if( g_strcmp0( group_dir, dir ) == 0 )
+			g_key_file_remove_group( key_file, *g, NULL );
+		g_free( group_dir );
+	}
+	g_strfreev( groups );
+}
+
+static void
+gr_desktop_index_load_cached_directory(
+	GrDesktopIndex *self,
+	GHashTable *ids,
+	GKeyFile *key_file,
+	const gchar *dir )
+{
+	GStrv groups, g;
+	gchar *group_dir, *name;
+
+	groups = g_key_file_get_groups( key_file, NULL );
+	for( g = groups; *g != NULL; ++g )
+	{
+		group_dir = g_key_file_get_string( key_file, *g, "Directory", NULL );
+		if( g_strcmp0( group_dir, dir ) == 0 )
+		{
+			name = g_key_file_get_string( key_file, *g, "Name", NULL );
+			if( name != NULL )
+				gr_desktop_index_add_entry( self, ids, *g, name,
+					g_key_file_get_string( key_file, *g, "Exec", NULL ),
+					g_key_file_get_string_list( key_file, *g, "Keywords", NULL, NULL ) );
+			else
+				gr_desktop_index_add_id( ids, *g ); /* a hidden entry */
+		}
+		g_free( group_dir );
+	}
+	g_strfreev( groups );
+}
+
+static void
+gr_desktop_index_parse_directory(
+	GrDesktopIndex *self,
+	GHashTable *ids,
+	GKeyFile *key_file,
+	const gchar *dir )
+{
+	GDir *d;
+	const gchar *filename;
+	gchar *path, *type, *name, *exec;
+	GStrv keywords;
+	gsize keywords_len;
+	GKeyFile *entry_file;
+
+	d = g_dir_open( dir, 0, NULL );
+	if( d == NULL )
+		return;
+
+	entry_file = g_key_file_new();
+	while( ( filename = g_dir_read_name( d ) ) != NULL )
+	{
+		if( !g_str_has_suffix( filename, ".desktop" ) )
+			continue;
+
+		path = g_build_filename( dir, filename, NULL );
+		if( !g_key_file_load_from_file( entry_file, path, G_KEY_FILE_NONE, NULL ) )
+		{
+			g_free( path );
+			continue;
+		}
+
+		/* only visible applications are launched, the hidden ones still shadow the entries of
+		 * the same id in the next directories, as Hidden=true deletes a system entry */
+		type = g_key_file_get_string( entry_file, DESKTOP_GROUP, "Type", NULL );
+		name = g_key_file_get_locale_string( entry_file, DESKTOP_GROUP, "Name", NULL, NULL );
+		if( g_strcmp0( type, "Application" ) != 0 || name == NULL ||
+				g_key_file_get_boolean( entry_file, DESKTOP_GROUP, "NoDisplay", NULL ) ||
+				g_key_file_get_boolean( entry_file, DESKTOP_GROUP, "Hidden", NULL ) )
+		{
+			g_key_file_set_string( key_file, path, "Directory", dir );
+			gr_desktop_index_add_id( ids, path );
+			g_free( name );
+			g_free( type );
+			g_free( path );
+			continue;
+		}
+		g_free( type );
+		exec = g_key_file_get_string( entry_file, DESKTOP_GROUP, "Exec", NULL );
+		keywords = g_key_file_get_locale_string_list( entry_file, DESKTOP_GROUP, "Keywords", NULL, &keywords_len, NULL );
+
+		/* store the parsed entry to the cache */
+		g_key_file_set_string( key_file, path, "Directory", dir );
+		g_key_file_set_string( key_file, path, "Name", name );
+		if( exec != NULL )
+			g_key_file_set_string( key_file, path, "Exec", exec );
+		if( keywords != NULL )
+			g_key_file_set_string_list( key_file, path, "Keywords", (const gchar* const*)keywords, keywords_len );
+
+		gr_desktop_index_add_entry( self, ids, path, name, exec, keywords );
+		g_free( path );
+	}
+	g_key_file_free( entry_file );
+	g_dir_close( d );
+}
+
+static void
+gr_desktop_index_update_stamp(
+	GrDesktopIndex *self )
+{
+	GrDesktopEntry *entry;
+	GStrv k;
+	guint i;
+
+	self->stamp = 0;
+	for( i = 0; i < self->entries->len; ++i )
+	{
+		entry = (GrDesktopEntry*)g_ptr_array_index( self->entries, i );
+		self->stamp = gr_completion_hash( self->stamp, entry->name, strlen( entry->name ) + 1 );
+		for( k = entry->keys; *k != NULL; ++k )
+			self->stamp = gr_completion_hash( self->stamp, *k, strlen( *k ) + 1 );
+	}
+
+	/* an empty index is memoized too */
+	if( self->stamp == 0 )
+		self->stamp = gr_completion_hash( 0, NULL, 0 );
+}
+
+static void
+gr_desktop_index_load(
+	GrDesktopIndex *self )
+{
+	const gchar *locale;
+	gchar *cached_locale, *cache_dir;
+	GStrv dirs, d;
+	GKeyFile *key_file;
+	GHashTable *ids;
+	gboolean cache_changed;
+	gint64 mtime, cached_mtime;
+	GError *error = NULL;
+	guint i;
+
+	g_return_if_fail( GR_IS_DESKTOP_INDEX( self ) );
+
+	key_file = g_key_file_new();
+	if( self->cache_path != NULL )
+		g_key_file_load_from_file( key_file, self->cache_path, G_KEY_FILE_NONE, NULL );
+	cache_changed = FALSE;
+
+	/* names are localized, so the cache is valid for one locale only */
+	locale = g_get_language_names()[0];
+	cached_locale = g_key_file_get_string( key_file, CACHE_GROUP, "locale", NULL );
+	if( g_strcmp0( cached_locale, locale ) != 0 ||
+			g_key_file_get_integer( key_file, CACHE_GROUP, "version", NULL ) != CACHE_VERSION )
+	{
+		g_key_file_free( key_file );
+		key_file = g_key_file_new();
+		g_key_file_set_string( key_file, CACHE_GROUP, "locale", locale );
+		g_key_file_set_integer( key_file, CACHE_GROUP, "version", CACHE_VERSION );
+		cache_changed = TRUE;
+	}
+	g_free( cached_locale );
+
+	/* re-parse only the directories modified since the cache was stored */
+	ids = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL );
+	dirs = gr_desktop_index_get_directories();
+	for( d = dirs; *d != NULL; ++d )
+	{
+		mtime = gr_desktop_index_get_directory_mtime( *d );
+		cached_mtime = g_key_file_get_int64( key_file, CACHE_DIRECTORIES_GROUP, *d, &error );
+		if( error != NULL )
+		{
+			g_clear_error( &error );
+			cached_mtime = -2;
+		}
+
+		if( mtime == cached_mtime )
+		{
+			gr_desktop_index_load_cached_directory( self, ids, key_file, *d );
+			continue;
+		}
+
+		gr_desktop_index_remove_cached_directory( key_file, *d );
+		gr_desktop_index_parse_directory( self, ids, key_file, *d );
+		g_key_file_set_int64( key_file, CACHE_DIRECTORIES_GROUP, *d, mtime );
+		cache_changed = TRUE;
+	}
+	g_strfreev( dirs );
+	g_hash_table_unref( ids );
+
+	g_ptr_array_sort( self->entries, gr_desktop_entry_compare );
+	g_ptr_array_set_size( self->key_entries, 0 );
+	for( i = 0; i < self->entries->len; ++i )
+		g_ptr_array_add( self->key_entries, g_ptr_array_index( self->entries, i ) );
+	g_ptr_array_sort( self->key_entries, gr_desktop_entry_compare_keys );
+	gr_desktop_index_update_stamp( self );
+
+	if( cache_changed && self->cache_path != NULL )
+	{
+		cache_dir = g_path_get_dirname( self->cache_path );
+		g_mkdir_with_parents( cache_dir, 0700 );
+		g_free( cache_dir );
+		g_key_file_save_to_file( key_file, self->cache_path, NULL );
+	}
+	g_key_file_free( key_file );
+}
+
+static const gchar*
+gr_desktop_index_get_name(
+	GrCompletionProvider *provider )
+{
+	return "desktop";
+}
+
+static GPtrArray*
+gr_desktop_index_query(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( provider );
+	GrDesktopEntry *entry;
+	GPtrArray *completions, *key_completions;
+	gchar *str_key;
+	gsize str_len, str_key_len;
+	GStrv k;
+	guint i;
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	if( str == NULL || *str == '\0' )
+		return completions;
+
+	str_len = strlen( str );
+	str_key = gr_completion_fold( str );
+	str_key_len = strlen( str_key );
+
+	/* the names starting with str go before the ones matched by a case-folded key */
+	key_completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	for( i = 0; i < self->entries->len; ++i )
+	{
+		if( limit > 0 && completions->len >= limit )
+			break;
+
+		entry = (GrDesktopEntry*)g_ptr_array_index( self->entries, i );
+		if( strncmp( entry->name, str, str_len ) == 0 )
+		{
+			g_ptr_array_add( completions, gr_completion_new( entry->name, DESKTOP_NAME_SCORE ) );
+			continue;
+		}
+
+		for( k = entry->keys; *k != NULL; ++k )
+			if( strncmp( *k, str_key, str_key_len ) == 0 )
+			{
+				g_ptr_array_add( key_completions, gr_completion_new( entry->name, DESKTOP_KEY_SCORE ) );
+				break;
+			}
+	}
+	g_free( str_key );
+
+	for( i = 0; i < key_completions->len && ( limit == 0 || completions->len < limit ); ++i )
+	{
+		g_ptr_array_add( completions, g_ptr_array_index( key_completions, i ) );
+		g_ptr_array_index( key_completions, i ) = NULL;
+	}
+	g_ptr_array_unref( key_completions );
+
+	return completions;
+}
+
+static guint64
+gr_desktop_index_get_stamp(
+	GrCompletionProvider *provider )
+{
+	/* the entries are not changed after construction */
+	return GR_DESKTOP_INDEX( provider )->stamp;
+}
+
+/*
+ * The first name starting with str, or the name of the first key of a name starting with the
+ * key str if folded; the ones matched by keywords do not start with it
+ */
+static const gchar*
+gr_desktop_index_lookup(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( provider );
+	GrDesktopEntry *entry;
+	GPtrArray *entries;
+	guint lo, hi, mid;
+
+	/* the key of the name goes first among the keys */
+	entries = folded ? self->key_entries : self->entries;
+	lo = 0;
+	hi = entries->len;
+	while( lo < hi )
+	{
+		mid = lo + ( hi - lo ) / 2;
+		entry = (GrDesktopEntry*)g_ptr_array_index( entries, mid );
+		if( strncmp( folded ? entry->keys[0] : entry->name, str, len ) < 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if( lo == entries->len )
+		return NULL;
+
+	entry = (GrDesktopEntry*)g_ptr_array_index( entries, lo );
+	if( strncmp( folded ? entry->keys[0] : entry->name, str, len ) != 0 )
+		return NULL;
+
+	if( score != NULL )
+		*score = DESKTOP_NAME_SCORE;
+
+	return entry->name;
+}
+
+static void
+gr_desktop_index_completion_provider_init(
+	GrCompletionProviderInterface *iface )
+{
+	iface->get_name = gr_desktop_index_get_name;
+	iface->query = gr_desktop_index_query;
+	iface->get_stamp = gr_desktop_index_get_stamp;
+	iface->lookup = gr_desktop_index_lookup;
+}
+
+static void
+gr_desktop_index_init(
+	GrDesktopIndex *self )
+{
+	self->cache_path = NULL;
+	self->entries = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_desktop_entry_free );
+	self->key_entries = g_ptr_array_new();
+	self->stamp = 0;
+}
+
+static void
+gr_desktop_index_constructed(
+	GObject *object )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( object );
+
+	gr_desktop_index_load( self );
+
+	G_OBJECT_CLASS( gr_desktop_index_parent_class )->constructed( object );
+}
+
+static void
+gr_desktop_index_finalize(
+	GObject *object )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( object );
+
+	g_free( self->cache_path );
+	g_ptr_array_unref( self->key_entries );
+	g_ptr_array_unref( self->entries );
+
+	G_OBJECT_CLASS( gr_desktop_index_parent_class )->finalize( object );
+}
+
+static void
+gr_desktop_index_get_property(
+	GObject *object,
+	guint prop_id,
+	GValue *value,
+	GParamSpec *pspec )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( object );
+
+	switch( (GrDesktopIndexPropertyID)prop_id )
+	{
+		case PROP_CACHE_PATH:
+			g_value_set_string( value, self->cache_path );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_desktop_index_set_property(
+	GObject *object,
+	guint prop_id,
+	const GValue *value,
+	GParamSpec *pspec )
+{
+	GrDesktopIndex *self = GR_DESKTOP_INDEX( object );
+
+	switch( (GrDesktopIndexPropertyID)prop_id )
+	{
+		case PROP_CACHE_PATH:
+			g_free( self->cache_path );
+			self->cache_path = g_value_dup_string( value );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_desktop_index_class_init(
+	GrDesktopIndexClass *klass )
+{
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->constructed = gr_desktop_index_constructed;
+	object_class->finalize = gr_desktop_index_finalize;
+	object_class->get_property = gr_desktop_index_get_property;
+	object_class->set_property = gr_desktop_index_set_property;
+
+	object_props[PROP_CACHE_PATH] = g_param_spec_string(
+		"cache-path",
+		"Cache path",
+		"Path to the file caching parsed desktop entries",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	g_object_class_install_properties( object_class, N_PROPS, object_props );
+}
+
+GrDesktopIndex*
+gr_desktop_index_new(
+	const gchar *cache_path )
+{
+	return GR_DESKTOP_INDEX( g_object_new( GR_TYPE_DESKTOP_INDEX, "cache-path", cache_path, NULL ) );
+}
+
+gchar*
+gr_desktop_index_get_cache_path(
+	GrDesktopIndex *self )
+{
+	g_return_val_if_fail( GR_IS_DESKTOP_INDEX( self ), NULL );
+
+	return g_strdup( self->cache_path );
+}
+
+GAppInfo*
+gr_desktop_index_get_app_info(
+	GrDesktopIndex *self,
+	const gchar *name )
+{
+	GrDesktopEntry *entry;
+	GDesktopAppInfo *app_info;
+	guint i;
+
+	g_return_val_if_fail( GR_IS_DESKTOP_INDEX( self ), NULL );
+
+	if( name == NULL )
+		return NULL;
+
+	for( i = 0; i < self->entries->len; ++i )
+	{
+		entry = (GrDesktopEntry*)g_ptr_array_index( self->entries, i );
+		if( g_strcmp0( entry->name, name ) != 0 )
+			continue;
+
+		/* the file may be removed since the cache was stored */
+		app_info = g_desktop_app_info_new_from_filename( entry->path );
+		if( app_info != NULL )
+			return G_APP_INFO( app_info );
+	}
+
+	return NULL;
+}
+
+static gsize
+gr_desktop_index_get_strv_size(
+	GStrv strv )
+{
+	gsize size;
+	GStrv s;
+
+	if( strv == NULL )
+		return 0;
+
+	size = sizeof( gchar* );
+	for( s = strv; *s != NULL; ++s )
+		size += sizeof( gchar* ) + strlen( *s ) + 1;
+
+	return size;
+}
+
+/* Returns a{sv}: the number of entries and their bytes */
+GVariant*
+gr_desktop_index_get_stats(
+	GrDesktopIndex *self )
+{
+	GVariantBuilder builder;
+	GrDesktopEntry *entry;
+	guint64 bytes;
+	guint i;
+
+	g_return_val_if_fail( GR_IS_DESKTOP_INDEX( self ), NULL );
+
+	bytes = sizeof( GrDesktopIndex ) + self->entries->len * ( 2 * sizeof( gpointer ) + sizeof( GrDesktopEntry ) );
+	for( i = 0; i < self->entries->len; ++i )
+	{
+		entry = (GrDesktopEntry*)g_ptr_array_index( self->entries, i );
+		bytes += strlen( entry->path ) + strlen( entry->name ) + 2;
+		bytes += entry->exec != NULL ? strlen( entry->exec ) + 1 : 0; /* Exec is optional */
+		bytes += gr_desktop_index_get_strv_size( entry->keywords ) + gr_desktop_index_get_strv_size( entry->keys );
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( self->entries->len ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+
+	return g_variant_builder_end( &builder );
+}
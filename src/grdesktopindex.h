@@ -0,0 +1,20 @@
+#ifndef GRDESKTOPINDEX_H
+#define GRDESKTOPINDEX_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GR_TYPE_DESKTOP_INDEX ( gr_desktop_index_get_type() )
+G_DECLARE_FINAL_TYPE( GrDesktopIndex, gr_desktop_index, GR, DESKTOP_INDEX, GObject )
+
+GrDesktopIndex* gr_desktop_index_new( const gchar *cache_path );
+gchar* gr_desktop_index_get_cache_path( GrDesktopIndex *self );
+GAppInfo* gr_desktop_index_get_app_info( GrDesktopIndex *self, const gchar *name );
+GVariant* gr_desktop_index_get_stats( GrDesktopIndex *self );
+
+G_END_DECLS
+
+#endif
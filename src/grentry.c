@@ -1,6 +1,9 @@
 #include "grentry.h"
 
+#include "config.h"
 #include "grcommandlist.h"
+#include "grhistogram.h"
+#include "grstats.h"
 
 #include <glib-object.h>
 #include <glib.h>
@@ -20,6 +23,12 @@ struct _GrEntry
 	GtkEditable *editable;
 
 	GrCommandList *com_list;
+
+	/* microseconds of the completion of a keystroke and until the next frame, NULL unless
+	 * the environment variable PROGRAM_LATENCY_ENV is set */
+	GrHistogram *query_latency;
+	GrHistogram *frame_latency;
+	gint64 frame_start; /* of the first keystroke not painted yet, 0 if none */
 };
 typedef struct _GrEntry GrEntry;
 
@@ -52,14 +61,30 @@ gr_entry_set_compared_text(
 	GrEntry *self,
 	gint pos )
 {
+	const gchar *chars, *match;
 	gchar *text, *s;
+	gsize len;
 
 	g_return_if_fail( GR_IS_ENTRY( self ) );
 
 	/* no list, do noting */
 	if( self->com_list == NULL )
 		return;
-	
+
+	/* a command is completed by the text borrowed from the list, nothing is copied; the text
+	 * already completed is not set again, as GTK lays every new text out anew */
+	chars = gtk_editable_get_text( self->editable );
+	len = (gsize)( g_utf8_offset_to_pointer( chars, pos ) - chars );
+	if( gr_command_list_lookup_compared_string( self->com_list, chars, len, &match, NULL ) )
+	{
+		if( match == NULL )
+			gtk_editable_delete_text( self->editable, pos, -1 );
+		else if( strcmp( chars, match ) != 0 )
+			gtk_editable_set_text( self->editable, match );
+		gtk_editable_set_position( self->editable, pos );
+		return;
+	}
+
 	text = gtk_editable_get_chars( self->editable, 0, pos );
 	s = gr_command_list_get_compared_string( self->com_list, text );
 
@@ -70,6 +95,58 @@ gr_entry_set_compared_text(
 	g_free( text );
 }
 
+static void
+gr_entry_record_latency(
+	GrEntry *self,
+	gint64 start_time )
+{
+	if( self->query_latency == NULL )
+		return;
+
+	gr_histogram_record( self->query_latency, g_get_monotonic_time() - start_time );
+	if( self->frame_start == 0 )
+		self->frame_start = start_time;
+}
+
+static void
+on_frame_clock_after_paint(
+	GdkFrameClock *clock,
+	gpointer user_data )
+{
+	GrEntry *entry = GR_ENTRY( user_data );
+
+	if( entry->frame_start == 0 )
+		return;
+
+	gr_histogram_record( entry->frame_latency, g_get_monotonic_time() - entry->frame_start );
+	entry->frame_start = 0;
+}
+
+static void
+on_entry_realize(
+	GtkWidget *widget,
+	gpointer user_data )
+{
+	GdkFrameClock *clock;
+
+	clock = gtk_widget_get_frame_clock( widget );
+	if( clock != NULL )
+		g_signal_connect_object( G_OBJECT( clock ), "after-paint", G_CALLBACK( on_frame_clock_after_paint ), widget, 0 );
+}
+
+static void
+on_entry_unrealize(
+	GtkWidget *widget,
+	gpointer user_data )
+{
+	GdkFrameClock *clock;
+
+	clock = gtk_widget_get_frame_clock( widget );
+	if( clock != NULL )
+		g_signal_handlers_disconnect_by_func( clock, on_frame_clock_after_paint, widget );
+	GR_ENTRY( widget )->frame_start = 0;
+}
+
 static void
 on_editable_insert_text(
 	GtkEditable *self,
@@ -79,11 +156,15 @@ on_editable_insert_text(
 	gpointer user_data )
 {
 	GrEntry *entry = GR_ENTRY( user_data );
+	gint64 start_time;
+
+	start_time = entry->query_latency != NULL ? g_get_monotonic_time() : 0;
 
 	g_signal_handler_block( G_OBJECT( self ), entry->insert_text_handler_id );
 	g_signal_handler_block( G_OBJECT( self ), entry->delete_text_handler_id );
 
 	gr_entry_set_compared_text( entry, *position );
+	gr_entry_record_latency( entry, start_time );
 
 	g_signal_handler_unblock( G_OBJECT( self ), entry->insert_text_handler_id );
 	g_signal_handler_unblock( G_OBJECT( self ), entry->delete_text_handler_id );
@@ -99,11 +180,15 @@ on_editable_delete_text(
 	gpointer user_data )
 {
 	GrEntry *entry = GR_ENTRY( user_data );
+	gint64 start_time;
+
+	start_time = entry->query_latency != NULL ? g_get_monotonic_time() : 0;
 
 	g_signal_handler_block( G_OBJECT( self ), entry->insert_text_handler_id );
 	g_signal_handler_block( G_OBJECT( self ), entry->delete_text_handler_id );
 
 	gr_entry_set_compared_text( entry, start_pos );
+	gr_entry_record_latency( entry, start_time );
 
 	g_signal_handler_unblock( G_OBJECT( self ), entry->insert_text_handler_id );
 	g_signal_handler_unblock( G_OBJECT( self ), entry->delete_text_handler_id );
@@ -157,6 +242,18 @@ gr_entry_init(
 	gtk_widget_set_parent( GTK_WIDGET( self->entry ), GTK_WIDGET( self ) );
 
 	self->com_list = NULL;
+
+	/* latency is recorded on request only */
+	self->query_latency = NULL;
+	self->frame_latency = NULL;
+	self->frame_start = 0;
+	if( g_getenv( PROGRAM_LATENCY_ENV ) != NULL )
+	{
+		self->query_latency = gr_histogram_new();
+		self->frame_latency = gr_histogram_new();
+		g_signal_connect( G_OBJECT( self ), "realize", G_CALLBACK( on_entry_realize ), NULL );
+		g_signal_connect( G_OBJECT( self ), "unrealize", G_CALLBACK( on_entry_unrealize ), NULL );
+	}
 }
 
 static void
@@ -204,6 +301,20 @@ gr_entry_dispose(
 	GObject *object )
 {
 	GrEntry *self = GR_ENTRY( object );
+	GVariant *stats;
+	gchar *str;
+
+	/* the report goes to stderr, the window is disposed on exit */
+	stats = gr_entry_get_latency_stats( self );
+	if( stats != NULL )
+	{
+		str = gr_stats_format( stats, g_strcmp0( g_getenv( PROGRAM_LATENCY_ENV ), "json" ) == 0 );
+		g_printerr( "%s", str );
+		g_free( str );
+		g_variant_unref( g_variant_ref_sink( stats ) );
+	}
+	g_clear_pointer( &self->query_latency, gr_histogram_free );
+	g_clear_pointer( &self->frame_latency, gr_histogram_free );
 
 	gtk_widget_unparent( GTK_WIDGET( self->entry ) );
 	g_clear_object( &self->com_list );
@@ -289,6 +400,35 @@ gr_entry_get_text_befor_cursor(
 	return text;
 }
 
+/* inserts text at the cursor as if it is typed, so it is completed */
+void
+gr_entry_insert_at_cursor(
+	GrEntry *self,
+	const gchar *text )
+{
+	gint position;
+
+	g_return_if_fail( GR_IS_ENTRY( self ) );
+	g_return_if_fail( text != NULL );
+
+	position = gtk_editable_get_position( self->editable );
+	gtk_editable_insert_text( self->editable, text, -1, &position );
+}
+
+/* deletes the character before the cursor as if BackSpace is pressed */
+void
+gr_entry_delete_before_cursor(
+	GrEntry *self )
+{
+	gint position;
+
+	g_return_if_fail( GR_IS_ENTRY( self ) );
+
+	position = gtk_editable_get_position( self->editable );
+	if( position > 0 )
+		gtk_editable_delete_text( self->editable, position - 1, position );
+}
+
 GrCommandList*
 gr_entry_get_command_list(
 	GrEntry *self )
@@ -319,3 +459,24 @@ gr_entry_set_command_list(
 	g_object_thaw_notify( G_OBJECT( self ) );
 }
 
+/*
+ * Returns a{sv} of the latencies in microseconds: "query" from a keystroke to its completion
+ * and "frame" from a keystroke to the next painted frame, NULL if they are not recorded.
+ */
+GVariant*
+gr_entry_get_latency_stats(
+	GrEntry *self )
+{
+	GVariantBuilder builder;
+
+	g_return_val_if_fail( GR_IS_ENTRY( self ), NULL );
+
+	if( self->query_latency == NULL )
+		return NULL;
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "query", gr_histogram_get_stats( self->query_latency ) );
+	g_variant_builder_add( &builder, "{sv}", "frame", gr_histogram_get_stats( self->frame_latency ) );
+
+	return g_variant_builder_end( &builder );
+}
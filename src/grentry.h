@@ -17,8 +17,11 @@ GrEntry* gr_entry_new( void );
 void gr_entry_set_text( GrEntry *self, const gchar* text );
 gchar* gr_entry_get_text( GrEntry *self );
 gchar* gr_entry_get_text_befor_cursor( GrEntry *self );
+void gr_entry_insert_at_cursor( GrEntry *self, const gchar *text );
+void gr_entry_delete_before_cursor( GrEntry *self );
 GrCommandList* gr_entry_get_command_list( GrEntry *self );
 void gr_entry_set_command_list( GrEntry *self, GrCommandList *com_list );
+GVariant* gr_entry_get_latency_stats( GrEntry *self );
 
 G_END_DECLS
 
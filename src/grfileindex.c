@@ -0,0 +1,713 @@
+#include "grfileindex.h"
+
+#include "grcompletionprovider.h"
+#include "grstats.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+/* files go after history, but before binaries */
+#define FILE_INDEX_SCORE 1.5
+
+/* number of files enumerated and passed to the caller at once */
+#define FILE_INDEX_CHUNK_SIZE 256
+
+/* number of directory listings kept */
+#define FILE_INDEX_CACHE_SIZE 16
+
+#define FILE_INDEX_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE
+
+/* any listing of the directory, the main thread does not stat it */
+#define FILE_INDEX_ANY_MTIME -1
+
+/* names of files in a directory, a name of directory ends with '/' */
+struct _GrFileListing
+{
+	gint ref_count;
+
+	gchar *dir_path;
+	gint64 mtime;
+	GPtrArray *names;
+};
+typedef struct _GrFileListing GrFileListing;
+
+/* an argument of the command line being completed */
+struct _GrFileQuery
+{
+	gchar *prefix_text; /* text before the file name as it is typed */
+	gchar *dir_path; /* directory in the file name encoding */
+	gchar *name_prefix; /* unescaped beginning of the file name */
+};
+typedef struct _GrFileQuery GrFileQuery;
+
+struct _GrFileIndexRequest
+{
+	GrFileIndex *self;
+	GrFileQuery *query;
+	GCancellable *cancellable;
+	GrFileIndexChunkFunc chunk_func;
+	gpointer user_data;
+
+	GFileEnumerator *dir_enum;
+	GrFileListing *listing;
+	guint pos;
+};
+typedef struct _GrFileIndexRequest GrFileIndexRequest;
+
+struct _GrFileIndex
+{
+	GObject parent_instance;
+
+	/* listings are added by the main thread and read by the query threads */
+	GMutex mutex;
+	GHashTable *listings;
+	GQueue *listing_queue; /* the recently listed first */
+
+	gchar *prefetch_dir_path;
+	GCancellable *prefetch_cancellable; /* NULL, if no directory is being prefetched */
+};
+typedef struct _GrFileIndex GrFileIndex;
+
+static void gr_file_index_completion_provider_init( GrCompletionProviderInterface *iface );
+
+G_DEFINE_TYPE_WITH_CODE( GrFileIndex, gr_file_index, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE( GR_TYPE_COMPLETION_PROVIDER, gr_file_index_completion_provider_init ) )
+
+static GrFileListing*
+gr_file_listing_new(
+	const gchar *dir_path,
+	gint64 mtime )
+{
+	GrFileListing *listing;
+
+	listing = g_new( GrFileListing, 1 );
+	listing->ref_count = 1;
+	listing->dir_path = g_strdup( dir_path );
+	listing->mtime = mtime;
+	listing->names = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+
+	return listing;
+}
+
+static GrFileListing*
+gr_file_listing_ref(
+	GrFileListing *listing )
+{
+	g_atomic_int_inc( &listing->ref_count );
+
+	return listing;
+}
+
+static void
+gr_file_listing_unref(
+	GrFileListing *listing )
+{
+	if( !g_atomic_int_dec_and_test( &listing->ref_count ) )
+		return;
+
+	g_free( listing->dir_path );
+	g_ptr_array_unref( listing->names );
+	g_free( listing );
+}
+
+static void
+gr_file_query_free(
+	GrFileQuery *query )
+{
+	g_free( query->prefix_text );
+	g_free( query->dir_path );
+	g_free( query->name_prefix );
+	g_free( query );
+}
+
+/* returns NULL, if str has no argument after the command */
+static GrFileQuery*
+gr_file_query_new(
+	const gchar *str )
+{
+	GrFileQuery *query;
+	const gchar *p, *token, *slash;
+	gboolean command;
+	GString *dir, *name;
+	gchar *dir_utf8, *cwd;
+
+	if( str == NULL )
+		return NULL;
+
+	/* the argument starts after the last unescaped blank following the command */
+	token = NULL;
+	command = FALSE;
+	for( p = str; *p != '\0'; ++p )
+	{
+		if( *p == '\\' && p[1] != '\0' )
+		{
+			command = TRUE;
+			++p;
+			continue;
+		}
+
+		if( g_ascii_isspace( *p ) )
+		{
+			if( command )
+				token = p + 1;
+			continue;
+		}
+
+		command = TRUE;
+	}
+	if( token == NULL )
+		return NULL;
+
+	/* split the argument to unescaped directory and file name */
+	dir = g_string_new( NULL );
+	name = g_string_new( NULL );
+	slash = NULL;
+	for( p = token; *p != '\0'; ++p )
+	{
+		if( *p == '\\' && p[1] != '\0' )
+		{
+			++p;
+			g_string_append_c( name, *p );
+			continue;
+		}
+
+		if( *p == '/' )
+		{
+			g_string_append_len( dir, name->str, name->len );
+			g_string_append_c( dir, '/' );
+			g_string_truncate( name, 0 );
+			slash = p;
+			continue;
+		}
+
+		g_string_append_c( name, *p );
+	}
+
+	/* expand the directory relative to home or the current directory */
+	if( dir->len == 0 )
+		dir_utf8 = g_get_current_dir();
+	else if( g_str_has_prefix( dir->str, "~/" ) )
+		dir_utf8 = g_build_filename( g_get_home_dir(), dir->str + 2, NULL );
+	else if( g_path_is_absolute( dir->str ) )
+		dir_utf8 = g_strdup( dir->str );
+	else
+	{
+		cwd = g_get_current_dir();
+		dir_utf8 = g_build_filename( cwd, dir->str, NULL );
+		g_free( cwd );
+	}
+	g_string_free( dir, TRUE );
+
+	query = g_new( GrFileQuery, 1 );
+	query->prefix_text = g_strndup( str, ( slash != NULL ? slash + 1 : token ) - str );
+	query->dir_path = g_filename_from_utf8( dir_utf8, -1, NULL, NULL, NULL );
+	query->name_prefix = g_string_free( name, FALSE );
+	g_free( dir_utf8 );
+
+	if( query->dir_path == NULL )
+	{
+		gr_file_query_free( query );
+		return NULL;
+	}
+
+	return query;
+}
+
+static gboolean
+gr_file_query_match(
+	GrFileQuery *query,
+	const gchar *name )
+{
+	/* hidden files are shown only if the name starts with a dot */
+	if( *name == '.' && *query->name_prefix != '.' )
+		return FALSE;
+
+	return g_str_has_prefix( name, query->name_prefix );
+}
+
+static gchar*
+gr_file_query_build_text(
+	GrFileQuery *query,
+	const gchar *name )
+{
+	const gchar special[] = " \t\n\\'\"$`&|;<>()*?[]!#{}";
+	const gchar *p;
+	GString *text;
+
+	text = g_string_new( query->prefix_text );
+	for( p = name; *p != '\0'; ++p )
+	{
+		if( strchr( special, *p ) != NULL )
+			g_string_append_c( text, '\\' );
+		g_string_append_c( text, *p );
+	}
+
+	return g_string_free( text, FALSE );
+}
+
+/*
+ * Returns the cached listing of the directory, if it is of the mtime or FILE_INDEX_ANY_MTIME.
+ * The directory is never touched here, it may be on a hung mount.
+ */
+static GrFileListing*
+gr_file_index_lookup(
+	GrFileIndex *self,
+	const gchar *dir_path,
+	gint64 mtime )
+{
+	GrFileListing *listing;
+
+	g_mutex_lock( &self->mutex );
+	listing = (GrFileListing*)g_hash_table_lookup( self->listings, dir_path );
+	if( listing != NULL && ( mtime == FILE_INDEX_ANY_MTIME || listing->mtime == mtime ) )
+		gr_file_listing_ref( listing );
+	else
+		listing = NULL;
+	g_mutex_unlock( &self->mutex );
+
+	return listing;
+}
+
+static void
+gr_file_index_store(
+	GrFileIndex *self,
+	GrFileListing *listing )
+{
+	GrFileListing *old;
+
+	g_mutex_lock( &self->mutex );
+
+	old = (GrFileListing*)g_hash_table_lookup( self->listings, listing->dir_path );
+	if( old != NULL )
+	{
+		g_queue_remove( self->listing_queue, old );
+		g_hash_table_remove( self->listings, old->dir_path );
+	}
+
+	/* evict the least recently listed directory */
+	if( g_queue_get_length( self->listing_queue ) >= FILE_INDEX_CACHE_SIZE )
+	{
+		old = (GrFileListing*)g_queue_pop_tail( self->listing_queue );
+		g_hash_table_remove( self->listings, old->dir_path );
+	}
+
+	gr_file_listing_ref( listing );
+	g_queue_push_head( self->listing_queue, listing );
+	g_hash_table_insert( self->listings, listing->dir_path, listing );
+
+	g_mutex_unlock( &self->mutex );
+}
+
+static void
+gr_file_index_request_free(
+	GrFileIndexRequest *req )
+{
+	/* the prefetch is done, the next one checks the directory again */
+	if( req->self->prefetch_cancellable == req->cancellable )
+		g_clear_object( &req->self->prefetch_cancellable );
+
+	g_object_unref( G_OBJECT( req->self ) );
+	gr_file_query_free( req->query );
+	g_object_unref( G_OBJECT( req->cancellable ) );
+	if( req->dir_enum != NULL )
+		g_object_unref( G_OBJECT( req->dir_enum ) );
+	if( req->listing != NULL )
+		gr_file_listing_unref( req->listing );
+	g_free( req );
+}
+
+static void
+gr_file_index_request_deliver(
+	GrFileIndexRequest *req,
+	GPtrArray *chunk )
+{
+	if( req->chunk_func == NULL || chunk->len == 0 || g_cancellable_is_cancelled( req->cancellable ) )
+		return;
+
+	g_ptr_array_add( chunk, NULL );
+	req->chunk_func( (const gchar* const*)chunk->pdata, req->user_data );
+}
+
+static gboolean
+on_request_idle(
+	gpointer user_data )
+{
+	GrFileIndexRequest *req = (GrFileIndexRequest*)user_data;
+	GPtrArray *chunk;
+	const gchar *name;
+
+	if( g_cancellable_is_cancelled( req->cancellable ) )
+	{
+		gr_file_index_request_free( req );
+		return G_SOURCE_REMOVE;
+	}
+
+	/* pass the cached listing by chunks, not blocking the main loop */
+	chunk = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+	while( req->pos < req->listing->names->len && chunk->len < FILE_INDEX_CHUNK_SIZE )
+	{
+		name = (const gchar*)g_ptr_array_index( req->listing->names, req->pos++ );
+		if( gr_file_query_match( req->query, name ) )
+			g_ptr_array_add( chunk, gr_file_query_build_text( req->query, name ) );
+	}
+	gr_file_index_request_deliver( req, chunk );
+	g_ptr_array_unref( chunk );
+
+	if( req->pos < req->listing->names->len )
+		return G_SOURCE_CONTINUE;
+
+	gr_file_index_request_free( req );
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_enumerator_next_files(
+	GObject *source_object,
+	GAsyncResult *res,
+	gpointer user_data )
+{
+	GrFileIndexRequest *req = (GrFileIndexRequest*)user_data;
+	GList *infos, *l;
+	GFileInfo *info;
+	GPtrArray *chunk;
+	gchar *name;
+	GError *error = NULL;
+
+	infos = g_file_enumerator_next_files_finish( req->dir_enum, res, &error );
+	if( error != NULL || g_cancellable_is_cancelled( req->cancellable ) )
+	{
+		g_clear_error( &error );
+		g_list_free_full( infos, (GDestroyNotify)g_object_unref );
+		gr_file_index_request_free( req );
+		return;
+	}
+
+	/* the directory is listed completely */
+	if( infos == NULL )
+	{
+		gr_file_index_store( req->self, req->listing );
+		gr_file_index_request_free( req );
+		return;
+	}
+
+	chunk = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+	for( l = infos; l != NULL; l = l->next )
+	{
+		info = G_FILE_INFO( l->data );
+		if( g_file_info_get_file_type( info ) == G_FILE_TYPE_DIRECTORY )
+			name = g_strconcat( g_file_info_get_display_name( info ), "/", NULL );
+		else
+			name = g_strdup( g_file_info_get_display_name( info ) );
+
+		if( gr_file_query_match( req->query, name ) )
+			g_ptr_array_add( chunk, gr_file_query_build_text( req->query, name ) );
+		g_ptr_array_add( req->listing->names, name );
+	}
+	g_list_free_full( infos, (GDestroyNotify)g_object_unref );
+
+	gr_file_index_request_deliver( req, chunk );
+	g_ptr_array_unref( chunk );
+
+	g_file_enumerator_next_files_async( req->dir_enum, FILE_INDEX_CHUNK_SIZE, G_PRIORITY_DEFAULT, req->cancellable, on_enumerator_next_files, req );
+}
+
+static void
+on_file_enumerate_children(
+	GObject *source_object,
+	GAsyncResult *res,
+	gpointer user_data )
+{
+	GrFileIndexRequest *req = (GrFileIndexRequest*)user_data;
+
+	req->dir_enum = g_file_enumerate_children_finish( G_FILE( source_object ), res, NULL );
+	if( req->dir_enum == NULL || g_cancellable_is_cancelled( req->cancellable ) )
+	{
+		gr_file_index_request_free( req );
+		return;
+	}
+
+	g_file_enumerator_next_files_async( req->dir_enum, FILE_INDEX_CHUNK_SIZE, G_PRIORITY_DEFAULT, req->cancellable, on_enumerator_next_files, req );
+}
+
+/* the cached listing is passed from the main loop, if the directory is not modified since */
+static void
+on_file_query_info(
+	GObject *source_object,
+	GAsyncResult *res,
+	gpointer user_data )
+{
+	GrFileIndexRequest *req = (GrFileIndexRequest*)user_data;
+	GFileInfo *info;
+	gint64 mtime;
+
+	info = g_file_query_info_finish( G_FILE( source_object ), res, NULL );
+	if( info == NULL || g_cancellable_is_cancelled( req->cancellable ) )
+	{
+		g_clear_object( &info );
+		gr_file_index_request_free( req );
+		return;
+	}
+	mtime = (gint64)g_file_info_get_attribute_uint64( info, G_FILE_ATTRIBUTE_TIME_MODIFIED );
+	g_object_unref( G_OBJECT( info ) );
+
+	req->listing = gr_file_index_lookup( req->self, req->query->dir_path, mtime );
+	if( req->listing != NULL )
+	{
+		if( req->chunk_func == NULL )
+			gr_file_index_request_free( req );
+		else
+			g_idle_add( on_request_idle, req );
+		return;
+	}
+
+	req->listing = gr_file_listing_new( req->query->dir_path, mtime );
+	g_file_enumerate_children_async( G_FILE( source_object ), FILE_INDEX_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, req->cancellable, on_file_enumerate_children, req );
+}
+
+/* the directory is checked and listed by the worker threads of GIO, never by the main thread */
+static void
+gr_file_index_request_start(
+	GrFileIndex *self,
+	GrFileQuery *query,
+	GCancellable *cancellable,
+	GrFileIndexChunkFunc chunk_func,
+	gpointer user_data )
+{
+	GrFileIndexRequest *req;
+	GFile *dir;
+
+	req = g_new( GrFileIndexRequest, 1 );
+	req->self = GR_FILE_INDEX( g_object_ref( G_OBJECT( self ) ) );
+	req->query = query;
+	req->cancellable = cancellable != NULL ? G_CANCELLABLE( g_object_ref( G_OBJECT( cancellable ) ) ) : g_cancellable_new();
+	req->chunk_func = chunk_func;
+	req->user_data = user_data;
+	req->dir_enum = NULL;
+	req->listing = NULL;
+	req->pos = 0;
+
+	dir = g_file_new_for_path( query->dir_path );
+	g_file_query_info_async( dir, G_FILE_ATTRIBUTE_TIME_MODIFIED, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, req->cancellable, on_file_query_info, req );
+	g_object_unref( G_OBJECT( dir ) );
+}
+
+static const gchar*
+gr_file_index_get_name(
+	GrCompletionProvider *provider )
+{
+	return "file";
+}
+
+/*
+ * Only the cached listings are queried, without checking the directory: a listing modified since
+ * is replaced by the prefetch of the keystroke. The full list of files is passed by
+ * gr_file_index_query_async().
+ */
+static GPtrArray*
+gr_file_index_query(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GrFileIndex *self = GR_FILE_INDEX( provider );
+	GPtrArray *completions;
+	GrFileQuery *query;
+	GrFileListing *listing;
+	const gchar *name;
+	gchar *text;
+	guint i;
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	if( limit == 0 )
+		return completions;
+
+	query = gr_file_query_new( str );
+	if( query == NULL )
+		return completions;
+
+	listing = gr_file_index_lookup( self, query->dir_path, FILE_INDEX_ANY_MTIME );
+	if( listing != NULL )
+	{
+		for( i = 0; i < listing->names->len && completions->len < limit; ++i )
+		{
+			name = (const gchar*)g_ptr_array_index( listing->names, i );
+			if( !gr_file_query_match( query, name ) )
+				continue;
+
+			text = gr_file_query_build_text( query, name );
+			g_ptr_array_add( completions, gr_completion_new( text, FILE_INDEX_SCORE ) );
+			g_free( text );
+		}
+		gr_file_listing_unref( listing );
+	}
+	gr_file_query_free( query );
+
+	return completions;
+}
+
+static void
+gr_file_index_completion_provider_init(
+	GrCompletionProviderInterface *iface )
+{
+	iface->get_name = gr_file_index_get_name;
+	iface->query = gr_file_index_query;
+}
+
+static void
+gr_file_index_init(
+	GrFileIndex *self )
+{
+	g_mutex_init( &self->mutex );
+	self->listings = g_hash_table_new_full( g_str_hash, g_str_equal, NULL, (GDestroyNotify)gr_file_listing_unref );
+	self->listing_queue = g_queue_new();
+
+	self->prefetch_dir_path = NULL;
+	self->prefetch_cancellable = NULL;
+}
+
+static void
+gr_file_index_dispose(
+	GObject *object )
+{
+	GrFileIndex *self = GR_FILE_INDEX( object );
+
+	if( self->prefetch_cancellable != NULL )
+		g_cancellable_cancel( self->prefetch_cancellable );
+	g_clear_object( &self->prefetch_cancellable );
+
+	G_OBJECT_CLASS( gr_file_index_parent_class )->dispose( object );
+}
+
+static void
+gr_file_index_finalize(
+	GObject *object )
+{
+	GrFileIndex *self = GR_FILE_INDEX( object );
+
+	g_queue_free( self->listing_queue );
+	g_hash_table_unref( self->listings );
+	g_mutex_clear( &self->mutex );
+	g_free( self->prefetch_dir_path );
+
+	G_OBJECT_CLASS( gr_file_index_parent_class )->finalize( object );
+}
+
+static void
+gr_file_index_class_init(
+	GrFileIndexClass *klass )
+{
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->dispose = gr_file_index_dispose;
+	object_class->finalize = gr_file_index_finalize;
+}
+
+GrFileIndex*
+gr_file_index_new(
+	void )
+{
+	return GR_FILE_INDEX( g_object_new( GR_TYPE_FILE_INDEX, NULL ) );
+}
+
+/*
+ * Start checking and listing the directory of the argument in str, so the next keystrokes find it
+ * cached and up to date. A directory not answering keeps one prefetch pending, never the main loop.
+ */
+void
+gr_file_index_prefetch(
+	GrFileIndex *self,
+	const gchar *str )
+{
+	GrFileQuery *query;
+
+	g_return_if_fail( GR_IS_FILE_INDEX( self ) );
+
+	query = gr_file_query_new( str );
+	if( query == NULL )
+		return;
+
+	/* already being checked */
+	if( self->prefetch_cancellable != NULL && g_strcmp0( self->prefetch_dir_path, query->dir_path ) == 0 )
+	{
+		gr_file_query_free( query );
+		return;
+	}
+
+	if( self->prefetch_cancellable != NULL )
+	{
+		g_cancellable_cancel( self->prefetch_cancellable );
+		g_object_unref( G_OBJECT( self->prefetch_cancellable ) );
+	}
+	self->prefetch_cancellable = g_cancellable_new();
+	g_free( self->prefetch_dir_path );
+	self->prefetch_dir_path = g_strdup( query->dir_path );
+
+	gr_file_index_request_start( self, query, self->prefetch_cancellable, NULL, NULL );
+}
+
+/*
+ * Pass completions of the argument in str to chunk_func by chunks, as the directory is
+ * enumerated or from the cached listing. Returns FALSE, if str has no argument to complete.
+ */
+gboolean
+gr_file_index_query_async(
+	GrFileIndex *self,
+	const gchar *str,
+	GCancellable *cancellable,
+	GrFileIndexChunkFunc chunk_func,
+	gpointer user_data )
+{
+	GrFileQuery *query;
+
+	g_return_val_if_fail( GR_IS_FILE_INDEX( self ), FALSE );
+	g_return_val_if_fail( chunk_func != NULL, FALSE );
+
+	query = gr_file_query_new( str );
+	if( query == NULL )
+		return FALSE;
+
+	gr_file_index_request_start( self, query, cancellable, chunk_func, user_data );
+
+	return TRUE;
+}
+
+/* Returns a{sv}: the number of cached listings, of their names and their bytes */
+GVariant*
+gr_file_index_get_stats(
+	GrFileIndex *self )
+{
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	gpointer value;
+	GrFileListing *listing;
+	guint64 bytes;
+	guint i, n_listings, n_names;
+
+	g_return_val_if_fail( GR_IS_FILE_INDEX( self ), NULL );
+
+	bytes = sizeof( GrFileIndex );
+	n_names = 0;
+
+	g_mutex_lock( &self->mutex );
+	n_listings = g_hash_table_size( self->listings );
+	g_hash_table_iter_init( &iter, self->listings );
+	while( g_hash_table_iter_next( &iter, NULL, &value ) )
+	{
+		listing = (GrFileListing*)value;
+		bytes += GR_STATS_HASH_ENTRY_SIZE + sizeof( GrFileListing ) + sizeof( GPtrArray ) + strlen( listing->dir_path ) + 1;
+		for( i = 0; i < listing->names->len; ++i )
+			bytes += sizeof( gpointer ) + strlen( (const gchar*)g_ptr_array_index( listing->names, i ) ) + 1;
+		n_names += listing->names->len;
+	}
+	g_mutex_unlock( &self->mutex );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "listings", g_variant_new_uint32( n_listings ) );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( n_names ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+
+	return g_variant_builder_end( &builder );
+}
@@ -0,0 +1,22 @@
+#ifndef GRFILEINDEX_H
+#define GRFILEINDEX_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef void (*GrFileIndexChunkFunc)( const gchar* const *chunk, gpointer user_data );
+
+#define GR_TYPE_FILE_INDEX ( gr_file_index_get_type() )
+G_DECLARE_FINAL_TYPE( GrFileIndex, gr_file_index, GR, FILE_INDEX, GObject )
+
+GrFileIndex* gr_file_index_new( void );
+void gr_file_index_prefetch( GrFileIndex *self, const gchar *str );
+gboolean gr_file_index_query_async( GrFileIndex *self, const gchar *str, GCancellable *cancellable, GrFileIndexChunkFunc chunk_func, gpointer user_data );
+GVariant* gr_file_index_get_stats( GrFileIndex *self );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,291 @@
+#include "grfrontcoding.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* a lookup decodes not more than a block after the binary search of the heads */
+#define FRONT_CODING_BLOCK_SIZE 16
+
+/*
+ * The encoded strings are the number of strings and the size of a block, the offsets of the
+ * block heads and the strings themselves. A string is stored as a byte of the length of the
+ * prefix shared with the previous string followed by the rest of the string with its
+ * terminating zero. A head shares nothing, so it is stored as it is and compared in place.
+ */
+struct _GrFrontCoding
+{
+	GBytes *bytes;
+	const guchar *data;
+	gsize size;
+
+	guint n_strs;
+	guint block_size;
+	guint n_blocks;
+	const guint32 *heads;
+};
+
+#define FRONT_CODING_HEADER_SIZE ( 2 * sizeof( guint32 ) )
+
+static inline const gchar*
+gr_front_coding_get_head(
+	GrFrontCoding *self,
+	guint block )
+{
+	/* skip the length of the shared prefix, it is zero */
+	return (const gchar*)( self->data + self->heads[block] + 1 );
+}
+
+/* decode the string at the offset of the iterator */
+static void
+gr_front_coding_iter_decode(
+	GrFrontCodingIter *iter )
+{
+	const guchar *p;
+	gsize prefix_len, suffix_len;
+
+	p = iter->coding->data + iter->offset;
+	prefix_len = *p++;
+	suffix_len = strlen( (const gchar*)p );
+	memcpy( iter->str + prefix_len, p, suffix_len + 1 );
+	iter->offset += 1 + suffix_len + 1;
+}
+
+/*
+ * Returns the encoded strings, they must be sorted and not longer than
+ * GR_FRONT_CODING_MAX_LENGTH bytes. The size is a multiple of 4, so the encoded strings
+ * may be followed by other data in the same block of memory.
+ */
+GBytes*
+gr_front_coding_encode(
+	const gchar* const *strs,
+	guint n_strs )
+{
+	GByteArray *arr;
+	const gchar *prev;
+	guint32 header[2], offset;
+	gsize len, prefix_len;
+	guint8 prefix_byte;
+	guint i, n_blocks;
+
+	for( i = 0; i < n_strs; ++i )
+		g_return_val_if_fail( strlen( strs[i] ) <= GR_FRONT_CODING_MAX_LENGTH, NULL );
+
+	n_blocks = ( n_strs + FRONT_CODING_BLOCK_SIZE - 1 ) / FRONT_CODING_BLOCK_SIZE;
+	arr = g_byte_array_new();
+	header[0] = n_strs;
+	header[1] = FRONT_CODING_BLOCK_SIZE;
+	g_byte_array_append( arr, (const guint8*)header, sizeof( header ) );
+	g_byte_array_set_size( arr, FRONT_CODING_HEADER_SIZE + n_blocks * sizeof( guint32 ) );
+
+	prev = "";
+	for( i = 0; i < n_strs; ++i )
+	{
+		len = strlen( strs[i] );
+		if( i % FRONT_CODING_BLOCK_SIZE == 0 )
+		{
+			offset = arr->len;
+			memcpy( arr->data + FRONT_CODING_HEADER_SIZE + ( i / FRONT_CODING_BLOCK_SIZE ) * sizeof( guint32 ), &offset, sizeof( offset ) );
+			prefix_len = 0;
+		}
+		else
+		{
+			for( prefix_len = 0; prefix_len < len && prev[prefix_len] == strs[i][prefix_len]; ++prefix_len );
+		}
+
+		prefix_byte = (guint8)prefix_len;
+		g_byte_array_append( arr, &prefix_byte, 1 );
+		g_byte_array_append( arr, (const guint8*)( strs[i] + prefix_len ), len - prefix_len + 1 );
+		prev = strs[i];
+	}
+
+	g_byte_array_set_size( arr, ( arr->len + sizeof( guint32 ) - 1 ) / sizeof( guint32 ) * sizeof( guint32 ) );
+
+	return g_byte_array_free_to_bytes( arr );
+}
+
+/*
+ * Returns the strings encoded in bytes by gr_front_coding_encode(), NULL if they are
+ * malformed. Empty bytes have no strings. It takes the reference to bytes.
+ */
+GrFrontCoding*
+gr_front_coding_new(
+	GBytes *bytes )
+{
+	GrFrontCoding *self;
+	const guint32 *header;
+	const guchar *data, *p, *end, *zero;
+	gsize size, prev_len, len;
+	guint i;
+
+	g_return_val_if_fail( bytes != NULL, NULL );
+
+	self = g_new( GrFrontCoding, 1 );
+	self->bytes = bytes;
+	self->data = data = (const guchar*)g_bytes_get_data( bytes, &size );
+	self->size = size;
+	self->n_strs = 0;
+	self->block_size = FRONT_CODING_BLOCK_SIZE;
+	self->n_blocks = 0;
+	self->heads = NULL;
+	if( size == 0 )
+		return self;
+
+	if( size < FRONT_CODING_HEADER_SIZE || (guintptr)data % sizeof( guint32 ) != 0 )
+		goto malformed;
+
+	header = (const guint32*)data;
+	self->n_strs = header[0];
+	self->block_size = header[1];
+	if( self->block_size == 0 )
+		goto malformed;
+
+	self->n_blocks = self->n_strs / self->block_size + ( self->n_strs % self->block_size != 0 ? 1 : 0 );
+	if( self->n_blocks > ( size - FRONT_CODING_HEADER_SIZE ) / sizeof( guint32 ) )
+		goto malformed;
+
+	self->heads = header + 2;
+
+	/* every string is checked once, so decoding never reads past the end */
+	end = data + size;
+	p = (const guchar*)( self->heads + self->n_blocks );
+	prev_len = 0;
+	for( i = 0; i < self->n_strs; ++i )
+	{
+		if( p >= end )
+			goto malformed;
+
+		if( i % self->block_size == 0 )
+		{
+			if( self->heads[i / self->block_size] != (guint32)( p - data ) || *p != 0 )
+				goto malformed;
+		}
+		else if( *p > prev_len )
+			goto malformed;
+
+		zero = memchr( p + 1, '\0', (gsize)( end - p - 1 ) );
+		if( zero == NULL )
+			goto malformed;
+
+		len = *p + (gsize)( zero - p - 1 );
+		if( len > GR_FRONT_CODING_MAX_LENGTH )
+			goto malformed;
+
+		prev_len = len;
+		p = zero + 1;
+	}
+
+	return self;
+
+malformed:
+	gr_front_coding_free( self );
+	return NULL;
+}
+
+void
+gr_front_coding_free(
+	GrFrontCoding *self )
+{
+	if( self == NULL )
+		return;
+
+	g_bytes_unref( self->bytes );
+	g_free( self );
+}
+
+guint
+gr_front_coding_get_length(
+	GrFrontCoding *self )
+{
+	g_return_val_if_fail( self != NULL, 0 );
+
+	return self->n_strs;
+}
+
+/*
+ * Returns the index of the first string not less than the len bytes of str and sets iter
+ * on it. The heads are searched in place, then one block is decoded.
+ */
+guint
+gr_front_coding_lower_bound(
+	GrFrontCoding *self,
+	const gchar *str,
+	gsize len,
+	GrFrontCodingIter *iter )
+{
+	guint lo, hi, mid;
+	gboolean valid;
+
+	g_return_val_if_fail( self != NULL, 0 );
+	g_return_val_if_fail( iter != NULL, 0 );
+
+	/* the first block with the head not less than str */
+	lo = 0;
+	hi = self->n_blocks;
+	while( lo < hi )
+	{
+		mid = lo + ( hi - lo ) / 2;
+		if( strncmp( gr_front_coding_get_head( self, mid ), str, len ) < 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* the string is in the previous block or it is the head */
+	valid = gr_front_coding_iter_init( iter, self, lo > 0 ? ( lo - 1 ) * self->block_size : 0 );
+	while( valid && strncmp( iter->str, str, len ) < 0 )
+		valid = gr_front_coding_iter_next( iter );
+
+	return iter->index;
+}
+
+/* sets iter on the string at index, returns FALSE if there is none */
+gboolean
+gr_front_coding_iter_init(
+	GrFrontCodingIter *iter,
+	GrFrontCoding *self,
+	guint index )
+{
+	guint i;
+
+	g_return_val_if_fail( iter != NULL, FALSE );
+	g_return_val_if_fail( self != NULL, FALSE );
+
+	iter->coding = self;
+	iter->str[0] = '\0';
+	if( index >= self->n_strs )
+	{
+		iter->index = self->n_strs;
+		iter->offset = self->size;
+		return FALSE;
+	}
+
+	/* decode from the head of the block */
+	iter->index = index;
+	iter->offset = self->heads[index / self->block_size];
+	for( i = index - index % self->block_size; i <= index; ++i )
+		gr_front_coding_iter_decode( iter );
+
+	return TRUE;
+}
+
+/* moves iter to the next string, returns FALSE if there is none */
+gboolean
+gr_front_coding_iter_next(
+	GrFrontCodingIter *iter )
+{
+	g_return_val_if_fail( iter != NULL, FALSE );
+
+	if( iter->index >= iter->coding->n_strs )
+		return FALSE;
+
+	++iter->index;
+	if( iter->index == iter->coding->n_strs )
+	{
+		iter->str[0] = '\0';
+		return FALSE;
+	}
+
+	gr_front_coding_iter_decode( iter );
+
+	return TRUE;
+}
@@ -0,0 +1,33 @@
+#ifndef GRFRONTCODING_H
+#define GRFRONTCODING_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* the length of a shared prefix is stored in a byte */
+#define GR_FRONT_CODING_MAX_LENGTH 255
+
+typedef struct _GrFrontCoding GrFrontCoding;
+
+/* decodes the strings one after another, it may live on the stack */
+struct _GrFrontCodingIter
+{
+	GrFrontCoding *coding;
+	guint index;
+	gsize offset; /* of the next string */
+	gchar str[GR_FRONT_CODING_MAX_LENGTH + 1];
+};
+typedef struct _GrFrontCodingIter GrFrontCodingIter;
+
+GBytes* gr_front_coding_encode( const gchar* const *strs, guint n_strs );
+GrFrontCoding* gr_front_coding_new( GBytes *bytes );
+void gr_front_coding_free( GrFrontCoding *self );
+guint gr_front_coding_get_length( GrFrontCoding *self );
+guint gr_front_coding_lower_bound( GrFrontCoding *self, const gchar *str, gsize len, GrFrontCodingIter *iter );
+gboolean gr_front_coding_iter_init( GrFrontCodingIter *iter, GrFrontCoding *self, guint index );
+gboolean gr_front_coding_iter_next( GrFrontCodingIter *iter );
+
+G_END_DECLS
+
+#endif
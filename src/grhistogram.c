@@ -0,0 +1,148 @@
+#include "grhistogram.h"
+
+#include <glib.h>
+#include <math.h>
+
+/*
+ * A power of two range of values is split into HISTOGRAM_SUB_BUCKETS buckets, so a value
+ * is counted with an error below a quarter of it. The values below HISTOGRAM_SUB_BUCKETS
+ * have their own buckets, the values above HISTOGRAM_MAX_BITS bits share the last one.
+ */
+#define HISTOGRAM_SUB_BITS 2
+#define HISTOGRAM_SUB_BUCKETS ( 1 << HISTOGRAM_SUB_BITS )
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_N_BUCKETS ( ( HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB_BUCKETS )
+
+/* recording is a few integer operations, nothing is allocated */
+struct _GrHistogram
+{
+	guint64 counts[HISTOGRAM_N_BUCKETS];
+	guint64 count;
+	gint64 max;
+};
+
+static guint
+gr_histogram_get_bucket(
+	guint64 value )
+{
+	guint bits;
+
+	if( value < HISTOGRAM_SUB_BUCKETS )
+		return (guint)value;
+
+	bits = g_bit_storage( value );
+	if( bits > HISTOGRAM_MAX_BITS )
+		return HISTOGRAM_N_BUCKETS - 1;
+
+	/* the highest bits after the leading one select the bucket */
+	return ( bits - HISTOGRAM_SUB_BITS ) * HISTOGRAM_SUB_BUCKETS + (guint)( ( value >> ( bits - 1 - HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB_BUCKETS - 1 ) );
+}
+
+/* the greatest value counted by the bucket */
+static guint64
+gr_histogram_get_bucket_max(
+	guint bucket )
+{
+	guint shift;
+
+	if( bucket < HISTOGRAM_SUB_BUCKETS )
+		return bucket;
+
+	shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+
+	return ( ( (guint64)( HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS ) + 1 ) << shift ) - 1;
+}
+
+GrHistogram*
+gr_histogram_new(
+	void )
+{
+	return g_new0( GrHistogram, 1 );
+}
+
+void
+gr_histogram_free(
+	GrHistogram *self )
+{
+	g_free( self );
+}
+
+/* negative values are counted as 0 */
+void
+gr_histogram_record(
+	GrHistogram *self,
+	gint64 value )
+{
+	g_return_if_fail( self != NULL );
+
+	value = MAX( value, 0 );
+	++self->counts[gr_histogram_get_bucket( (guint64)value )];
+	++self->count;
+	self->max = MAX( self->max, value );
+}
+
+guint64
+gr_histogram_get_count(
+	GrHistogram *self )
+{
+	g_return_val_if_fail( self != NULL, 0 );
+
+	return self->count;
+}
+
+/*
+ * Returns the value not exceeded by the percentile of the recorded values, rounded up to the
+ * end of its bucket but not above the maximum; 0 if nothing is recorded.
+ */
+gint64
+gr_histogram_get_percentile(
+	GrHistogram *self,
+	gdouble percentile )
+{
+	guint64 rank, sum;
+	guint i;
+
+	g_return_val_if_fail( self != NULL, 0 );
+
+	if( self->count == 0 )
+		return 0;
+
+	rank = (guint64)ceil( CLAMP( percentile, 0.0, 100.0 ) / 100.0 * (gdouble)self->count );
+	rank = MAX( rank, 1 );
+	sum = 0;
+	for( i = 0; i < HISTOGRAM_N_BUCKETS; ++i )
+	{
+		sum += self->counts[i];
+		if( sum >= rank )
+			return MIN( (gint64)gr_histogram_get_bucket_max( i ), self->max );
+	}
+
+	return self->max;
+}
+
+gint64
+gr_histogram_get_max(
+	GrHistogram *self )
+{
+	g_return_val_if_fail( self != NULL, 0 );
+
+	return self->max;
+}
+
+/* Returns a{sv}: the number of values, the 50th and the 99th percentiles and the maximum */
+GVariant*
+gr_histogram_get_stats(
+	GrHistogram *self )
+{
+	GVariantBuilder builder;
+
+	g_return_val_if_fail( self != NULL, NULL );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "count", g_variant_new_uint64( self->count ) );
+	g_variant_builder_add( &builder, "{sv}", "p50", g_variant_new_int64( gr_histogram_get_percentile( self, 50.0 ) ) );
+	g_variant_builder_add( &builder, "{sv}", "p99", g_variant_new_int64( gr_histogram_get_percentile( self, 99.0 ) ) );
+	g_variant_builder_add( &builder, "{sv}", "max", g_variant_new_int64( self->max ) );
+
+	return g_variant_builder_end( &builder );
+}
@@ -0,0 +1,20 @@
+#ifndef GRHISTOGRAM_H
+#define GRHISTOGRAM_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrHistogram GrHistogram;
+
+GrHistogram* gr_histogram_new( void );
+void gr_histogram_free( GrHistogram *self );
+void gr_histogram_record( GrHistogram *self, gint64 value );
+guint64 gr_histogram_get_count( GrHistogram *self );
+gint64 gr_histogram_get_percentile( GrHistogram *self, gdouble percentile );
+gint64 gr_histogram_get_max( GrHistogram *self );
+GVariant* gr_histogram_get_stats( GrHistogram *self );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,2039 @@
+#include "grhistory.h"
+
+#include "config.h"
+#include "grcompletionprovider.h"
+#include "grstats.h"
+#include "grsuffixarray.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <math.h>
+
+#define HISTORY_BLANKS " \t"
+
+#define HISTORY_HALF_LIFE_SECONDS ( HISTORY_HALF_LIFE * 24.0 * 3600.0 )
+
+/* the files are compacted when they have more lines than twice the records plus this */
+#define HISTORY_COMPACT_SLACK 64
+
+/* a command line of the history */
+struct _GrHistoryRecord
+{
+	gchar *text; /* a GRefString shared with the snapshots */
+	const gchar *key; /* the match key, it follows the text in the same allocation */
+	guint uses;
+	gint64 last_use; /* seconds since the epoch */
+};
+typedef struct _GrHistoryRecord GrHistoryRecord;
+
+/* a record matched by a query */
+struct _GrHistoryRank
+{
+	gdouble frecency;
+	guint index; /* breaks ties, the greater is the more recent */
+	GrHistoryRecord *record;
+};
+typedef struct _GrHistoryRank GrHistoryRank;
+
+/* the bytes of a file read so far, the ones after them are appended by other instances */
+struct _GrHistoryTail
+{
+	guint64 inode; /* a rewritten file is a new one */
+	goffset offset;
+};
+typedef struct _GrHistoryTail GrHistoryTail;
+
+/* arguments used with a command */
+struct _GrHistoryArgs
+{
+	gchar *args; /* a GRefString shared with the snapshots */
+	guint uses;
+	gint64 last_use; /* seconds since the epoch */
+	guint64 order; /* breaks ties, the greater is the more recently indexed */
+};
+typedef struct _GrHistoryArgs GrHistoryArgs;
+
+/* the records sorted by their texts or keys, with the best record of every range of them */
+struct _GrHistoryPrefixIndex
+{
+	const gchar **strings; /* the text or the key of every record */
+	gdouble *orders; /* the frecency order of every record */
+	GArray *sorted; /* indexes of the records by their strings */
+	guint *tree; /* the best record of the ranges of sorted, the leaves start at n_records */
+};
+typedef struct _GrHistoryPrefixIndex GrHistoryPrefixIndex;
+
+/*
+ * An immutable version of the records and of their arguments read by the query threads. The
+ * main thread builds the next version on every change and swaps it in, the old one is freed
+ * when its last reader drops it. The strings are shared with the records.
+ */
+struct _GrHistorySnapshot
+{
+	gint ref_count;
+
+	GrHistoryRecord *records; /* copies, the least recently used first */
+	guint n_records;
+
+	/* the command to the GArray of GrHistoryArgs, the highest frecency first */
+	GHashTable *commands;
+
+	/* by the texts and by the keys, built once on the first lookup of the snapshot */
+	GrHistoryPrefixIndex *prefix_indexes[2];
+
+	guint64 stamp; /* hash of the records */
+};
+typedef struct _GrHistorySnapshot GrHistorySnapshot;
+
+struct _GrHistory
+{
+	GObject parent_instance;
+
+	gchar *file_path;
+	gchar *rank_path;
+	guint size; /* 0 is unlimited */
+
+	/* the files are neither appended nor compacted, they may be shared by other users */
+	gboolean read_only;
+
+	/* match keys instead of texts */
+	gint ignore_case;
+
+	/* the history file does not end with a line breaker */
+	gboolean needs_line_breaker;
+
+	/* only the lines appended to the files are read on their change, unless the files are
+	 * rewritten */
+	GrHistoryTail file_tail;
+	GrHistoryTail rank_tail;
+	GFileMonitor *file_monitor;
+	GFileMonitor *rank_monitor;
+
+	/* records, record_table, suffixes and commands are used by the main thread only, the
+	 * query threads read the snapshot of them; the mutex guards taking the snapshot */
+	GMutex mutex;
+	GrHistorySnapshot *snapshot;
+	GPtrArray *records; /* the least recently used first */
+	GHashTable *record_table;
+
+	/* lines of the records for the substring search, built on the first search */
+	GrSuffixArray *suffixes;
+
+	/* the first word of a command line to the array of GrHistoryArgs, the highest frecency first */
+	GHashTable *commands;
+	guint64 n_uses;
+
+	gint64 load_time; /* microseconds */
+};
+typedef struct _GrHistory GrHistory;
+
+enum _GrHistoryPropertyID
+{
+	PROP_0, /* 0 is reserved for GObject */
+
+	PROP_FILE_PATH,
+	PROP_SIZE,
+	PROP_READ_ONLY,
+	PROP_IGNORE_CASE,
+
+	N_PROPS
+};
+typedef enum _GrHistoryPropertyID GrHistoryPropertyID;
+
+static GParamSpec *object_props[N_PROPS] = { NULL, };
+
+static void gr_history_completion_provider_init( GrCompletionProviderInterface *iface );
+
+G_DEFINE_TYPE_WITH_CODE( GrHistory, gr_history, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE( GR_TYPE_COMPLETION_PROVIDER, gr_history_completion_provider_init ) )
+
+static GrHistoryRecord*
+gr_history_record_new(
+	const gchar *text )
+{
+	GrHistoryRecord *record;
+	gchar *key, *buf;
+	gsize text_len, key_len;
+
+	key = gr_completion_fold( text );
+	text_len = strlen( text );
+	key_len = strlen( key );
+
+	/* the key follows the text, so they share the reference */
+	buf = g_malloc( text_len + key_len + 2 );
+	memcpy( buf, text, text_len + 1 );
+	memcpy( buf + text_len + 1, key, key_len + 1 );
+
+	record = g_new( GrHistoryRecord, 1 );
+	record->text = g_ref_string_new_len( buf, (gssize)( text_len + 1 + key_len ) );
+	record->key = record->text + text_len + 1;
+	record->uses = 0;
+	record->last_use = 0;
+	g_free( buf );
+	g_free( key );
+
+	return record;
+}
+
+static void
+gr_history_record_free(
+	GrHistoryRecord *record )
+{
+	g_ref_string_release( record->text );
+	g_free( record );
+}
+
+/* uses decayed by the time since the last use */
+static gdouble
+gr_history_frecency(
+	guint uses,
+	gint64 last_use,
+	gint64 now )
+{
+	gdouble age;
+
+	age = (gdouble)MAX( now - last_use, 0 );
+
+	return uses * exp( -G_LN2 * age / HISTORY_HALF_LIFE_SECONDS );
+}
+
+/*
+ * The logarithm of the frecency without the decay up to now, all frecencies decay alike, so
+ * it orders them the same at any time, and it does not underflow for old uses.
+ */
+static gdouble
+gr_history_frecency_order(
+	guint uses,
+	gint64 last_use )
+{
+	return log( (gdouble)uses ) + G_LN2 * (gdouble)last_use / HISTORY_HALF_LIFE_SECONDS;
+}
+
+static gdouble
+gr_history_record_get_frecency(
+	const GrHistoryRecord *record,
+	gint64 now )
+{
+	return gr_history_frecency( record->uses, record->last_use, now );
+}
+
+/* among equal frecencies the later record is the more recent one */
+static inline gboolean
+gr_history_rank_less(
+	const GrHistoryRank *a,
+	const GrHistoryRank *b )
+{
+	return a->frecency < b->frecency || ( a->frecency == b->frecency && a->index < b->index );
+}
+
+/* the heap keeps the lowest rank on the top */
+static void
+gr_history_heap_sift_up(
+	GrHistoryRank *heap,
+	guint i )
+{
+	GrHistoryRank tmp;
+	guint parent;
+
+	while( i > 0 )
+	{
+		parent = ( i - 1 ) / 2;
+		if( !gr_history_rank_less( &heap[i], &heap[parent] ) )
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[parent];
+		heap[parent] = tmp;
+		i = parent;
+	}
+}
+
+static void
+gr_history_heap_sift_down(
+	GrHistoryRank *heap,
+	guint len,
+	guint i )
+{
+	GrHistoryRank tmp;
+	guint child;
+
+	for( child = 2 * i + 1; child < len; child = 2 * i + 1 )
+	{
+		if( child + 1 < len && gr_history_rank_less( &heap[child + 1], &heap[child] ) )
+			++child;
+		if( !gr_history_rank_less( &heap[child], &heap[i] ) )
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+/* keep the k highest ranks in the heap */
+static void
+gr_history_heap_offer(
+	GrHistoryRank *heap,
+	guint *len,
+	guint k,
+	const GrHistoryRank *rank )
+{
+	if( *len < k )
+	{
+		heap[*len] = *rank;
+		gr_history_heap_sift_up( heap, *len );
+		*len += 1;
+	}
+	else if( k > 0 && gr_history_rank_less( &heap[0], rank ) )
+	{
+		heap[0] = *rank;
+		gr_history_heap_sift_down( heap, *len, 0 );
+	}
+}
+
+/* move the lowest rank to the back until the heap is sorted from the highest */
+static void
+gr_history_heap_sort(
+	GrHistoryRank *heap,
+	guint len )
+{
+	GrHistoryRank tmp;
+	guint n;
+
+	for( n = len; n > 1; --n )
+	{
+		tmp = heap[0];
+		heap[0] = heap[n - 1];
+		heap[n - 1] = tmp;
+		gr_history_heap_sift_down( heap, n - 1, 0 );
+	}
+}
+
+static void
+gr_history_args_free(
+	GrHistoryArgs *args )
+{
+	g_ref_string_release( args->args );
+	g_free( args );
+}
+
+static void
+gr_history_args_clear(
+	gpointer data )
+{
+	g_ref_string_release( ( (GrHistoryArgs*)data )->args );
+}
+
+static gint
+gr_history_prefix_index_compare(
+	gconstpointer a,
+	gconstpointer b,
+	gpointer user_data )
+{
+	const gchar **strings = (const gchar**)user_data;
+
+	return strcmp( strings[*(const guint*)a], strings[*(const guint*)b] );
+}
+
+/* the record of the higher frecency of a and b, the later one among equal frecencies, G_MAXUINT is none */
+static inline guint
+gr_history_prefix_index_best(
+	const GrHistoryPrefixIndex *index,
+	guint a,
+	guint b )
+{
+	if( a == G_MAXUINT )
+		return b;
+	if( b == G_MAXUINT )
+		return a;
+
+	if( index->orders[a] > index->orders[b] || ( index->orders[a] == index->orders[b] && a > b ) )
+		return a;
+
+	return b;
+}
+
+static GrHistoryPrefixIndex*
+gr_history_prefix_index_new(
+	const GrHistoryRecord *records,
+	guint n_records,
+	gboolean folded )
+{
+	GrHistoryPrefixIndex *index;
+	guint i;
+
+	index = g_new( GrHistoryPrefixIndex, 1 );
+	index->strings = g_new( const gchar*, MAX( n_records, 1 ) );
+	index->orders = g_new( gdouble, MAX( n_records, 1 ) );
+	index->sorted = g_array_sized_new( FALSE, FALSE, sizeof( guint ), n_records );
+	for( i = 0; i < n_records; ++i )
+	{
+		index->strings[i] = folded ? records[i].key : records[i].text;
+		index->orders[i] = gr_history_frecency_order( records[i].uses, records[i].last_use );
+		g_array_append_val( index->sorted, i );
+	}
+	g_array_sort_with_data( index->sorted, gr_history_prefix_index_compare, index->strings );
+
+	/* every node is the best of its two children */
+	index->tree = g_new( guint, MAX( 2 * n_records, 1 ) );
+	for( i = 0; i < n_records; ++i )
+		index->tree[n_records + i] = g_array_index( index->sorted, guint, i );
+	for( i = n_records; i-- > 1; )
+		index->tree[i] = gr_history_prefix_index_best( index, index->tree[2 * i], index->tree[2 * i + 1] );
+
+	return index;
+}
+
+static void
+gr_history_prefix_index_free(
+	GrHistoryPrefixIndex *index )
+{
+	if( index == NULL )
+		return;
+
+	g_free( index->strings );
+	g_free( index->orders );
+	g_array_unref( index->sorted );
+	g_free( index->tree );
+	g_free( index );
+}
+
+/* the strings starting with the len bytes of str are the range [lo, hi) of the sorted ones */
+static void
+gr_history_prefix_index_range(
+	const GrHistoryPrefixIndex *index,
+	const gchar *str,
+	gsize len,
+	guint *lo,
+	guint *hi )
+{
+	guint n, l, h, mid;
+
+	n = index->sorted->len;
+	for( l = 0, h = n; l < h; )
+	{
+		mid = l + ( h - l ) / 2;
+		if( strncmp( index->strings[g_array_index( index->sorted, guint, mid )], str, len ) < 0 )
+			l = mid + 1;
+		else
+			h = mid;
+	}
+	*lo = l;
+	for( h = n; l < h; )
+	{
+		mid = l + ( h - l ) / 2;
+		if( strncmp( index->strings[g_array_index( index->sorted, guint, mid )], str, len ) <= 0 )
+			l = mid + 1;
+		else
+			h = mid;
+	}
+	*hi = l;
+}
+
+/* returns the record of the highest frecency whose string starts with the len bytes of str, G_MAXUINT if none */
+static guint
+gr_history_prefix_index_lookup(
+	const GrHistoryPrefixIndex *index,
+	const gchar *str,
+	gsize len )
+{
+	guint n, lo, hi, l, r, best;
+
+	n = index->sorted->len;
+	gr_history_prefix_index_range( index, str, len, &lo, &hi );
+
+	/* the best of the range is the best of O(log n) nodes covering it */
+	best = G_MAXUINT;
+	for( l = lo + n, r = hi + n; l < r; l /= 2, r /= 2 )
+	{
+		if( l & 1 )
+			best = gr_history_prefix_index_best( index, best, index->tree[l++] );
+		if( r & 1 )
+			best = gr_history_prefix_index_best( index, best, index->tree[--r] );
+	}
+
+	return best;
+}
+
+/* the node whose best record is the better one goes first */
+static inline gboolean
+gr_history_prefix_index_node_less(
+	const GrHistoryPrefixIndex *index,
+	guint a,
+	guint b )
+{
+	return index->tree[a] != index->tree[b] &&
+		gr_history_prefix_index_best( index, index->tree[a], index->tree[b] ) == index->tree[b];
+}
+
+static void
+gr_history_prefix_index_push(
+	const GrHistoryPrefixIndex *index,
+	GArray *heap,
+	guint node )
+{
+	guint *nodes, i, parent, tmp;
+
+	g_array_append_val( heap, node );
+	nodes = (guint*)heap->data;
+	for( i = heap->len - 1; i > 0; i = parent )
+	{
+		parent = ( i - 1 ) / 2;
+		if( !gr_history_prefix_index_node_less( index, nodes[parent], nodes[i] ) )
+			break;
+
+		tmp = nodes[i];
+		nodes[i] = nodes[parent];
+		nodes[parent] = tmp;
+	}
+}
+
+static guint
+gr_history_prefix_index_pop(
+	const GrHistoryPrefixIndex *index,
+	GArray *heap )
+{
+	guint *nodes, top, i, child, tmp;
+
+	nodes = (guint*)heap->data;
+	top = nodes[0];
+	nodes[0] = nodes[heap->len - 1];
+	g_array_set_size( heap, heap->len - 1 );
+
+	for( i = 0, child = 1; child < heap->len; i = child, child = 2 * i + 1 )
+	{
+		if( child + 1 < heap->len && gr_history_prefix_index_node_less( index, nodes[child], nodes[child + 1] ) )
+			++child;
+		if( !gr_history_prefix_index_node_less( index, nodes[i], nodes[child] ) )
+			break;
+
+		tmp = nodes[i];
+		nodes[i] = nodes[child];
+		nodes[child] = tmp;
+	}
+
+	return top;
+}
+
+/*
+ * Sets records to the k records of the highest frecency whose strings start with the len bytes
+ * of str, the best first, and returns their number. The nodes covering the range are searched
+ * best first: a node is split into its children until a leaf goes out, so k records cost
+ * O(k log n) nodes whatever the size of the range.
+ */
+static guint
+gr_history_prefix_index_top(
+	const GrHistoryPrefixIndex *index,
+	const gchar *str,
+	gsize len,
+	guint k,
+	guint *records )
+{
+	GArray *heap;
+	guint n, lo, hi, l, r, node, count;
+
+	n = index->sorted->len;
+	gr_history_prefix_index_range( index, str, len, &lo, &hi );
+	if( lo == hi || k == 0 )
+		return 0;
+
+	heap = g_array_new( FALSE, FALSE, sizeof( guint ) );
+	for( l = lo + n, r = hi + n; l < r; l /= 2, r /= 2 )
+	{
+		if( l & 1 )
+			gr_history_prefix_index_push( index, heap, l++ );
+		if( r & 1 )
+			gr_history_prefix_index_push( index, heap, --r );
+	}
+
+	count = 0;
+	while( count < k && heap->len > 0 )
+	{
+		node = gr_history_prefix_index_pop( index, heap );
+		if( node >= n )
+			records[count++] = index->tree[node];
+		else
+		{
+			gr_history_prefix_index_push( index, heap, 2 * node );
+			gr_history_prefix_index_push( index, heap, 2 * node + 1 );
+		}
+	}
+	g_array_unref( heap );
+
+	return count;
+}
+
+/* copies the records and the arguments of the main thread, sharing their strings */
+static GrHistorySnapshot*
+gr_history_snapshot_new(
+	GrHistory *self )
+{
+	GrHistorySnapshot *snapshot;
+	GrHistoryRecord *record;
+	GrHistoryArgs a;
+	GHashTableIter iter;
+	gpointer key, value;
+	GPtrArray *list;
+	GArray *arr;
+	guint i;
+
+	snapshot = g_new( GrHistorySnapshot, 1 );
+	snapshot->ref_count = 1;
+	snapshot->n_records = self->records->len;
+	snapshot->records = g_new( GrHistoryRecord, MAX( snapshot->n_records, 1 ) );
+	snapshot->stamp = 0;
+	for( i = 0; i < snapshot->n_records; ++i )
+	{
+		record = &snapshot->records[i];
+		*record = *(GrHistoryRecord*)g_ptr_array_index( self->records, i );
+		g_ref_string_acquire( record->text );
+
+		snapshot->stamp = gr_completion_hash( snapshot->stamp, record->text, strlen( record->text ) + 1 );
+		snapshot->stamp = gr_completion_hash( snapshot->stamp, &record->uses, sizeof( record->uses ) );
+		snapshot->stamp = gr_completion_hash( snapshot->stamp, &record->last_use, sizeof( record->last_use ) );
+	}
+
+	snapshot->prefix_indexes[0] = NULL;
+	snapshot->prefix_indexes[1] = NULL;
+
+	snapshot->commands = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_ref_string_release, (GDestroyNotify)g_array_unref );
+	g_hash_table_iter_init( &iter, self->commands );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		list = (GPtrArray*)value;
+		arr = g_array_sized_new( FALSE, FALSE, sizeof( GrHistoryArgs ), list->len );
+		g_array_set_clear_func( arr, gr_history_args_clear );
+		for( i = 0; i < list->len; ++i )
+		{
+			a = *(GrHistoryArgs*)g_ptr_array_index( list, i );
+			g_ref_string_acquire( a.args );
+			g_array_append_val( arr, a );
+		}
+		g_hash_table_insert( snapshot->commands, g_ref_string_acquire( (gchar*)key ), arr );
+	}
+
+	return snapshot;
+}
+
+static GrHistorySnapshot*
+gr_history_snapshot_ref(
+	GrHistorySnapshot *snapshot )
+{
+	g_atomic_int_inc( &snapshot->ref_count );
+
+	return snapshot;
+}
+
+static void
+gr_history_snapshot_unref(
+	GrHistorySnapshot *snapshot )
+{
+	guint i;
+
+	if( snapshot == NULL || !g_atomic_int_dec_and_test( &snapshot->ref_count ) )
+		return;
+
+	for( i = 0; i < snapshot->n_records; ++i )
+		g_ref_string_release( snapshot->records[i].text );
+	g_free( snapshot->records );
+	g_hash_table_unref( snapshot->commands );
+	gr_history_prefix_index_free( snapshot->prefix_indexes[0] );
+	gr_history_prefix_index_free( snapshot->prefix_indexes[1] );
+	g_free( snapshot );
+}
+
+/* the prefix index of the texts, or of the keys if folded, the first reader builds it */
+static const GrHistoryPrefixIndex*
+gr_history_snapshot_get_prefix_index(
+	GrHistorySnapshot *snapshot,
+	gboolean folded )
+{
+	GrHistoryPrefixIndex **index;
+
+	index = &snapshot->prefix_indexes[folded ? 1 : 0];
+	if( g_once_init_enter( index ) )
+		g_once_init_leave( index, gr_history_prefix_index_new( snapshot->records, snapshot->n_records, folded ) );
+
+	return *index;
+}
+
+/* returns the current snapshot, the reader unrefs it */
+static GrHistorySnapshot*
+gr_history_acquire_snapshot(
+	GrHistory *self )
+{
+	GrHistorySnapshot *snapshot;
+
+	/* the readers still lock: the mutex is held only to take the reference, never while a
+	 * snapshot is built or read, but the reads are not lock-free */
+	g_mutex_lock( &self->mutex );
+	snapshot = gr_history_snapshot_ref( self->snapshot );
+	g_mutex_unlock( &self->mutex );
+
+	return snapshot;
+}
+
+/* swaps in the snapshot of the changed records, the old one lives while it is read */
+static void
+gr_history_publish(
+	GrHistory *self )
+{
+	GrHistorySnapshot *snapshot, *old;
+
+	snapshot = gr_history_snapshot_new( self );
+
+	g_mutex_lock( &self->mutex );
+	old = self->snapshot;
+	self->snapshot = snapshot;
+	g_mutex_unlock( &self->mutex );
+
+	gr_history_snapshot_unref( old );
+}
+
+/* returns the length of the command, *args points to the arguments or it is NULL */
+static gsize
+gr_history_split_line(
+	const gchar *line,
+	const gchar **args )
+{
+	gsize command_len;
+
+	command_len = strcspn( line, HISTORY_BLANKS );
+	*args = NULL;
+	if( command_len == 0 || line[command_len] == '\0' )
+		return command_len;
+
+	*args = line + command_len + strspn( line + command_len, HISTORY_BLANKS );
+
+	return command_len;
+}
+
+/* count uses of the line at last_use in the index of arguments */
+static void
+gr_history_index_line(
+	GrHistory *self,
+	const gchar *line,
+	guint uses,
+	gint64 last_use )
+{
+	const gchar *args;
+	gchar *command;
+	gsize command_len;
+	GPtrArray *list;
+	GrHistoryArgs *a, *prev;
+	gdouble a_order, prev_order;
+	guint i;
+
+	command_len = gr_history_split_line( line, &args );
+	if( args == NULL || *args == '\0' )
+		return;
+
+	command = g_strndup( line, command_len );
+	list = (GPtrArray*)g_hash_table_lookup( self->commands, command );
+	if( list == NULL )
+	{
+		list = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_history_args_free );
+		g_hash_table_insert( self->commands, g_ref_string_new( command ), list );
+	}
+	g_free( command );
+
+	for( i = 0; i < list->len; ++i )
+		if( g_strcmp0( ( (GrHistoryArgs*)g_ptr_array_index( list, i ) )->args, args ) == 0 )
+			break;
+
+	if( i == list->len )
+	{
+		a = g_new( GrHistoryArgs, 1 );
+		a->args = g_ref_string_new( args );
+		a->uses = 0;
+		a->last_use = 0;
+		g_ptr_array_add( list, a );
+	}
+	a = (GrHistoryArgs*)g_ptr_array_index( list, i );
+	a->uses += uses;
+	a->last_use = MAX( a->last_use, last_use );
+	a->order = ++self->n_uses;
+
+	/* keep the list ranked like the commands: the highest frecency first, the recently indexed first among equal */
+	a_order = gr_history_frecency_order( a->uses, a->last_use );
+	for( ; i > 0; --i )
+	{
+		prev = (GrHistoryArgs*)g_ptr_array_index( list, i - 1 );
+		prev_order = gr_history_frecency_order( prev->uses, prev->last_use );
+		if( prev_order > a_order || ( prev_order == a_order && prev->order > a->order ) )
+			break;
+
+		g_ptr_array_index( list, i ) = prev;
+		g_ptr_array_index( list, i - 1 ) = a;
+	}
+}
+
+/* take back uses of the line from the index of arguments, the arguments used no more are removed */
+static void
+gr_history_unindex_line(
+	GrHistory *self,
+	const gchar *line,
+	guint uses )
+{
+	const gchar *args;
+	gchar *command;
+	gsize command_len;
+	GPtrArray *list;
+	GrHistoryArgs *a, *next;
+	gdouble a_order, next_order;
+	guint i;
+
+	command_len = gr_history_split_line( line, &args );
+	if( args == NULL || *args == '\0' )
+		return;
+
+	command = g_strndup( line, command_len );
+	list = (GPtrArray*)g_hash_table_lookup( self->commands, command );
+	for( i = 0; list != NULL && i < list->len; ++i )
+		if( g_strcmp0( ( (GrHistoryArgs*)g_ptr_array_index( list, i ) )->args, args ) == 0 )
+			break;
+
+	if( list == NULL || i == list->len )
+	{
+		g_free( command );
+		return;
+	}
+
+	a = (GrHistoryArgs*)g_ptr_array_index( list, i );
+	a->uses -= MIN( uses, a->uses );
+	if( a->uses == 0 )
+	{
+		g_ptr_array_remove_index( list, i );
+		if( list->len == 0 )
+			g_hash_table_remove( self->commands, command );
+		g_free( command );
+		return;
+	}
+	g_free( command );
+
+	/* the arguments lose their rank, move them down */
+	a_order = gr_history_frecency_order( a->uses, a->last_use );
+	for( ; i + 1 < list->len; ++i )
+	{
+		next = (GrHistoryArgs*)g_ptr_array_index( list, i + 1 );
+		next_order = gr_history_frecency_order( next->uses, next->last_use );
+		if( next_order < a_order || ( next_order == a_order && next->order < a->order ) )
+			break;
+
+		g_ptr_array_index( list, i ) = next;
+		g_ptr_array_index( list, i + 1 ) = a;
+	}
+}
+
+/* append data to the file, the file and its directory are created if needed */
+static gboolean
+gr_history_append_to_file(
+	const gchar *path,
+	const gchar *data,
+	gsize size )
+{
+	GFile *file, *dir;
+	GFileOutputStream *stream;
+	GError *error = NULL;
+	gboolean ret;
+
+	file = g_file_new_for_path( path );
+
+	/* if it cannot create directory, it will not append */
+	dir = g_file_get_parent( file );
+	if( !g_file_make_directory_with_parents( dir, NULL, &error ) &&
+		!g_error_matches( error, G_IO_ERROR, G_IO_ERROR_EXISTS ) )
+	{
+		g_object_unref( G_OBJECT( dir ) );
+		g_object_unref( G_OBJECT( file ) );
+		g_clear_error( &error );
+		return FALSE;
+	}
+	g_clear_error( &error );
+	g_object_unref( G_OBJECT( dir ) );
+
+	stream = g_file_append_to( file, G_FILE_CREATE_PRIVATE, NULL, NULL );
+	g_object_unref( G_OBJECT( file ) );
+	if( stream == NULL )
+		return FALSE;
+
+	ret = g_output_stream_write_all( G_OUTPUT_STREAM( stream ), data, size, NULL, NULL, NULL );
+	g_output_stream_close( G_OUTPUT_STREAM( stream ), NULL, NULL );
+	g_object_unref( G_OBJECT( stream ) );
+
+	return ret;
+}
+
+/* returns FALSE, if the file cannot be accessed */
+static gboolean
+gr_history_stat_file(
+	const gchar *path,
+	guint64 *inode,
+	goffset *size )
+{
+	GStatBuf buf;
+
+	if( path == NULL || g_stat( path, &buf ) != 0 )
+		return FALSE;
+
+	*inode = (guint64)buf.st_ino;
+	*size = (goffset)buf.st_size;
+
+	return TRUE;
+}
+
+/* the tail is at the end of the file as it is now, for the file just read or written by itself */
+static void
+gr_history_tail_reset(
+	GrHistoryTail *tail,
+	const gchar *path )
+{
+	if( !gr_history_stat_file( path, &tail->inode, &tail->offset ) )
+	{
+		tail->inode = 0;
+		tail->offset = 0;
+	}
+}
+
+/*
+ * Moves the tail over the len bytes just appended by itself. If another instance has appended
+ * to the file at the same time, the tail stays, and the own line is read again as theirs.
+ */
+static void
+gr_history_tail_skip(
+	GrHistoryTail *tail,
+	const gchar *path,
+	gsize len )
+{
+	guint64 inode;
+	goffset size;
+
+	if( gr_history_stat_file( path, &inode, &size ) && inode == tail->inode && size == tail->offset + (goffset)len )
+		tail->offset = size;
+	else if( tail->inode == 0 && tail->offset == 0 )
+		gr_history_tail_reset( tail, path ); /* the file is created by the line */
+}
+
+/*
+ * Returns the complete lines appended to the file after the tail and moves the tail after
+ * them, NULL if there are none. Sets rewritten, if the file is replaced or truncated since
+ * the tail, then it is to be read again as a whole.
+ */
+static gchar*
+gr_history_read_tail(
+	const gchar *path,
+	GrHistoryTail *tail,
+	gsize *len,
+	gboolean *rewritten )
+{
+	GFile *file;
+	GFileInputStream *stream;
+	guint64 inode;
+	goffset size;
+	gchar *data;
+	const gchar *end;
+	gsize n_read;
+	gboolean ret;
+
+	*rewritten = FALSE;
+	if( !gr_history_stat_file( path, &inode, &size ) )
+		return NULL;
+
+	if( inode != tail->inode || size < tail->offset )
+	{
+		*rewritten = TRUE;
+		return NULL;
+	}
+	if( size == tail->offset )
+		return NULL;
+
+	file = g_file_new_for_path( path );
+	stream = g_file_read( file, NULL, NULL );
+	g_object_unref( G_OBJECT( file ) );
+	if( stream == NULL )
+		return NULL;
+
+	data = g_malloc( (gsize)( size - tail->offset ) + 1 );
+	ret = g_seekable_seek( G_SEEKABLE( stream ), tail->offset, G_SEEK_SET, NULL, NULL ) &&
+		g_input_stream_read_all( G_INPUT_STREAM( stream ), data, (gsize)( size - tail->offset ), &n_read, NULL, NULL );
+	g_input_stream_close( G_INPUT_STREAM( stream ), NULL, NULL );
+	g_object_unref( G_OBJECT( stream ) );
+	if( !ret )
+	{
+		g_free( data );
+		return NULL;
+	}
+
+	/* a line being written is read with the next change */
+	end = g_strrstr_len( data, (gssize)n_read, PROGRAM_LINE_BREAKER );
+	if( end == NULL )
+	{
+		g_free( data );
+		return NULL;
+	}
+	*len = (gsize)( end - data ) + strlen( PROGRAM_LINE_BREAKER );
+	data[*len] = '\0';
+	tail->offset += (goffset)*len;
+
+	return data;
+}
+
+/*
+ * Add uses of the rank lines to the records and free them, returns the number of non-empty
+ * lines; sets n_ranked to the number of lines of known records, if it is not NULL.
+ */
+static guint
+gr_history_rank_lines(
+	GStrv lines,
+	GHashTable *record_table,
+	guint *n_ranked )
+{
+	GStrv s, fields;
+	GrHistoryRecord *record;
+	guint64 uses;
+	gint64 last_use;
+	guint n_lines;
+
+	/* every line is "last use<TAB>uses<TAB>command", uses of the same command are summed */
+	n_lines = 0;
+	if( n_ranked != NULL )
+		*n_ranked = 0;
+	for( s = lines; *s != NULL; ++s )
+	{
+		if( **s == '\0' )
+			continue;
+		++n_lines;
+
+		fields = g_strsplit( *s, "\t", 3 );
+		if( g_strv_length( fields ) == 3 &&
+			g_ascii_string_to_signed( fields[0], 10, 0, G_MAXINT64, &last_use, NULL ) &&
+			g_ascii_string_to_unsigned( fields[1], 10, 0, G_MAXUINT, &uses, NULL ) &&
+			( record = (GrHistoryRecord*)g_hash_table_lookup( record_table, fields[2] ) ) != NULL )
+		{
+			record->uses += (guint)uses;
+			record->last_use = MAX( record->last_use, last_use );
+			if( n_ranked != NULL )
+				*n_ranked += 1;
+		}
+		g_strfreev( fields );
+	}
+	g_strfreev( lines );
+
+	return n_lines;
+}
+
+/* add uses from the rank file to the records, returns the number of lines in the file */
+static guint
+gr_history_load_rank(
+	const gchar *rank_path,
+	GHashTable *record_table,
+	GrHistoryTail *tail )
+{
+	gchar *text;
+	GStrv lines;
+	guint64 inode;
+	goffset size;
+	gsize len;
+
+	/* the lines appended after reading are read by the next reload */
+	tail->inode = 0;
+	tail->offset = 0;
+	if( !gr_history_stat_file( rank_path, &inode, &size ) || !g_file_get_contents( rank_path, &text, &len, NULL ) )
+		return 0;
+	tail->inode = inode;
+	tail->offset = (goffset)len;
+
+	lines = g_strsplit( text, PROGRAM_LINE_BREAKER, -1 );
+	g_free( text );
+
+	return gr_history_rank_lines( lines, record_table, NULL );
+}
+
+/* rewrite the rank file with a line per used record */
+static void
+gr_history_compact_rank(
+	const gchar *rank_path,
+	GPtrArray *records )
+{
+	GString *str;
+	GrHistoryRecord *record;
+	guint i;
+
+	str = g_string_new( NULL );
+	for( i = 0; i < records->len; ++i )
+	{
+		record = (GrHistoryRecord*)g_ptr_array_index( records, i );
+		if( record->uses > 0 )
+			g_string_append_printf( str, "%" G_GINT64_FORMAT "\t%u\t%s" PROGRAM_LINE_BREAKER,
+				record->last_use, record->uses, record->text );
+	}
+
+	g_file_set_contents_full( rank_path, str->str, str->len, G_FILE_SET_CONTENTS_CONSISTENT, 0600, NULL );
+	g_string_free( str, TRUE );
+}
+
+/* rewrite the history file with a line per record */
+static void
+gr_history_compact_file(
+	GrHistory *self,
+	GPtrArray *records )
+{
+	GString *str;
+	gchar *s_locale;
+	gsize s_locale_len;
+	guint i;
+
+	str = g_string_new( NULL );
+	for( i = 0; i < records->len; ++i )
+	{
+		g_string_append( str, ( (GrHistoryRecord*)g_ptr_array_index( records, i ) )->text );
+		g_string_append( str, PROGRAM_LINE_BREAKER );
+	}
+
+	s_locale = g_locale_from_utf8( str->str, str->len, NULL, &s_locale_len, NULL );
+	g_string_free( str, TRUE );
+	if( s_locale == NULL )
+		return;
+
+	if( g_file_set_contents_full( self->file_path, s_locale, s_locale_len, G_FILE_SET_CONTENTS_CONSISTENT, 0600, NULL ) )
+		self->needs_line_breaker = FALSE;
+	g_free( s_locale );
+}
+
+/* the index of the record, searched from the most recent end */
+static guint
+gr_history_find_record(
+	GrHistory *self,
+	GrHistoryRecord *record )
+{
+	guint i;
+
+	for( i = self->records->len; i > 0; --i )
+		if( g_ptr_array_index( self->records, i - 1 ) == record )
+			break;
+
+	return i - 1;
+}
+
+/* the record of the line used at now moved to the most recent end, it is created if needed */
+static GrHistoryRecord*
+gr_history_add_line(
+	GrHistory *self,
+	const gchar *text,
+	gint64 now )
+{
+	GrHistoryRecord *record;
+
+	record = (GrHistoryRecord*)g_hash_table_lookup( self->record_table, text );
+	if( record == NULL )
+	{
+		record = gr_history_record_new( text );
+		g_hash_table_insert( self->record_table, record->text, record );
+		if( self->suffixes != NULL )
+			gr_suffix_array_add_line( self->suffixes, text );
+	}
+	else
+	{
+		/* move the re-used command to the most recent end */
+		g_ptr_array_steal_index( self->records, gr_history_find_record( self, record ) );
+	}
+	g_ptr_array_add( self->records, record );
+	gr_history_index_line( self, text, 1, now );
+
+	return record;
+}
+
+/* drop the least recently used records beyond the size, returns TRUE if any is dropped */
+static gboolean
+gr_history_evict(
+	GrHistory *self )
+{
+	GrHistoryRecord *record;
+	guint i, n;
+
+	if( self->size == 0 || self->records->len <= self->size )
+		return FALSE;
+
+	/* the arguments of the dropped commands are completed no more */
+	n = self->records->len - self->size;
+	for( i = 0; i < n; ++i )
+	{
+		record = (GrHistoryRecord*)g_ptr_array_index( self->records, i );
+		gr_history_unindex_line( self, record->text, MAX( record->uses, 1 ) );
+		g_hash_table_remove( self->record_table, record->text );
+	}
+	g_ptr_array_remove_range( self->records, 0, n );
+
+	return TRUE;
+}
+
+static void
+gr_history_load_array(
+	GrHistory *self )
+{
+	GFile *file;
+	gchar *text_locale, *text_utf8;
+	gsize size;
+	GStrv arr;
+	GPtrArray *records;
+	GHashTable *record_table;
+	GrHistoryRecord *record;
+	GrHistoryTail tail;
+	guint i, n_lines, n_ranked, n_rank_lines;
+	gint64 start_time;
+
+	g_return_if_fail( GR_IS_HISTORY( self ) );
+
+	/* if the file cannot be loaded, do nothing */
+	start_time = g_get_monotonic_time();
+	if( self->file_path == NULL || !gr_history_stat_file( self->file_path, &tail.inode, &tail.offset ) )
+		return;
+	file = g_file_new_for_path( self->file_path );
+	if( !g_file_load_contents( file, NULL, &text_locale, &size, NULL, NULL ) )
+	{
+		g_object_unref( G_OBJECT( file ) );
+		return;
+	}
+	g_object_unref( G_OBJECT( file ) );
+	tail.offset = (goffset)size;
+	self->file_tail = tail;
+	self->needs_line_breaker = size > 0 && !g_str_has_suffix( text_locale, PROGRAM_LINE_BREAKER );
+
+	/* load array */
+	text_utf8 = g_locale_to_utf8( text_locale, size, NULL, NULL, NULL );
+	g_free( text_locale );
+	if( text_utf8 == NULL )
+		return;
+	arr = g_strsplit( text_utf8, PROGRAM_LINE_BREAKER, -1 );
+	g_free( text_utf8 );
+
+	/* a record per distinct non-empty line, the last occurrence is the most recent use */
+	records = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_history_record_free );
+	record_table = g_hash_table_new( g_str_hash, g_str_equal );
+	n_lines = 0;
+	for( i = g_strv_length( arr ); i > 0; --i )
+	{
+		if( *arr[i-1] == '\0' )
+			continue;
+		++n_lines;
+
+		if( g_hash_table_contains( record_table, arr[i-1] ) ||
+			( self->size > 0 && records->len >= self->size ) )
+			continue;
+
+		record = gr_history_record_new( arr[i-1] );
+		g_ptr_array_add( records, record );
+		g_hash_table_insert( record_table, record->text, record );
+	}
+	g_strfreev( arr );
+
+	/* records were collected from the most recent */
+	for( i = 0; i < records->len / 2; ++i )
+	{
+		record = (GrHistoryRecord*)g_ptr_array_index( records, i );
+		g_ptr_array_index( records, i ) = g_ptr_array_index( records, records->len - 1 - i );
+		g_ptr_array_index( records, records->len - 1 - i ) = record;
+	}
+
+	/* re-used and evicted commands stay in the file until it has grown enough */
+	if( !self->read_only && n_lines > 2 * records->len + HISTORY_COMPACT_SLACK )
+	{
+		gr_history_compact_file( self, records );
+		gr_history_tail_reset( &self->file_tail, self->file_path );
+	}
+
+	/* ranking data is appended on every use, compact it when it has grown enough */
+	n_rank_lines = gr_history_load_rank( self->rank_path, record_table, &self->rank_tail );
+	for( i = 0, n_ranked = 0; i < records->len; ++i )
+		if( ( (GrHistoryRecord*)g_ptr_array_index( records, i ) )->uses > 0 )
+			++n_ranked;
+	if( !self->read_only && n_rank_lines > 2 * n_ranked + HISTORY_COMPACT_SLACK )
+	{
+		gr_history_compact_rank( self->rank_path, records );
+		gr_history_tail_reset( &self->rank_tail, self->rank_path );
+	}
+
+	g_hash_table_unref( self->record_table );
+	g_ptr_array_unref( self->records );
+	self->records = records;
+	self->record_table = record_table;
+	g_clear_pointer( &self->suffixes, gr_suffix_array_free );
+
+	/* index arguments of the loaded commands */
+	g_hash_table_remove_all( self->commands );
+	self->n_uses = 0;
+	for( i = 0; i < records->len; ++i )
+	{
+		record = (GrHistoryRecord*)g_ptr_array_index( records, i );
+		gr_history_index_line( self, record->text, MAX( record->uses, 1 ), record->last_use );
+	}
+	self->load_time = g_get_monotonic_time() - start_time;
+}
+
+static void
+on_file_monitor_changed(
+	GFileMonitor *monitor,
+	GFile *file,
+	GFile *other_file,
+	GFileMonitorEvent event_type,
+	gpointer user_data )
+{
+	GrHistory *history = GR_HISTORY( user_data );
+
+	/* the files are only stated, if nothing is appended */
+	if( event_type != G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED )
+		gr_history_reload( history );
+}
+
+static GFileMonitor*
+gr_history_monitor_file(
+	GrHistory *self,
+	const gchar *path )
+{
+	GFile *file;
+	GFileMonitor *monitor;
+
+	file = g_file_new_for_path( path );
+	monitor = g_file_monitor_file( file, G_FILE_MONITOR_NONE, NULL, NULL );
+	g_object_unref( G_OBJECT( file ) );
+	if( monitor != NULL )
+		g_signal_connect( G_OBJECT( monitor ), "changed", G_CALLBACK( on_file_monitor_changed ), self );
+
+	return monitor;
+}
+
+static void
+gr_history_clear_monitors(
+	GrHistory *self )
+{
+	if( self->file_monitor != NULL )
+		g_file_monitor_cancel( self->file_monitor );
+	if( self->rank_monitor != NULL )
+		g_file_monitor_cancel( self->rank_monitor );
+	g_clear_object( &self->file_monitor );
+	g_clear_object( &self->rank_monitor );
+}
+
+static const gchar*
+gr_history_get_name(
+	GrCompletionProvider *provider )
+{
+	return "history";
+}
+
+/*
+ * Returns the array of GrCompletion, the best first, but not more than limit if it is not 0.
+ * Their scores are the frecencies of the commands, or the uses of the arguments if the command
+ * is typed, so the completions of several histories can be merged by them.
+ */
+GPtrArray*
+gr_history_query_ranked(
+	GrHistory *self,
+	const gchar *str,
+	guint limit )
+{
+	GrHistorySnapshot *snapshot;
+	GPtrArray *completions;
+	GArray *list;
+	GrHistoryArgs *a;
+	GrHistoryRecord *record;
+	const gchar *args;
+	gchar *command, *text, *key;
+	gboolean ignore_case;
+	gsize str_len, command_len, args_len;
+	gint64 now;
+	guint *top;
+	guint i, k, len;
+
+	g_return_val_if_fail( GR_IS_HISTORY( self ), NULL );
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	if( str == NULL || *str == '\0' )
+		return completions;
+
+	str_len = strlen( str );
+	command_len = gr_history_split_line( str, &args );
+	now = g_get_real_time() / G_USEC_PER_SEC;
+
+	snapshot = gr_history_acquire_snapshot( self );
+
+	/* the command is typed, complete its arguments used before, the highest frecency first */
+	if( args != NULL )
+	{
+		command = g_strndup( str, command_len );
+		list = (GArray*)g_hash_table_lookup( snapshot->commands, command );
+		g_free( command );
+
+		args_len = strlen( args );
+		for( i = 0; list != NULL && i < list->len; ++i )
+		{
+			if( limit > 0 && completions->len >= limit )
+				break;
+
+			a = &g_array_index( list, GrHistoryArgs, i );
+			if( strncmp( a->args, args, args_len ) != 0 )
+				continue;
+
+			text = g_strconcat( str, a->args + args_len, NULL );
+			g_ptr_array_add( completions, gr_completion_new( text, gr_history_frecency( a->uses, a->last_use, now ) ) );
+			g_free( text );
+		}
+
+		gr_history_snapshot_unref( snapshot );
+		return completions;
+	}
+
+	/* the folded str is matched against the keys */
+	key = NULL;
+	ignore_case = g_atomic_int_get( &self->ignore_case );
+	if( ignore_case )
+	{
+		str = key = gr_completion_fold( str );
+		str_len = strlen( str );
+	}
+
+	/* the k records of the highest frecency are taken from the range of the prefix index, only
+	 * their frecencies are computed */
+	k = snapshot->n_records;
+	if( limit > 0 )
+		k = MIN( k, limit );
+	top = g_new( guint, MAX( k, 1 ) );
+	len = gr_history_prefix_index_top( gr_history_snapshot_get_prefix_index( snapshot, ignore_case ), str, str_len, k, top );
+
+	for( i = 0; i < len; ++i )
+	{
+		record = &snapshot->records[top[i]];
+		g_ptr_array_add( completions, gr_completion_new( record->text, gr_history_record_get_frecency( record, now ) ) );
+	}
+	gr_history_snapshot_unref( snapshot );
+	g_free( top );
+	g_free( key );
+
+	return completions;
+}
+
+static GPtrArray*
+gr_history_query(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GPtrArray *completions;
+	guint i;
+
+	completions = gr_history_query_ranked( GR_HISTORY( provider ), str, limit );
+	for( i = 0; i < completions->len; ++i )
+		( (GrCompletion*)g_ptr_array_index( completions, i ) )->score = GR_HISTORY_SCORE;
+
+	return completions;
+}
+
+static guint64
+gr_history_get_stamp(
+	GrCompletionProvider *provider )
+{
+	GrHistory *self = GR_HISTORY( provider );
+	GrHistorySnapshot *snapshot;
+	guint64 stamp;
+	gint ignore_case;
+
+	snapshot = gr_history_acquire_snapshot( self );
+	stamp = snapshot->stamp;
+	gr_history_snapshot_unref( snapshot );
+
+	/* the order of ranks does not change with time, all of them decay at the same rate */
+	ignore_case = g_atomic_int_get( &self->ignore_case );
+
+	return gr_completion_hash( stamp, &ignore_case, sizeof( ignore_case ) );
+}
+
+/*
+ * Returns the command of the highest frecency starting with the len bytes of str, or with
+ * the key str if folded, and sets frecency to it, NULL if none. The text is shared with the
+ * records, which are freed only by the main thread. The records are binary searched, only
+ * the frecency of the found one is computed.
+ */
+const gchar*
+gr_history_lookup_ranked(
+	GrHistory *self,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *frecency )
+{
+	GrHistorySnapshot *snapshot;
+	GrHistoryRecord *record;
+	const gchar *text;
+	guint i;
+
+	g_return_val_if_fail( GR_IS_HISTORY( self ), NULL );
+
+	snapshot = gr_history_acquire_snapshot( self );
+	i = gr_history_prefix_index_lookup( gr_history_snapshot_get_prefix_index( snapshot, folded ), str, len );
+
+	text = NULL;
+	if( i != G_MAXUINT )
+	{
+		record = &snapshot->records[i];
+		text = record->text;
+		if( frecency != NULL )
+			*frecency = gr_history_record_get_frecency( record, g_get_real_time() / G_USEC_PER_SEC );
+	}
+	gr_history_snapshot_unref( snapshot );
+
+	return text;
+}
+
+/* the score is the one of the command in the results of the query, see gr_history_query() */
+static const gchar*
+gr_history_lookup(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	const gchar *text;
+
+	text = gr_history_lookup_ranked( GR_HISTORY( provider ), str, len, folded, NULL );
+	if( text != NULL && score != NULL )
+		*score = GR_HISTORY_SCORE;
+
+	return text;
+}
+
+static void
+gr_history_completion_provider_init(
+	GrCompletionProviderInterface *iface )
+{
+	iface->get_name = gr_history_get_name;
+	iface->query = gr_history_query;
+	iface->get_stamp = gr_history_get_stamp;
+	iface->lookup = gr_history_lookup;
+}
+
+static void
+gr_history_init(
+	GrHistory *self )
+{
+	self->file_path = NULL;
+	self->rank_path = NULL;
+	self->size = 0;
+	self->read_only = FALSE;
+	self->ignore_case = FALSE;
+	self->needs_line_breaker = FALSE;
+	self->file_tail.inode = 0;
+	self->file_tail.offset = 0;
+	self->rank_tail.inode = 0;
+	self->rank_tail.offset = 0;
+	self->file_monitor = NULL;
+	self->rank_monitor = NULL;
+
+	/* setup empty records */
+	g_mutex_init( &self->mutex );
+	self->records = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_history_record_free );
+	self->record_table = g_hash_table_new( g_str_hash, g_str_equal );
+	self->suffixes = NULL;
+
+	self->commands = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_ref_string_release, (GDestroyNotify)g_ptr_array_unref );
+	self->n_uses = 0;
+	self->load_time = 0;
+	self->snapshot = gr_history_snapshot_new( self );
+}
+
+static void
+gr_history_finalize(
+	GObject *object )
+{
+	GrHistory *self = GR_HISTORY( object );
+
+	gr_history_clear_monitors( self );
+	g_free( self->file_path );
+	g_free( self->rank_path );
+	gr_suffix_array_free( self->suffixes );
+	g_hash_table_unref( self->record_table );
+	g_ptr_array_unref( self->records );
+	g_hash_table_unref( self->commands );
+	gr_history_snapshot_unref( self->snapshot );
+	g_mutex_clear( &self->mutex );
+
+	G_OBJECT_CLASS( gr_history_parent_class )->finalize( object );
+}
+
+static void
+gr_history_get_property(
+	GObject *object,
+	guint prop_id,
+	GValue *value,
+	GParamSpec *pspec )
+{
+	GrHistory *self = GR_HISTORY( object );
+
+	switch( (GrHistoryPropertyID)prop_id )
+	{
+		case PROP_FILE_PATH:
+			g_value_set_string( value, self->file_path );
+			break;
+		case PROP_SIZE:
+			g_value_set_uint( value, self->size );
+			break;
+		case PROP_READ_ONLY:
+			g_value_set_boolean( value, self->read_only );
+			break;
+		case PROP_IGNORE_CASE:
+			g_value_set_boolean( value, gr_history_get_ignore_case( self ) );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_history_set_property(
+	GObject *object,
+	guint prop_id,
+	const GValue *value,
+	GParamSpec *pspec )
+{
+	GrHistory *self = GR_HISTORY( object );
+
+	switch( (GrHistoryPropertyID)prop_id )
+	{
+		case PROP_FILE_PATH:
+			gr_history_set_file_path( self, g_value_get_string( value ) );
+			break;
+		case PROP_SIZE:
+			gr_history_set_size( self, g_value_get_uint( value ) );
+			break;
+		case PROP_READ_ONLY:
+			self->read_only = g_value_get_boolean( value );
+			break;
+		case PROP_IGNORE_CASE:
+			gr_history_set_ignore_case( self, g_value_get_boolean( value ) );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_history_class_init(
+	GrHistoryClass *klass )
+{
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->finalize = gr_history_finalize;
+	object_class->get_property = gr_history_get_property;
+	object_class->set_property = gr_history_set_property;
+
+	object_props[PROP_FILE_PATH] = g_param_spec_string(
+		"file-path",
+		"File path",
+		"Path to the file containing the list of commands",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_SIZE] = g_param_spec_uint(
+		"size",
+		"Size",
+		"Maximum number of commands, 0 is unlimited",
+		0,
+		G_MAXUINT,
+		0,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_READ_ONLY] = g_param_spec_boolean(
+		"read-only",
+		"Read-only",
+		"Do not write the files, the commands are not pushed",
+		FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_IGNORE_CASE] = g_param_spec_boolean(
+		"ignore-case",
+		"Ignoring case",
+		"Match commands regardless of case",
+		FALSE,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	g_object_class_install_properties( object_class, N_PROPS, object_props );
+}
+
+GrHistory*
+gr_history_new(
+	const gchar *file_path,
+	guint size,
+	gboolean read_only )
+{
+	/* the size goes first to be applied on loading */
+	return GR_HISTORY( g_object_new( GR_TYPE_HISTORY, "read-only", read_only, "size", size, "file-path", file_path, NULL ) );
+}
+
+gboolean
+gr_history_get_read_only(
+	GrHistory *self )
+{
+	g_return_val_if_fail( GR_IS_HISTORY( self ), FALSE );
+
+	return self->read_only;
+}
+
+gchar*
+gr_history_get_file_path(
+	GrHistory *self )
+{
+	g_return_val_if_fail( GR_IS_HISTORY( self ), NULL );
+
+	return g_strdup( self->file_path );
+}
+
+void
+gr_history_set_file_path(
+	GrHistory *self,
+	const gchar *path )
+{
+	g_return_if_fail( GR_IS_HISTORY( self ) );
+
+	g_object_freeze_notify( G_OBJECT( self ) );
+
+	g_free( self->file_path );
+	g_free( self->rank_path );
+	self->file_path = g_strdup( path );
+	self->rank_path = path != NULL ? g_strconcat( path, PROGRAM_HISTORY_RANK_SUFFIX, NULL ) : NULL;
+	self->file_tail.inode = 0;
+	self->file_tail.offset = 0;
+	self->rank_tail.inode = 0;
+	self->rank_tail.offset = 0;
+	gr_history_load_array( self );
+	gr_history_publish( self );
+
+	/* other instances append to the files */
+	gr_history_clear_monitors( self );
+	if( path != NULL )
+	{
+		self->file_monitor = gr_history_monitor_file( self, self->file_path );
+		self->rank_monitor = gr_history_monitor_file( self, self->rank_path );
+	}
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_FILE_PATH] );
+
+	g_object_thaw_notify( G_OBJECT( self ) );
+}
+
+/*
+ * Applies the lines appended by other instances to the records, not publishing them. Returns
+ * TRUE, if a record is changed: blank lines and ranks of unknown commands change nothing.
+ */
+static gboolean
+gr_history_read_appended(
+	GrHistory *self )
+{
+	gchar *data, *rank_data, *text_utf8;
+	GStrv lines, s;
+	gsize len, rank_len;
+	gint64 now;
+	gboolean rewritten, changed;
+	guint n_ranked;
+
+	if( self->file_path == NULL )
+		return FALSE;
+
+	data = gr_history_read_tail( self->file_path, &self->file_tail, &len, &rewritten );
+	rank_data = NULL;
+	if( !rewritten )
+		rank_data = gr_history_read_tail( self->rank_path, &self->rank_tail, &rank_len, &rewritten );
+	if( rewritten )
+	{
+		g_free( data );
+		g_free( rank_data );
+		gr_history_load_array( self );
+		return TRUE;
+	}
+	if( data == NULL && rank_data == NULL )
+		return FALSE;
+
+	text_utf8 = data != NULL ? g_locale_to_utf8( data, len, NULL, NULL, NULL ) : NULL;
+	g_free( data );
+
+	/* the lines are applied as if they are pushed here */
+	changed = FALSE;
+	if( text_utf8 != NULL )
+	{
+		now = g_get_real_time() / G_USEC_PER_SEC;
+		lines = g_strsplit( text_utf8, PROGRAM_LINE_BREAKER, -1 );
+		for( s = lines; *s != NULL; ++s )
+		{
+			if( **s == '\0' )
+				continue;
+			gr_history_add_line( self, *s, now );
+			changed = TRUE;
+		}
+		g_strfreev( lines );
+	}
+	if( rank_data != NULL )
+	{
+		gr_history_rank_lines( g_strsplit( rank_data, PROGRAM_LINE_BREAKER, -1 ), self->record_table, &n_ranked );
+		changed = changed || n_ranked > 0;
+	}
+	changed = gr_history_evict( self ) || changed;
+
+	g_free( text_utf8 );
+	g_free( rank_data );
+
+	return changed;
+}
+
+/*
+ * Reads the lines appended to the files by other instances since the last reading, or the
+ * whole files if they are rewritten or compacted. Returns TRUE, if a record is changed; the
+ * snapshot is published only then.
+ */
+gboolean
+gr_history_reload(
+	GrHistory *self )
+{
+	g_return_val_if_fail( GR_IS_HISTORY( self ), FALSE );
+
+	if( !gr_history_read_appended( self ) )
+		return FALSE;
+
+	gr_history_publish( self );
+
+	return TRUE;
+}
+
+void
+gr_history_push(
+	GrHistory *self,
+	const gchar *text )
+{
+	GrHistoryRecord *record;
+	gint64 now;
+	gchar *line, *line_locale;
+	gsize line_locale_len;
+
+	g_return_if_fail( GR_IS_HISTORY( self ) );
+	g_return_if_fail( !self->read_only );
+
+	/* nothing to push */
+	if( text == NULL || *text == '\0' )
+		return;
+
+	now = g_get_real_time() / G_USEC_PER_SEC;
+
+	/* the lines of other instances are read first, so the tails stay before the own ones */
+	gr_history_read_appended( self );
+
+	record = gr_history_add_line( self, text, now );
+	record->uses += 1;
+	record->last_use = now;
+	gr_history_evict( self );
+	gr_history_publish( self );
+
+	/* if no file path, nothing will be stored */
+	if( self->file_path == NULL )
+		return;
+
+	/* the command is appended to the history, the file is compacted on loading */
+	line = g_strconcat( self->needs_line_breaker ? PROGRAM_LINE_BREAKER : "", text, PROGRAM_LINE_BREAKER, NULL );
+	line_locale = g_locale_from_utf8( line, -1, NULL, &line_locale_len, NULL );
+	if( line_locale != NULL && gr_history_append_to_file( self->file_path, line_locale, line_locale_len ) )
+	{
+		self->needs_line_breaker = FALSE;
+		gr_history_tail_skip( &self->file_tail, self->file_path, line_locale_len );
+	}
+	g_free( line_locale );
+	g_free( line );
+
+	/* every use is appended to the rank file, it is compacted on loading */
+	line = g_strdup_printf( "%" G_GINT64_FORMAT "\t1\t%s" PROGRAM_LINE_BREAKER, now, text );
+	if( gr_history_append_to_file( self->rank_path, line, strlen( line ) ) )
+		gr_history_tail_skip( &self->rank_tail, self->rank_path, strlen( line ) );
+	g_free( line );
+}
+
+guint
+gr_history_get_size(
+	GrHistory *self )
+{
+	g_return_val_if_fail( GR_IS_HISTORY( self ), 0 );
+
+	return self->size;
+}
+
+void
+gr_history_set_size(
+	GrHistory *self,
+	guint size )
+{
+	g_return_if_fail( GR_IS_HISTORY( self ) );
+
+	self->size = size;
+	if( gr_history_evict( self ) )
+		gr_history_publish( self );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_SIZE] );
+}
+
+gboolean
+gr_history_get_ignore_case(
+	GrHistory *self )
+{
+	g_return_val_if_fail( GR_IS_HISTORY( self ), FALSE );
+
+	return g_atomic_int_get( &self->ignore_case );
+}
+
+void
+gr_history_set_ignore_case(
+	GrHistory *self,
+	gboolean ignore_case )
+{
+	g_return_if_fail( GR_IS_HISTORY( self ) );
+
+	/* read by the query threads */
+	g_atomic_int_set( &self->ignore_case, ignore_case ? TRUE : FALSE );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_IGNORE_CASE] );
+}
+
+/*
+ * Returns the commands containing str, the highest frecency first, but not more than limit
+ * if it is not 0. The suffix array is built on the first call and grows with pushed commands.
+ */
+GStrv
+gr_history_search(
+	GrHistory *self,
+	const gchar *str,
+	guint limit )
+{
+	GStrvBuilder *builder;
+	GStrv arr;
+	const gchar **texts;
+	GArray *lines;
+	GHashTable *found;
+	GrHistoryRecord *record;
+	GrHistoryRank *heap, rank;
+	gint64 now;
+	guint i, k, len;
+
+	g_return_val_if_fail( GR_IS_HISTORY( self ), NULL );
+
+	builder = g_strv_builder_new();
+	if( str == NULL || *str == '\0' )
+	{
+		arr = g_strv_builder_end( builder );
+		g_strv_builder_unref( builder );
+		return arr;
+	}
+
+	/* lines of evicted commands stay in the array, it is rebuilt when they prevail */
+	if( self->suffixes != NULL &&
+		gr_suffix_array_get_n_lines( self->suffixes ) > 2 * self->records->len + HISTORY_COMPACT_SLACK )
+		g_clear_pointer( &self->suffixes, gr_suffix_array_free );
+
+	if( self->suffixes == NULL )
+	{
+		texts = g_new( const gchar*, MAX( self->records->len, 1 ) );
+		for( i = 0; i < self->records->len; ++i )
+			texts[i] = ( (GrHistoryRecord*)g_ptr_array_index( self->records, i ) )->text;
+
+		self->suffixes = gr_suffix_array_new();
+		gr_suffix_array_add_lines( self->suffixes, texts, self->records->len );
+		g_free( texts );
+	}
+
+	/* select the k records of the highest frecency among the found lines */
+	lines = gr_suffix_array_lookup( self->suffixes, str );
+	k = lines->len;
+	if( limit > 0 )
+		k = MIN( k, limit );
+	heap = g_new( GrHistoryRank, MAX( k, 1 ) );
+	len = 0;
+	found = g_hash_table_new( NULL, NULL );
+	now = g_get_real_time() / G_USEC_PER_SEC;
+	for( i = lines->len; i > 0; --i )
+	{
+		rank.index = g_array_index( lines, guint, i - 1 );
+		record = (GrHistoryRecord*)g_hash_table_lookup( self->record_table, gr_suffix_array_get_line( self->suffixes, rank.index ) );
+
+		/* a re-added command has several lines, the latest one counts */
+		if( record == NULL || !g_hash_table_add( found, record ) )
+			continue;
+
+		rank.frecency = gr_history_record_get_frecency( record, now );
+		rank.record = record;
+		gr_history_heap_offer( heap, &len, k, &rank );
+	}
+	gr_history_heap_sort( heap, len );
+
+	for( i = 0; i < len; ++i )
+		g_strv_builder_add( builder, heap[i].record->text );
+
+	g_hash_table_unref( found );
+	g_array_unref( lines );
+	g_free( heap );
+
+	arr = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	return arr;
+}
+
+/* Returns a{sv}: the number of records, the bytes of the records and of their indexes, the time to load them */
+GVariant*
+gr_history_get_stats(
+	GrHistory *self )
+{
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	gpointer key, value;
+	GPtrArray *list;
+	GrHistoryRecord *record;
+	GrHistorySnapshot *snapshot;
+	guint64 bytes;
+	guint i, n_records;
+
+	g_return_val_if_fail( GR_IS_HISTORY( self ), NULL );
+
+	n_records = self->records->len;
+	bytes = sizeof( GrHistory ) + (guint64)n_records * ( sizeof( gpointer ) + sizeof( GrHistoryRecord ) + GR_STATS_HASH_ENTRY_SIZE );
+	for( i = 0; i < n_records; ++i )
+	{
+		record = (GrHistoryRecord*)g_ptr_array_index( self->records, i );
+		bytes += strlen( record->text ) + strlen( record->key ) + 2;
+	}
+
+	g_hash_table_iter_init( &iter, self->commands );
+	while( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		list = (GPtrArray*)value;
+		bytes += strlen( (const gchar*)key ) + 1 + GR_STATS_HASH_ENTRY_SIZE + sizeof( GPtrArray );
+		for( i = 0; i < list->len; ++i )
+			bytes += sizeof( gpointer ) + sizeof( GrHistoryArgs ) + strlen( ( (GrHistoryArgs*)g_ptr_array_index( list, i ) )->args ) + 1;
+
+		/* the published copy shares the strings */
+		bytes += GR_STATS_HASH_ENTRY_SIZE + sizeof( GArray ) + (guint64)list->len * sizeof( GrHistoryArgs );
+	}
+	bytes += sizeof( GrHistorySnapshot ) + (guint64)n_records * sizeof( GrHistoryRecord );
+
+	/* the prefix indexes built by the lookups of the snapshot */
+	snapshot = gr_history_acquire_snapshot( self );
+	for( i = 0; i < G_N_ELEMENTS( snapshot->prefix_indexes ); ++i )
+		if( g_atomic_pointer_get( &snapshot->prefix_indexes[i] ) != NULL )
+			bytes += sizeof( GrHistoryPrefixIndex ) + sizeof( GArray ) +
+				(guint64)snapshot->n_records * ( sizeof( gchar* ) + sizeof( gdouble ) + 3 * sizeof( guint ) );
+	gr_history_snapshot_unref( snapshot );
+
+	if( self->suffixes != NULL )
+		bytes += gr_suffix_array_get_size( self->suffixes );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( n_records ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+	g_variant_builder_add( &builder, "{sv}", "load-time", g_variant_new_int64( self->load_time ) );
+
+	return g_variant_builder_end( &builder );
+}
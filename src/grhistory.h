@@ -0,0 +1,33 @@
+#ifndef GRHISTORY_H
+#define GRHISTORY_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* history completions go before any other */
+#define GR_HISTORY_SCORE 2.0
+
+#define GR_TYPE_HISTORY ( gr_history_get_type() )
+G_DECLARE_FINAL_TYPE( GrHistory, gr_history, GR, HISTORY, GObject )
+
+GrHistory* gr_history_new( const gchar *file_path, guint size, gboolean read_only );
+gboolean gr_history_get_read_only( GrHistory *self );
+gchar* gr_history_get_file_path( GrHistory *self );
+void gr_history_set_file_path( GrHistory *self, const gchar *path );
+gboolean gr_history_reload( GrHistory *self );
+void gr_history_push( GrHistory *self, const gchar *text );
+guint gr_history_get_size( GrHistory *self );
+void gr_history_set_size( GrHistory *self, guint size );
+gboolean gr_history_get_ignore_case( GrHistory *self );
+void gr_history_set_ignore_case( GrHistory *self, gboolean ignore_case );
+GStrv gr_history_search( GrHistory *self, const gchar *str, guint limit );
+GPtrArray* gr_history_query_ranked( GrHistory *self, const gchar *str, guint limit );
+const gchar* gr_history_lookup_ranked( GrHistory *self, const gchar *str, gsize len, gboolean folded, gdouble *frecency );
+GVariant* gr_history_get_stats( GrHistory *self );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,370 @@
+#include "grhistorygroup.h"
+
+#include "grcompletionprovider.h"
+#include "grhistory.h"
+
+#include <glib-object.h>
+#include <glib.h>
+
+struct _GrHistoryGroupSource
+{
+	GrHistory *history;
+	gdouble weight; /* multiplies the frecencies of the history */
+};
+typedef struct _GrHistoryGroupSource GrHistoryGroupSource;
+
+/*
+ * The histories of several files completed as one. Every history ranks its own commands,
+ * the ranked lists are merged by their weighted scores on every query.
+ */
+struct _GrHistoryGroup
+{
+	GObject parent_instance;
+
+	/* added before the first query, then only read by the worker threads */
+	GArray *sources;
+};
+typedef struct _GrHistoryGroup GrHistoryGroup;
+
+static void gr_history_group_completion_provider_init( GrCompletionProviderInterface *iface );
+
+G_DEFINE_TYPE_WITH_CODE( GrHistoryGroup, gr_history_group, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE( GR_TYPE_COMPLETION_PROVIDER, gr_history_group_completion_provider_init ) )
+
+static const gchar*
+gr_history_group_get_name(
+	GrCompletionProvider *provider )
+{
+	return "history";
+}
+
+/*
+ * Every list of a source is sorted by score, so the best of their heads goes next. A command
+ * of several sources goes once with its best score, so not more than limit completions of
+ * every source are needed.
+ */
+static GPtrArray*
+gr_history_group_query(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GrHistoryGroup *self = GR_HISTORY_GROUP( provider );
+	GrHistoryGroupSource *source;
+	GPtrArray *completions, **lists;
+	GrCompletion *completion;
+	GHashTable *found;
+	gdouble score, best_score;
+	guint *heads;
+	guint i, n_sources, best;
+
+	n_sources = self->sources->len;
+	lists = g_new( GPtrArray*, MAX( n_sources, 1 ) );
+	heads = g_new0( guint, MAX( n_sources, 1 ) );
+	for( i = 0; i < n_sources; ++i )
+	{
+		source = &g_array_index( self->sources, GrHistoryGroupSource, i );
+		lists[i] = gr_history_query_ranked( source->history, str, limit );
+	}
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	found = g_hash_table_new( g_str_hash, g_str_equal );
+	best_score = 0.0;
+	while( limit == 0 || completions->len < limit )
+	{
+		/* the sources are few, a scan of the heads is cheaper than a heap */
+		best = n_sources;
+		for( i = 0; i < n_sources; ++i )
+		{
+			if( heads[i] >= lists[i]->len )
+				continue;
+
+			completion = (GrCompletion*)g_ptr_array_index( lists[i], heads[i] );
+			score = g_array_index( self->sources, GrHistoryGroupSource, i ).weight * completion->score;
+			if( best == n_sources || score > best_score )
+			{
+				best = i;
+				best_score = score;
+			}
+		}
+		if( best == n_sources )
+			break;
+
+		completion = (GrCompletion*)g_ptr_array_index( lists[best], heads[best] );
+		++heads[best];
+		if( g_hash_table_add( found, completion->text ) )
+			g_ptr_array_add( completions, gr_completion_new( completion->text, GR_HISTORY_SCORE ) );
+	}
+
+	g_hash_table_unref( found );
+	for( i = 0; i < n_sources; ++i )
+		g_ptr_array_unref( lists[i] );
+	g_free( lists );
+	g_free( heads );
+
+	return completions;
+}
+
+static guint64
+gr_history_group_get_stamp(
+	GrCompletionProvider *provider )
+{
+	GrHistoryGroup *self = GR_HISTORY_GROUP( provider );
+	GrHistoryGroupSource *source;
+	guint64 stamp, hash;
+	guint i;
+
+	hash = 0;
+	for( i = 0; i < self->sources->len; ++i )
+	{
+		source = &g_array_index( self->sources, GrHistoryGroupSource, i );
+		stamp = gr_completion_provider_get_stamp( GR_COMPLETION_PROVIDER( source->history ) );
+		hash = gr_completion_hash( hash, &stamp, sizeof( stamp ) );
+		hash = gr_completion_hash( hash, &source->weight, sizeof( source->weight ) );
+	}
+
+	return hash;
+}
+
+static const gchar*
+gr_history_group_lookup(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	GrHistoryGroup *self = GR_HISTORY_GROUP( provider );
+	GrHistoryGroupSource *source;
+	const gchar *text, *best;
+	gdouble frecency, best_score;
+	guint i;
+
+	best = NULL;
+	best_score = 0.0;
+	for( i = 0; i < self->sources->len; ++i )
+	{
+		source = &g_array_index( self->sources, GrHistoryGroupSource, i );
+		text = gr_history_lookup_ranked( source->history, str, len, folded, &frecency );
+		if( text != NULL && ( best == NULL || source->weight * frecency > best_score ) )
+		{
+			best = text;
+			best_score = source->weight * frecency;
+		}
+	}
+
+	/* the commands of all sources score the same in the results of the query */
+	if( best != NULL && score != NULL )
+		*score = GR_HISTORY_SCORE;
+
+	return best;
+}
+
+static void
+gr_history_group_completion_provider_init(
+	GrCompletionProviderInterface *iface )
+{
+	iface->get_name = gr_history_group_get_name;
+	iface->query = gr_history_group_query;
+	iface->get_stamp = gr_history_group_get_stamp;
+	iface->lookup = gr_history_group_lookup;
+}
+
+static void
+gr_history_group_init(
+	GrHistoryGroup *self )
+{
+	self->sources = g_array_new( FALSE, FALSE, sizeof( GrHistoryGroupSource ) );
+}
+
+static void
+gr_history_group_finalize(
+	GObject *object )
+{
+	GrHistoryGroup *self = GR_HISTORY_GROUP( object );
+	guint i;
+
+	for( i = 0; i < self->sources->len; ++i )
+		g_object_unref( G_OBJECT( g_array_index( self->sources, GrHistoryGroupSource, i ).history ) );
+	g_array_unref( self->sources );
+
+	G_OBJECT_CLASS( gr_history_group_parent_class )->finalize( object );
+}
+
+static void
+gr_history_group_class_init(
+	GrHistoryGroupClass *klass )
+{
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->finalize = gr_history_group_finalize;
+}
+
+GrHistoryGroup*
+gr_history_group_new(
+	void )
+{
+	return GR_HISTORY_GROUP( g_object_new( GR_TYPE_HISTORY_GROUP, NULL ) );
+}
+
+/* the sources are added before the group is queried, the first one breaks ties of scores */
+void
+gr_history_group_add(
+	GrHistoryGroup *self,
+	GrHistory *history,
+	gdouble weight )
+{
+	GrHistoryGroupSource source;
+
+	g_return_if_fail( GR_IS_HISTORY_GROUP( self ) );
+	g_return_if_fail( GR_IS_HISTORY( history ) );
+	g_return_if_fail( weight > 0.0 );
+
+	source.history = GR_HISTORY( g_object_ref( G_OBJECT( history ) ) );
+	source.weight = weight;
+	g_array_append_val( self->sources, source );
+}
+
+void
+gr_history_group_set_ignore_case(
+	GrHistoryGroup *self,
+	gboolean ignore_case )
+{
+	guint i;
+
+	g_return_if_fail( GR_IS_HISTORY_GROUP( self ) );
+
+	for( i = 0; i < self->sources->len; ++i )
+		gr_history_set_ignore_case( g_array_index( self->sources, GrHistoryGroupSource, i ).history, ignore_case );
+}
+
+/* returns TRUE if any source has changed, see gr_history_reload() */
+gboolean
+gr_history_group_reload(
+	GrHistoryGroup *self )
+{
+	gboolean changed;
+	guint i;
+
+	g_return_val_if_fail( GR_IS_HISTORY_GROUP( self ), FALSE );
+
+	changed = FALSE;
+	for( i = 0; i < self->sources->len; ++i )
+		changed |= gr_history_reload( g_array_index( self->sources, GrHistoryGroupSource, i ).history );
+
+	return changed;
+}
+
+/* the command is appended to every writable source */
+void
+gr_history_group_push(
+	GrHistoryGroup *self,
+	const gchar *text )
+{
+	GrHistory *history;
+	guint i;
+
+	g_return_if_fail( GR_IS_HISTORY_GROUP( self ) );
+
+	for( i = 0; i < self->sources->len; ++i )
+	{
+		history = g_array_index( self->sources, GrHistoryGroupSource, i ).history;
+		if( !gr_history_get_read_only( history ) )
+			gr_history_push( history, text );
+	}
+}
+
+/* the commands containing str found in every source, the sources in their order */
+GStrv
+gr_history_group_search(
+	GrHistoryGroup *self,
+	const gchar *str,
+	guint limit )
+{
+	GStrvBuilder *builder;
+	GHashTable *found;
+	GStrv arr, texts;
+	guint i, j, n;
+
+	g_return_val_if_fail( GR_IS_HISTORY_GROUP( self ), NULL );
+
+	builder = g_strv_builder_new();
+	found = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	n = 0;
+	for( i = 0; i < self->sources->len && ( limit == 0 || n < limit ); ++i )
+	{
+		texts = gr_history_search( g_array_index( self->sources, GrHistoryGroupSource, i ).history, str, limit );
+		for( j = 0; texts[j] != NULL && ( limit == 0 || n < limit ); ++j )
+		{
+			if( !g_hash_table_add( found, g_strdup( texts[j] ) ) )
+				continue;
+
+			g_strv_builder_add( builder, texts[j] );
+			++n;
+		}
+		g_strfreev( texts );
+	}
+	g_hash_table_unref( found );
+
+	arr = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	return arr;
+}
+
+/*
+ * Returns a{sv} of the statistics of every source, see gr_history_get_stats(), and of their
+ * sums; a command of several sources is counted in each of them.
+ */
+GVariant*
+gr_history_group_get_stats(
+	GrHistoryGroup *self )
+{
+	GVariantBuilder builder, sources_builder;
+	GrHistoryGroupSource *source;
+	GVariantDict *dict;
+	GVariant *stats;
+	gchar *path, *display_path;
+	guint64 bytes, size;
+	gint64 load_time, time;
+	guint i, n_records, n;
+
+	g_return_val_if_fail( GR_IS_HISTORY_GROUP( self ), NULL );
+
+	bytes = sizeof( GrHistoryGroup ) + (guint64)self->sources->len * sizeof( GrHistoryGroupSource );
+	load_time = 0;
+	n_records = 0;
+	g_variant_builder_init( &sources_builder, G_VARIANT_TYPE( "aa{sv}" ) );
+	for( i = 0; i < self->sources->len; ++i )
+	{
+		source = &g_array_index( self->sources, GrHistoryGroupSource, i );
+		stats = g_variant_ref_sink( gr_history_get_stats( source->history ) );
+		if( g_variant_lookup( stats, "entries", "u", &n ) )
+			n_records += n;
+		if( g_variant_lookup( stats, "bytes", "t", &size ) )
+			bytes += size;
+		if( g_variant_lookup( stats, "load-time", "x", &time ) )
+			load_time += time;
+
+		path = gr_history_get_file_path( source->history );
+		display_path = path != NULL ? g_filename_display_name( path ) : g_strdup( "" );
+		g_free( path );
+
+		dict = g_variant_dict_new( stats );
+		g_variant_dict_insert_value( dict, "path", g_variant_new_take_string( display_path ) );
+		g_variant_dict_insert_value( dict, "weight", g_variant_new_double( source->weight ) );
+		g_variant_dict_insert_value( dict, "read-only", g_variant_new_boolean( gr_history_get_read_only( source->history ) ) );
+		g_variant_builder_add_value( &sources_builder, g_variant_dict_end( dict ) );
+		g_variant_dict_unref( dict );
+		g_variant_unref( stats );
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( n_records ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+	g_variant_builder_add( &builder, "{sv}", "load-time", g_variant_new_int64( load_time ) );
+	g_variant_builder_add( &builder, "{sv}", "sources", g_variant_builder_end( &sources_builder ) );
+
+	return g_variant_builder_end( &builder );
+}
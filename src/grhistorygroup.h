@@ -0,0 +1,24 @@
+#ifndef GRHISTORYGROUP_H
+#define GRHISTORYGROUP_H
+
+#include "grhistory.h"
+
+#include <glib-object.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GR_TYPE_HISTORY_GROUP ( gr_history_group_get_type() )
+G_DECLARE_FINAL_TYPE( GrHistoryGroup, gr_history_group, GR, HISTORY_GROUP, GObject )
+
+GrHistoryGroup* gr_history_group_new( void );
+void gr_history_group_add( GrHistoryGroup *self, GrHistory *history, gdouble weight );
+void gr_history_group_set_ignore_case( GrHistoryGroup *self, gboolean ignore_case );
+gboolean gr_history_group_reload( GrHistoryGroup *self );
+void gr_history_group_push( GrHistoryGroup *self, const gchar *text );
+GStrv gr_history_group_search( GrHistoryGroup *self, const gchar *str, guint limit );
+GVariant* gr_history_group_get_stats( GrHistoryGroup *self );
+
+G_END_DECLS
+
+#endif
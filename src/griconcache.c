@@ -0,0 +1,123 @@
+#include "griconcache.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+/* the icon of a listed text, NULL if it has none */
+struct _GrIconCacheEntry
+{
+	gchar *name;
+	GdkTexture *texture;
+	GList link; /* in the queue of entries */
+};
+typedef struct _GrIconCacheEntry GrIconCacheEntry;
+
+/* the cache is used by the main thread only, the textures are shared by the rows */
+struct _GrIconCache
+{
+	guint size;
+
+	GHashTable *entries; /* by their names */
+	GQueue queue; /* the most recently used first */
+};
+
+static void
+gr_icon_cache_entry_free(
+	GrIconCacheEntry *entry )
+{
+	g_free( entry->name );
+	g_clear_object( &entry->texture );
+	g_free( entry );
+}
+
+GrIconCache*
+gr_icon_cache_new(
+	guint size )
+{
+	GrIconCache *self;
+
+	self = g_new( GrIconCache, 1 );
+	self->size = MAX( size, 1 );
+	self->entries = g_hash_table_new_full( g_str_hash, g_str_equal, NULL, (GDestroyNotify)gr_icon_cache_entry_free );
+	g_queue_init( &self->queue );
+
+	return self;
+}
+
+void
+gr_icon_cache_free(
+	GrIconCache *self )
+{
+	if( self == NULL )
+		return;
+
+	g_hash_table_unref( self->entries );
+	g_free( self );
+}
+
+/*
+ * Returns TRUE, if the icon of name is known, and sets texture to it without a new
+ * reference, NULL if name has no icon. The icon becomes the most recently used one.
+ */
+gboolean
+gr_icon_cache_lookup(
+	GrIconCache *self,
+	const gchar *name,
+	GdkTexture **texture )
+{
+	GrIconCacheEntry *entry;
+
+	g_return_val_if_fail( self != NULL, FALSE );
+	g_return_val_if_fail( name != NULL, FALSE );
+
+	entry = (GrIconCacheEntry*)g_hash_table_lookup( self->entries, name );
+	if( entry == NULL )
+		return FALSE;
+
+	g_queue_unlink( &self->queue, &entry->link );
+	g_queue_push_head_link( &self->queue, &entry->link );
+
+	if( texture != NULL )
+		*texture = entry->texture;
+
+	return TRUE;
+}
+
+/* store the icon of name, texture may be NULL if it has none; the least recently used one is dropped */
+void
+gr_icon_cache_insert(
+	GrIconCache *self,
+	const gchar *name,
+	GdkTexture *texture )
+{
+	GrIconCacheEntry *entry;
+	GList *link;
+
+	g_return_if_fail( self != NULL );
+	g_return_if_fail( name != NULL );
+
+	entry = (GrIconCacheEntry*)g_hash_table_lookup( self->entries, name );
+	if( entry != NULL )
+	{
+		g_clear_object( &entry->texture );
+		entry->texture = texture != NULL ? GDK_TEXTURE( g_object_ref( G_OBJECT( texture ) ) ) : NULL;
+		g_queue_unlink( &self->queue, &entry->link );
+		g_queue_push_head_link( &self->queue, &entry->link );
+		return;
+	}
+
+	if( self->queue.length >= self->size )
+	{
+		link = g_queue_pop_tail_link( &self->queue );
+		g_hash_table_remove( self->entries, ( (GrIconCacheEntry*)link->data )->name );
+	}
+
+	entry = g_new( GrIconCacheEntry, 1 );
+	entry->name = g_strdup( name );
+	entry->texture = texture != NULL ? GDK_TEXTURE( g_object_ref( G_OBJECT( texture ) ) ) : NULL;
+	entry->link.data = entry;
+	entry->link.next = NULL;
+	entry->link.prev = NULL;
+	g_hash_table_insert( self->entries, entry->name, entry );
+	g_queue_push_head_link( &self->queue, &entry->link );
+}
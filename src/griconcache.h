@@ -0,0 +1,18 @@
+#ifndef GRICONCACHE_H
+#define GRICONCACHE_H
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrIconCache GrIconCache;
+
+GrIconCache* gr_icon_cache_new( guint size );
+void gr_icon_cache_free( GrIconCache *self );
+gboolean gr_icon_cache_lookup( GrIconCache *self, const gchar *name, GdkTexture **texture );
+void gr_icon_cache_insert( GrIconCache *self, const gchar *name, GdkTexture *texture );
+
+G_END_DECLS
+
+#endif
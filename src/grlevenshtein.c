@@ -0,0 +1,118 @@
+#include "grlevenshtein.h"
+
+#include <glib.h>
+#include <string.h>
+
+/*
+ * The automaton of the strings within max_distance edits from str, walked over a trie byte by
+ * byte. It keeps a row of len + 1 states for every depth of the path from the root, the row of
+ * a child is computed from the rows of its parent and grandparent, so going back up the path
+ * costs nothing: the walk steps again from a shallower depth. A subtree is left as soon as no
+ * state of its row is within max_distance.
+ */
+struct _GrLevenshtein
+{
+	gchar *str;
+	guint len;
+	guint max_distance;
+	guint n_rows; /* a node deeper than len + max_distance has no state within max_distance */
+	guint *rows; /* a row of len + 1 states per depth */
+	guint *best; /* the least distance from str to a prefix of the path up to every depth */
+};
+
+/* returns the automaton of the strings having a prefix within max_distance edits from str */
+GrLevenshtein*
+gr_levenshtein_new(
+	const gchar *str,
+	guint max_distance )
+{
+	GrLevenshtein *self;
+	guint j;
+
+	g_return_val_if_fail( str != NULL, NULL );
+
+	self = g_new( GrLevenshtein, 1 );
+	self->str = g_strdup( str );
+	self->len = (guint)strlen( str );
+	self->max_distance = max_distance;
+	self->n_rows = self->len + max_distance + 2;
+	self->rows = g_new( guint, self->n_rows * ( self->len + 1 ) );
+	self->best = g_new( guint, self->n_rows );
+
+	for( j = 0; j <= self->len; ++j )
+		self->rows[j] = j;
+	self->best[0] = self->len;
+
+	return self;
+}
+
+void
+gr_levenshtein_free(
+	GrLevenshtein *self )
+{
+	if( self == NULL )
+		return;
+
+	g_free( self->str );
+	g_free( self->rows );
+	g_free( self->best );
+	g_free( self );
+}
+
+/*
+ * Computes the row of depth + 1 from the byte of path at depth, the rows of the shallower depths
+ * must be computed for the same bytes of path. Returns FALSE if no state is within max_distance,
+ * so no string starting with the depth + 1 bytes of path is closer than the prefixes before.
+ */
+gboolean
+gr_levenshtein_step(
+	GrLevenshtein *self,
+	const gchar *path,
+	guint depth )
+{
+	const guint *row, *prev_row;
+	guint *child_row;
+	guint j, d, min;
+	guchar c, prev_c;
+
+	g_return_val_if_fail( self != NULL, FALSE );
+	g_return_val_if_fail( path != NULL, FALSE );
+
+	if( depth + 1 >= self->n_rows )
+		return FALSE;
+
+	row = self->rows + depth * ( self->len + 1 );
+	prev_row = depth > 0 ? row - ( self->len + 1 ) : NULL;
+	child_row = (guint*)row + self->len + 1;
+	c = (guchar)path[depth];
+	prev_c = depth > 0 ? (guchar)path[depth - 1] : '\0';
+
+	/* insertion, deletion, substitution and transposition of adjacent characters */
+	child_row[0] = depth + 1;
+	min = child_row[0];
+	for( j = 1; j <= self->len; ++j )
+	{
+		d = MIN( row[j] + 1, child_row[j - 1] + 1 );
+		d = MIN( d, row[j - 1] + ( (guchar)self->str[j - 1] == c ? 0 : 1 ) );
+		if( j > 1 && prev_row != NULL && (guchar)self->str[j - 1] == prev_c && (guchar)self->str[j - 2] == c )
+			d = MIN( d, prev_row[j - 2] + 1 );
+
+		child_row[j] = d;
+		min = MIN( min, d );
+	}
+	self->best[depth + 1] = MIN( self->best[depth], child_row[self->len] );
+
+	return min <= self->max_distance;
+}
+
+/* the least distance from str to a prefix of the path not longer than depth, G_MAXUINT if none is within max_distance */
+guint
+gr_levenshtein_get_distance(
+	GrLevenshtein *self,
+	guint depth )
+{
+	g_return_val_if_fail( self != NULL, G_MAXUINT );
+	g_return_val_if_fail( depth < self->n_rows, G_MAXUINT );
+
+	return self->best[depth] <= self->max_distance ? self->best[depth] : G_MAXUINT;
+}
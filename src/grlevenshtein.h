@@ -0,0 +1,17 @@
+#ifndef GRLEVENSHTEIN_H
+#define GRLEVENSHTEIN_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrLevenshtein GrLevenshtein;
+
+GrLevenshtein* gr_levenshtein_new( const gchar *str, guint max_distance );
+void gr_levenshtein_free( GrLevenshtein *self );
+gboolean gr_levenshtein_step( GrLevenshtein *self, const gchar *path, guint depth );
+guint gr_levenshtein_get_distance( GrLevenshtein *self, guint depth );
+
+G_END_DECLS
+
+#endif
@@ -1,5 +1,9 @@
 #include "grlist.h"
 
+#include "config.h"
+#include "grcommandlist.h"
+#include "griconcache.h"
+
 #include <glib-object.h>
 #include <glib.h>
 #include <gio/gio.h>
@@ -11,15 +15,37 @@ struct _GrList
 
 	GtkScrolledWindow *scrolled_window;
 	GtkListView *list_view;
+
+	GtkStringList *string_list;
+	GHashTable *texts;
+
+	/* icons are resolved by worker threads, NULL if they are disabled */
+	GrCommandList *com_list;
+	GrIconCache *icon_cache;
+	GHashTable *icon_requests; /* the texts being resolved */
+	GHashTable *icon_images; /* the image of every bound row to the text of the row */
+	GCancellable *icon_cancellable;
 };
 typedef struct _GrList GrList;
 
+/* the icon of a text resolved by a worker thread */
+struct _GrListIconRequest
+{
+	gchar *text;
+	GrCommandList *com_list;
+	GtkIconTheme *icon_theme;
+	gint size;
+	gint scale;
+};
+typedef struct _GrListIconRequest GrListIconRequest;
+
 enum _GrListPropertyID
 {
 	PROP_0, /* 0 is reserved for GObject */
 
 	PROP_MIN_CONTENT_HEIGHT,
 	PROP_MAX_CONTENT_HEIGHT,
+	PROP_COMMAND_LIST,
 
 	N_PROPS
 };
@@ -30,6 +56,7 @@ static GParamSpec *object_props[N_PROPS] = { NULL, };
 enum _GrListSignalID
 {
 	SIGNAL_ACTIVATE,
+	SIGNAL_END_REACHED,
 
 	N_SIGNALS
 };
@@ -39,12 +66,173 @@ static guint gr_list_signals[N_SIGNALS] = { 0, };
 
 G_DEFINE_TYPE( GrList, gr_list, GTK_TYPE_WIDGET )
 
+static void
+gr_list_icon_request_free(
+	GrListIconRequest *req )
+{
+	g_free( req->text );
+	g_clear_object( &req->com_list );
+	g_object_unref( G_OBJECT( req->icon_theme ) );
+	g_free( req );
+}
+
+/* the icon of the desktop entry named text or the themed icon of the command */
+static GIcon*
+gr_list_icon_request_get_icon(
+	GrListIconRequest *req )
+{
+	GAppInfo *app_info;
+	GIcon *icon;
+	gchar *command, *basename;
+
+	/* the desktop entry is read from disk */
+	if( req->com_list != NULL )
+	{
+		app_info = gr_command_list_get_app_info( req->com_list, req->text );
+		if( app_info != NULL )
+		{
+			icon = g_app_info_get_icon( app_info );
+			if( icon != NULL )
+				g_object_ref( G_OBJECT( icon ) );
+			g_object_unref( G_OBJECT( app_info ) );
+			if( icon != NULL )
+				return icon;
+		}
+	}
+
+	/* many binaries have icons of their names */
+	command = g_strndup( req->text, strcspn( req->text, " \t" ) );
+	basename = g_path_get_basename( command );
+	icon = *basename != '\0' && *basename != G_DIR_SEPARATOR ? g_themed_icon_new( basename ) : NULL;
+	g_free( basename );
+	g_free( command );
+
+	return icon;
+}
+
+/* the icon theme is thread-safe in GTK 4, the texture is loaded from its file */
+static void
+gr_list_icon_task_run(
+	GTask *task,
+	gpointer source_object,
+	gpointer task_data,
+	GCancellable *cancellable )
+{
+	GrListIconRequest *req = (GrListIconRequest*)task_data;
+	GtkIconPaintable *paintable;
+	GdkTexture *texture;
+	GFile *file;
+	GIcon *icon;
+
+	if( g_task_return_error_if_cancelled( task ) )
+		return;
+
+	file = NULL;
+	icon = gr_list_icon_request_get_icon( req );
+	if( G_IS_FILE_ICON( icon ) )
+		file = G_FILE( g_object_ref( G_OBJECT( g_file_icon_get_file( G_FILE_ICON( icon ) ) ) ) );
+	else if( G_IS_THEMED_ICON( icon ) && gtk_icon_theme_has_gicon( req->icon_theme, icon ) )
+	{
+		paintable = gtk_icon_theme_lookup_by_gicon( req->icon_theme, icon, req->size, req->scale, GTK_TEXT_DIR_NONE, 0 );
+		file = gtk_icon_paintable_get_file( paintable );
+		g_object_unref( G_OBJECT( paintable ) );
+	}
+	if( icon != NULL )
+		g_object_unref( G_OBJECT( icon ) );
+
+	/* a text without an icon is cached too */
+	texture = NULL;
+	if( file != NULL )
+	{
+		texture = gdk_texture_new_from_file( file, NULL );
+		g_object_unref( G_OBJECT( file ) );
+	}
+
+	g_task_return_pointer( task, texture, g_object_unref );
+}
+
+static void
+on_icon_task_ready(
+	GObject *source_object,
+	GAsyncResult *res,
+	gpointer user_data )
+{
+	GrList *list = GR_LIST( source_object );
+	GrListIconRequest *req;
+	GHashTableIter iter;
+	gpointer image, text;
+	GdkTexture *texture;
+	GError *error = NULL;
+
+	/* the list is disposed */
+	texture = (GdkTexture*)g_task_propagate_pointer( G_TASK( res ), &error );
+	if( error != NULL )
+	{
+		g_error_free( error );
+		return;
+	}
+
+	req = (GrListIconRequest*)g_task_get_task_data( G_TASK( res ) );
+	g_hash_table_remove( list->icon_requests, req->text );
+	gr_icon_cache_insert( list->icon_cache, req->text, texture );
+
+	/* replace the placeholders of the rows showing the text */
+	g_hash_table_iter_init( &iter, list->icon_images );
+	while( g_hash_table_iter_next( &iter, &image, &text ) )
+		if( g_str_equal( (const gchar*)text, req->text ) )
+			gtk_image_set_from_paintable( GTK_IMAGE( image ), GDK_PAINTABLE( texture ) );
+
+	if( texture != NULL )
+		g_object_unref( G_OBJECT( texture ) );
+}
+
+/* show the cached icon of text or resolve it, scrolling never waits for the icon theme or disk */
+static void
+gr_list_bind_icon(
+	GrList *self,
+	GtkImage *image,
+	const gchar *text )
+{
+	GrListIconRequest *req;
+	GdkTexture *texture;
+	GTask *task;
+
+	g_hash_table_insert( self->icon_images, image, g_strdup( text ) );
+
+	if( gr_icon_cache_lookup( self->icon_cache, text, &texture ) )
+	{
+		gtk_image_set_from_paintable( image, GDK_PAINTABLE( texture ) );
+		return;
+	}
+
+	/* the empty image keeps the place of the icon while it is resolved */
+	gtk_image_clear( image );
+	if( g_hash_table_contains( self->icon_requests, text ) )
+		return;
+
+	req = g_new( GrListIconRequest, 1 );
+	req->text = g_strdup( text );
+	req->com_list = self->com_list != NULL ? GR_COMMAND_LIST( g_object_ref( G_OBJECT( self->com_list ) ) ) : NULL;
+	req->icon_theme = GTK_ICON_THEME( g_object_ref( G_OBJECT( gtk_icon_theme_get_for_display( gtk_widget_get_display( GTK_WIDGET( self ) ) ) ) ) );
+	req->size = LIST_ICON_SIZE;
+	req->scale = gtk_widget_get_scale_factor( GTK_WIDGET( self ) );
+	g_hash_table_add( self->icon_requests, g_strdup( text ) );
+
+	task = g_task_new( self, self->icon_cancellable, on_icon_task_ready, NULL );
+	g_task_set_task_data( task, req, (GDestroyNotify)gr_list_icon_request_free );
+	g_task_run_in_thread( task, gr_list_icon_task_run );
+	g_object_unref( G_OBJECT( task ) );
+}
+
 static void
 on_item_factory_setup(
 	GtkSignalListItemFactory *self,
 	GtkListItem *list_item,
 	gpointer user_data )
 {
+	GrList *list = GR_LIST( user_data );
+	GtkBox *box;
+	GtkImage *image;
 	GtkLabel *label;
 
 	label = GTK_LABEL( gtk_label_new( NULL ) );
@@ -52,7 +240,22 @@ on_item_factory_setup(
 	gtk_label_set_single_line_mode( label, TRUE );
 	gtk_label_set_selectable( label, FALSE );
 
-	gtk_list_item_set_child( list_item, GTK_WIDGET( label ) );
+	if( list->icon_cache == NULL )
+	{
+		gtk_list_item_set_child( list_item, GTK_WIDGET( label ) );
+		return;
+	}
+
+	/* the row is the icon followed by the text */
+	image = GTK_IMAGE( gtk_image_new() );
+	gtk_image_set_pixel_size( image, LIST_ICON_SIZE );
+	gtk_widget_set_size_request( GTK_WIDGET( image ), LIST_ICON_SIZE, LIST_ICON_SIZE );
+
+	box = GTK_BOX( gtk_box_new( GTK_ORIENTATION_HORIZONTAL, 6 ) );
+	gtk_box_append( box, GTK_WIDGET( image ) );
+	gtk_box_append( box, GTK_WIDGET( label ) );
+
+	gtk_list_item_set_child( list_item, GTK_WIDGET( box ) );
 }
 
 static void
@@ -61,13 +264,36 @@ on_item_factory_bind(
 	GtkListItem *list_item,
 	gpointer user_data )
 {
+	GrList *list = GR_LIST( user_data );
+	GtkWidget *child;
 	gchar *string;
 
 	g_object_get( gtk_list_item_get_item( list_item ), "string", &string, NULL );
-	gtk_label_set_text( GTK_LABEL( gtk_list_item_get_child( list_item ) ), string );
+
+	child = gtk_list_item_get_child( list_item );
+	if( list->icon_cache == NULL )
+		gtk_label_set_text( GTK_LABEL( child ), string );
+	else
+	{
+		gtk_label_set_text( GTK_LABEL( gtk_widget_get_last_child( child ) ), string );
+		gr_list_bind_icon( list, GTK_IMAGE( gtk_widget_get_first_child( child ) ), string );
+	}
+
 	g_free( string );
 }
 
+static void
+on_item_factory_unbind(
+	GtkSignalListItemFactory *self,
+	GtkListItem *list_item,
+	gpointer user_data )
+{
+	GrList *list = GR_LIST( user_data );
+
+	if( list->icon_cache != NULL )
+		g_hash_table_remove( list->icon_images, gtk_widget_get_first_child( gtk_list_item_get_child( list_item ) ) );
+}
+
 static void
 on_list_view_activate(
 	GtkListView *self,
@@ -82,12 +308,31 @@ on_list_view_activate(
 	g_free( text );
 }
 
+static void
+on_scrolled_window_edge_reached(
+	GtkScrolledWindow *self,
+	GtkPositionType pos,
+	gpointer user_data )
+{
+	GrList *list = GR_LIST( user_data );
+
+	if( pos == GTK_POS_BOTTOM )
+		g_signal_emit( list, gr_list_signals[SIGNAL_END_REACHED], 0 );
+}
+
 static void
 gr_list_init(
 	GrList *self )
 {
 	GtkListItemFactory *item_factory;
 
+	/* icons are set up before the rows */
+	self->com_list = NULL;
+	self->icon_cache = ICON_CACHE_SIZE > 0 ? gr_icon_cache_new( ICON_CACHE_SIZE ) : NULL;
+	self->icon_requests = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL );
+	self->icon_images = g_hash_table_new_full( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_free );
+	self->icon_cancellable = g_cancellable_new();
+
 	/* create widgets */
 	self->scrolled_window = GTK_SCROLLED_WINDOW( gtk_scrolled_window_new() );
 	gtk_scrolled_window_set_policy( self->scrolled_window, GTK_POLICY_NEVER, GTK_POLICY_ALWAYS );
@@ -104,8 +349,13 @@ gr_list_init(
 
 	g_signal_connect( G_OBJECT( item_factory ), "setup", G_CALLBACK( on_item_factory_setup ), self );
 	g_signal_connect( G_OBJECT( item_factory ), "bind", G_CALLBACK( on_item_factory_bind ), self );
+	g_signal_connect( G_OBJECT( item_factory ), "unbind", G_CALLBACK( on_item_factory_unbind ), self );
 
 	g_signal_connect( G_OBJECT( self->list_view ), "activate", G_CALLBACK( on_list_view_activate ), self );
+	g_signal_connect( G_OBJECT( self->scrolled_window ), "edge-reached", G_CALLBACK( on_scrolled_window_edge_reached ), self );
+
+	self->string_list = NULL;
+	self->texts = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL );
 
 	/*layout widgets */
 	gtk_widget_set_parent( GTK_WIDGET( self->scrolled_window ), GTK_WIDGET( self ) );
@@ -129,6 +379,9 @@ gr_list_get_property(
 		case PROP_MAX_CONTENT_HEIGHT:
 			g_value_set_int( value, gtk_scrolled_window_get_max_content_height( self->scrolled_window ) );
 			break;
+		case PROP_COMMAND_LIST:
+			g_value_set_object( value, self->com_list );
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
 			break;
@@ -152,6 +405,9 @@ gr_list_set_property(
 		case PROP_MAX_CONTENT_HEIGHT:
 			gr_list_set_max_content_height( self, g_value_get_int( value ) );
 			break;
+		case PROP_COMMAND_LIST:
+			gr_list_set_command_list( self, g_value_get_object( value ) );
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
 			break;
@@ -164,11 +420,30 @@ gr_list_dispose(
 {
 	GrList *self = GR_LIST( object );
 
+	/* the icons being resolved are dropped, the tasks hold the list until they return */
+	g_cancellable_cancel( self->icon_cancellable );
+
 	gtk_widget_unparent( GTK_WIDGET( self->scrolled_window ) );
+	g_clear_pointer( &self->texts, g_hash_table_unref );
+	g_clear_object( &self->com_list );
 
 	G_OBJECT_CLASS( gr_list_parent_class )->dispose( object );
 }
 
+static void
+gr_list_finalize(
+	GObject *object )
+{
+	GrList *self = GR_LIST( object );
+
+	gr_icon_cache_free( self->icon_cache );
+	g_hash_table_unref( self->icon_requests );
+	g_hash_table_unref( self->icon_images );
+	g_object_unref( G_OBJECT( self->icon_cancellable ) );
+
+	G_OBJECT_CLASS( gr_list_parent_class )->finalize( object );
+}
+
 static void
 gr_list_class_init(
 	GrListClass *klass )
@@ -179,6 +454,7 @@ gr_list_class_init(
 	object_class->get_property = gr_list_get_property;
 	object_class->set_property = gr_list_set_property;
 	object_class->dispose = gr_list_dispose;
+	object_class->finalize = gr_list_finalize;
 
 	object_props[PROP_MIN_CONTENT_HEIGHT] = g_param_spec_int(
 		"min-content-height",
@@ -196,6 +472,12 @@ gr_list_class_init(
 		G_MAXINT,
 		0,
 		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_COMMAND_LIST] = g_param_spec_object(
+		"command-list",
+		"Command list",
+		"Object resolving the icons of desktop entries",
+		GR_TYPE_COMMAND_LIST,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
 	g_object_class_install_properties( object_class, N_PROPS, object_props );
 
 	gr_list_signals[SIGNAL_ACTIVATE] = g_signal_new(
@@ -210,6 +492,18 @@ gr_list_class_init(
 		1,
 		G_TYPE_STRING );
 
+	/* the list is scrolled to its end, more items may be appended */
+	gr_list_signals[SIGNAL_END_REACHED] = g_signal_new(
+		"end-reached",
+		G_TYPE_FROM_CLASS( klass ),
+		G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS,
+		0,
+		NULL,
+		NULL,
+		NULL,
+		G_TYPE_NONE,
+		0 );
+
 	gtk_widget_class_set_layout_manager_type( widget_class, GTK_TYPE_BIN_LAYOUT );
 }
 
@@ -270,25 +564,99 @@ gr_list_set_max_content_height(
 	g_object_thaw_notify( G_OBJECT( self ) );
 }
 
+GrCommandList*
+gr_list_get_command_list(
+	GrList *self )
+{
+	g_return_val_if_fail( GR_IS_LIST( self ), NULL );
+
+	if( self->com_list == NULL )
+		return NULL;
+
+	return GR_COMMAND_LIST( g_object_ref( G_OBJECT( self->com_list ) ) );
+}
+
+void
+gr_list_set_command_list(
+	GrList *self,
+	GrCommandList *com_list )
+{
+	g_return_if_fail( GR_IS_LIST( self ) );
+	g_return_if_fail( GR_IS_COMMAND_LIST( com_list ) );
+
+	g_object_freeze_notify( G_OBJECT( self ) );
+
+	g_clear_object( &self->com_list );
+	self->com_list = GR_COMMAND_LIST( g_object_ref( com_list ) );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_COMMAND_LIST] );
+
+	g_object_thaw_notify( G_OBJECT( self ) );
+}
+
 void
 gr_list_set_array(
 	GrList *self,
 	const GStrv array )
+{
+	g_return_if_fail( GR_IS_LIST( self ) );
+
+	/* reset the list view's model */
+	gtk_list_view_set_model( self->list_view, NULL );
+	self->string_list = NULL;
+	g_hash_table_remove_all( self->texts );
+
+	gr_list_append_array( self, array );
+}
+
+guint
+gr_list_get_n_items(
+	GrList *self )
+{
+	g_return_val_if_fail( GR_IS_LIST( self ), 0 );
+
+	return g_hash_table_size( self->texts );
+}
+
+/* append strings not in the list yet */
+void
+gr_list_append_array(
+	GrList *self,
+	const GStrv array )
 {
 	GtkSingleSelection *single_selection;
+	GStrvBuilder *builder;
+	GStrv arr, a;
 
 	g_return_if_fail( GR_IS_LIST( self ) );
 
-	/* if nothing to insert, reset the list view's model */
+	/* nothing to insert */
 	if( array == NULL || array[0] == NULL )
+		return;
+
+	builder = g_strv_builder_new();
+	for( a = array; *a != NULL; ++a )
+		if( g_hash_table_add( self->texts, g_strdup( *a ) ) )
+			g_strv_builder_add( builder, *a );
+	arr = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	if( arr[0] == NULL )
 	{
-		gtk_list_view_set_model( self->list_view, NULL );
+		g_strfreev( arr );
 		return;
 	}
 
-	single_selection = gtk_single_selection_new( G_LIST_MODEL( gtk_string_list_new( (const gchar* const*)array ) ) );
-	gtk_list_view_set_model( self->list_view, GTK_SELECTION_MODEL( single_selection ) );
-	g_object_unref( G_OBJECT( single_selection ) );
+	if( self->string_list == NULL )
+	{
+		self->string_list = gtk_string_list_new( (const gchar* const*)arr );
+		single_selection = gtk_single_selection_new( G_LIST_MODEL( self->string_list ) );
+		gtk_list_view_set_model( self->list_view, GTK_SELECTION_MODEL( single_selection ) );
+		g_object_unref( G_OBJECT( single_selection ) );
+	}
+	else
+		gtk_string_list_splice( self->string_list, g_list_model_get_n_items( G_LIST_MODEL( self->string_list ) ), 0, (const gchar* const*)arr );
+	g_strfreev( arr );
 }
 
 gchar*
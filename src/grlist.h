@@ -18,7 +18,11 @@ gint gr_list_get_min_content_height( GrList *self );
 void gr_list_set_min_content_height( GrList *self, gint height );
 gint gr_list_get_max_content_height( GrList *self );
 void gr_list_set_max_content_height( GrList *self, gint height );
+GrCommandList* gr_list_get_command_list( GrList *self );
+void gr_list_set_command_list( GrList *self, GrCommandList *com_list );
 void gr_list_set_array( GrList *self, const GStrv array );
+void gr_list_append_array( GrList *self, const GStrv array );
+guint gr_list_get_n_items( GrList *self );
 gchar* gr_list_get_selected_text( GrList *self );
 
 G_END_DECLS
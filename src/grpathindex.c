@@ -0,0 +1,1362 @@
+#include "grpathindex.h"
+
+#include "config.h"
+#include "grcompletionprovider.h"
+#include "grfrontcoding.h"
+#include "grlevenshtein.h"
+#include "grpathscan.h"
+#include "grpathshard.h"
+#include "grstats.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+/* binaries go after history */
+#define PATH_INDEX_SCORE 1.0
+
+#define STORE_FILE "index"
+#define STORE_INDEX_GROUP "Index"
+#define STORE_DIRECTORIES_GROUP "Directories"
+
+/* the own shards and the shards of the system index */
+#define PATH_INDEX_LAYER_OWN 0
+#define PATH_INDEX_LAYER_SYSTEM 1
+#define PATH_INDEX_N_LAYERS 2
+
+/* a query by keys merges the shard of the first byte and the shard of non-ASCII names of every layer */
+#define PATH_INDEX_MAX_QUERY_SHARDS ( 2 * PATH_INDEX_N_LAYERS )
+
+/* the size of the shards of a layer, a stored one is read from its manifest */
+struct _GrPathIndexLayerSize
+{
+	gboolean known; /* FALSE, if the manifest does not list it */
+	guint n_names;
+	guint n_shards;
+	guint64 bytes;
+};
+typedef struct _GrPathIndexLayerSize GrPathIndexLayerSize;
+
+struct _GrPathIndex
+{
+	GObject parent_instance;
+
+	gchar *env_path;
+	GStrv dirs; /* indexed instead of the directories of env_path, if not NULL */
+	gchar *cache_path;
+	gchar *store_path; /* NULL, if the index is not stored */
+	gchar *system_path; /* NULL, if there is no system index */
+
+	/* a stored shard is mapped by the first query touching it, the others are built on
+	 * construction, they are not changed after that */
+	GMutex mutex;
+	GrPathShard *shards[PATH_INDEX_N_LAYERS][GR_PATH_SHARD_N_IDS];
+	guint n_layers; /* 2, if the system index covers a part of the directories */
+	GrPathIndexLayerSize layer_sizes[PATH_INDEX_N_LAYERS]; /* the mapped shards are counted if unknown */
+	guint64 system_stamp;
+	GPtrArray *scan_dirs;
+	guint64 stamp; /* hash of the names */
+	gboolean stored;
+
+	/* hold the name returned by the last lookup of the main thread */
+	GrFrontCodingIter lookup_iters[PATH_INDEX_N_LAYERS];
+
+	/* match keys instead of names */
+	gint ignore_case;
+};
+typedef struct _GrPathIndex GrPathIndex;
+
+/* a shard merged by a query, its head is the first string not taken yet */
+struct _GrPathIndexCursor
+{
+	GrPathShard *shard;
+	GrFrontCodingIter iter;
+	GrFrontCodingIter name_iter; /* the name of the key at iter */
+	gboolean valid;
+};
+typedef struct _GrPathIndexCursor GrPathIndexCursor;
+
+/* a name matched by a fuzzy query */
+struct _GrPathIndexMatch
+{
+	guint distance;
+	const gchar *key;
+	const gchar *name;
+};
+typedef struct _GrPathIndexMatch GrPathIndexMatch;
+
+enum _GrPathIndexPropertyID
+{
+	PROP_0, /* 0 is reserved for GObject */
+
+	PROP_ENV_PATH,
+	PROP_DIRS,
+	PROP_CACHE_PATH,
+	PROP_STORE_PATH,
+	PROP_SYSTEM_PATH,
+	PROP_IGNORE_CASE,
+
+	N_PROPS
+};
+typedef enum _GrPathIndexPropertyID GrPathIndexPropertyID;
+
+static GParamSpec *object_props[N_PROPS] = { NULL, };
+
+static void gr_path_index_completion_provider_init( GrCompletionProviderInterface *iface );
+
+G_DEFINE_TYPE_WITH_CODE( GrPathIndex, gr_path_index, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE( GR_TYPE_COMPLETION_PROVIDER, gr_path_index_completion_provider_init ) )
+
+static gint
+gr_path_index_compare_names(
+	gconstpointer a,
+	gconstpointer b )
+{
+	return g_strcmp0( *(const gchar**)a, *(const gchar**)b );
+}
+
+static gint
+gr_path_index_compare_matches(
+	gconstpointer a,
+	gconstpointer b )
+{
+	const GrPathIndexMatch *match_a = (const GrPathIndexMatch*)a;
+	const GrPathIndexMatch *match_b = (const GrPathIndexMatch*)b;
+	gint ret;
+
+	if( match_a->distance != match_b->distance )
+		return match_a->distance < match_b->distance ? -1 : 1;
+
+	ret = strcmp( match_a->key, match_b->key );
+	if( ret != 0 )
+		return ret;
+
+	return strcmp( match_a->name, match_b->name );
+}
+
+static gchar*
+gr_path_index_build_shard_path(
+	const gchar *dir,
+	guint id )
+{
+	gchar *filename, *path;
+
+	filename = g_strdup_printf( "%02x", id );
+	path = g_build_filename( dir, filename, NULL );
+	g_free( filename );
+
+	return path;
+}
+
+/* returns the shard of the layer, a stored one is mapped on the first call */
+static GrPathShard*
+gr_path_index_get_shard(
+	GrPathIndex *self,
+	guint layer,
+	guint id )
+{
+	GrPathShard *shard;
+	gchar *path;
+
+	shard = (GrPathShard*)g_atomic_pointer_get( &self->shards[layer][id] );
+	if( shard != NULL )
+		return shard;
+
+	g_mutex_lock( &self->mutex );
+	shard = self->shards[layer][id];
+	if( shard == NULL )
+	{
+		path = gr_path_index_build_shard_path( layer == PATH_INDEX_LAYER_SYSTEM ? self->system_path : self->store_path, id );
+		shard = gr_path_shard_new_from_file( path );
+		g_free( path );
+		g_atomic_pointer_set( &self->shards[layer][id], shard );
+	}
+	g_mutex_unlock( &self->mutex );
+
+	return shard;
+}
+
+/* returns the number of shards set to the ones holding the strings starting with c */
+static guint
+gr_path_index_get_query_shards(
+	GrPathIndex *self,
+	guchar c,
+	gboolean keys,
+	GrPathShard **shards )
+{
+	guint layer, id, n_shards;
+
+	/* a non-ASCII name may have an ASCII key, so the shard of such names is merged in */
+	n_shards = 0;
+	id = gr_path_shard_get_id( c );
+	for( layer = 0; layer < self->n_layers; ++layer )
+	{
+		shards[n_shards++] = gr_path_index_get_shard( self, layer, id );
+		if( keys && id != GR_PATH_SHARD_ID_OTHER )
+			shards[n_shards++] = gr_path_index_get_shard( self, layer, GR_PATH_SHARD_ID_OTHER );
+	}
+
+	return n_shards;
+}
+
+/*
+ * Build the shards of the sorted names, a binary shadowed by an earlier directory is stored
+ * once. A name too long to be front coded cannot be a file name, so it is skipped.
+ */
+static void
+gr_path_index_build(
+	GrPathIndex *self,
+	GPtrArray *names )
+{
+	GPtrArray *shard_names[GR_PATH_SHARD_N_IDS], *shard_keys[GR_PATH_SHARD_N_IDS];
+	GBytes *bytes;
+	const gchar *name;
+	gchar *key;
+	guint i, id;
+
+	for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+	{
+		shard_names[id] = g_ptr_array_new();
+		shard_keys[id] = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+	}
+
+	for( i = 0; i < names->len; ++i )
+	{
+		name = (const gchar*)g_ptr_array_index( names, i );
+		if( i > 0 && g_strcmp0( name, g_ptr_array_index( names, i - 1 ) ) == 0 )
+			continue;
+
+		key = gr_completion_fold( name );
+		if( strlen( name ) > GR_FRONT_CODING_MAX_LENGTH || strlen( key ) > GR_FRONT_CODING_MAX_LENGTH )
+		{
+			g_free( key );
+			continue;
+		}
+
+		id = gr_path_shard_get_id( (guchar)name[0] );
+		g_ptr_array_add( shard_names[id], (gpointer)name );
+		g_ptr_array_add( shard_keys[id], key );
+		self->stamp = gr_completion_hash( self->stamp, name, strlen( name ) + 1 );
+		self->stamp = gr_completion_hash( self->stamp, key, strlen( key ) + 1 );
+	}
+
+	for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+	{
+		bytes = gr_path_shard_encode( (const gchar* const*)shard_names[id]->pdata, (const gchar* const*)shard_keys[id]->pdata, shard_names[id]->len );
+		self->shards[PATH_INDEX_LAYER_OWN][id] = gr_path_shard_new( bytes );
+		g_ptr_array_unref( shard_names[id] );
+		g_ptr_array_unref( shard_keys[id] );
+	}
+}
+
+/*
+ * The shards are written before the file listing the directories, which validates them. An
+ * index of the given directories is shared by all users, so it is readable by them.
+ */
+static void
+gr_path_index_store(
+	GrPathIndex *self,
+	const gchar *env_str )
+{
+	GKeyFile *key_file;
+	GrPathScanDir *scan_dir;
+	GrPathIndexLayerSize layer_size;
+	gconstpointer data;
+	gchar *path;
+	gsize size;
+	gint mode;
+	guint i, id;
+	GError *error = NULL;
+
+	/* the old shards are not valid while they are replaced */
+	mode = self->dirs != NULL ? 0644 : 0600;
+	g_mkdir_with_parents( self->store_path, self->dirs != NULL ? 0755 : 0700 );
+	path = g_build_filename( self->store_path, STORE_FILE, NULL );
+	g_unlink( path );
+	g_free( path );
+
+	layer_size.known = TRUE;
+	layer_size.n_names = 0;
+	layer_size.n_shards = 0;
+	layer_size.bytes = 0;
+	for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+	{
+		path = gr_path_index_build_shard_path( self->store_path, id );
+		data = g_bytes_get_data( self->shards[PATH_INDEX_LAYER_OWN][id]->bytes, &size );
+		layer_size.n_names += gr_front_coding_get_length( self->shards[PATH_INDEX_LAYER_OWN][id]->names );
+		layer_size.n_shards += size > 0 ? 1 : 0;
+		layer_size.bytes += size;
+		if( size == 0 )
+			g_unlink( path );
+		else if( !g_file_set_contents_full( path, data, (gssize)size, G_FILE_SET_CONTENTS_CONSISTENT, mode, &error ) )
+		{
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+				"MESSAGE", "Failed to store index: %s", error->message,
+				NULL );
+			g_error_free( error );
+			g_free( path );
+			return;
+		}
+		g_free( path );
+	}
+
+	key_file = g_key_file_new();
+	g_key_file_set_integer( key_file, STORE_INDEX_GROUP, "version", GR_PATH_SHARD_VERSION );
+	g_key_file_set_string( key_file, STORE_INDEX_GROUP, "path", env_str );
+	g_key_file_set_uint64( key_file, STORE_INDEX_GROUP, "stamp", self->stamp );
+	g_key_file_set_uint64( key_file, STORE_INDEX_GROUP, "entries", layer_size.n_names );
+	g_key_file_set_uint64( key_file, STORE_INDEX_GROUP, "shards", layer_size.n_shards );
+	g_key_file_set_uint64( key_file, STORE_INDEX_GROUP, "bytes", layer_size.bytes );
+	if( self->n_layers > 1 )
+		g_key_file_set_uint64( key_file, STORE_INDEX_GROUP, "system-stamp", self->system_stamp );
+
+	/* the directories of the system index are unchanged, they are checked the same way */
+	for( i = 0; i < self->scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( self->scan_dirs, i );
+		if( ( scan_dir->status == GR_PATH_SCAN_STATUS_DONE || scan_dir->status == GR_PATH_SCAN_STATUS_UNCHANGED ) && scan_dir->mtime >= 0 )
+			g_key_file_set_int64( key_file, STORE_DIRECTORIES_GROUP, scan_dir->path, scan_dir->mtime );
+	}
+
+	path = g_build_filename( self->store_path, STORE_FILE, NULL );
+	self->stored = g_key_file_save_to_file( key_file, path, &error );
+	if( !self->stored )
+	{
+		g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+			"MESSAGE", "Failed to store index: %s", error->message,
+			NULL );
+		g_error_free( error );
+	}
+	g_free( path );
+	g_key_file_free( key_file );
+}
+
+/* returns the file listing the directories of the index stored in dir, NULL if there is none or it is of another format */
+static GKeyFile*
+gr_path_index_load_manifest(
+	const gchar *dir )
+{
+	GKeyFile *key_file;
+	gchar *path;
+	gboolean loaded;
+
+	key_file = g_key_file_new();
+	path = g_build_filename( dir, STORE_FILE, NULL );
+	loaded = g_key_file_load_from_file( key_file, path, G_KEY_FILE_NONE, NULL );
+	g_free( path );
+
+	if( !loaded || g_key_file_get_integer( key_file, STORE_INDEX_GROUP, "version", NULL ) != GR_PATH_SHARD_VERSION )
+	{
+		g_key_file_free( key_file );
+		return NULL;
+	}
+
+	return key_file;
+}
+
+/* returns the table of the paths of the stored directories to their mtimes */
+static GHashTable*
+gr_path_index_get_manifest_mtimes(
+	GKeyFile *key_file )
+{
+	GHashTable *mtimes;
+	GStrv keys, k;
+	gint64 mtime;
+	GError *error = NULL;
+
+	mtimes = g_hash_table_new_full( g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free );
+	keys = g_key_file_get_keys( key_file, STORE_DIRECTORIES_GROUP, NULL, NULL );
+	for( k = keys; k != NULL && *k != NULL; ++k )
+	{
+		mtime = g_key_file_get_int64( key_file, STORE_DIRECTORIES_GROUP, *k, &error );
+		if( error != NULL )
+		{
+			g_clear_error( &error );
+			continue;
+		}
+		g_hash_table_insert( mtimes, g_strdup( *k ), g_memdup2( &mtime, sizeof( mtime ) ) );
+	}
+	g_strfreev( keys );
+
+	return mtimes;
+}
+
+/* reads the size of the stored shards, it is unknown for a manifest not listing it */
+static void
+gr_path_index_get_manifest_size(
+	GKeyFile *key_file,
+	GrPathIndexLayerSize *layer_size )
+{
+	GError *error = NULL;
+
+	layer_size->n_names = (guint)g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "entries", &error );
+	if( error == NULL )
+		layer_size->n_shards = (guint)g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "shards", &error );
+	if( error == NULL )
+		layer_size->bytes = g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "bytes", &error );
+
+	layer_size->known = error == NULL;
+	g_clear_error( &error );
+}
+
+/* returns the mtimes of the directories of the system index and sets its stamp and its size, NULL if there is none */
+static GHashTable*
+gr_path_index_load_system(
+	GrPathIndex *self,
+	guint64 *stamp )
+{
+	GKeyFile *key_file;
+	GHashTable *mtimes;
+	GError *error = NULL;
+
+	if( self->system_path == NULL )
+		return NULL;
+
+	key_file = gr_path_index_load_manifest( self->system_path );
+	if( key_file == NULL )
+		return NULL;
+
+	*stamp = g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "stamp", &error );
+	if( error != NULL )
+	{
+		g_error_free( error );
+		g_key_file_free( key_file );
+		return NULL;
+	}
+
+	mtimes = gr_path_index_get_manifest_mtimes( key_file );
+	gr_path_index_get_manifest_size( key_file, &self->layer_sizes[PATH_INDEX_LAYER_SYSTEM] );
+	g_key_file_free( key_file );
+
+	return mtimes;
+}
+
+/* returns TRUE, if every directory of the system index is scanned and not modified since it was indexed */
+static gboolean
+gr_path_index_covers_system(
+	GPtrArray *scan_dirs,
+	GHashTable *system_mtimes )
+{
+	GrPathScanDir *scan_dir;
+	GHashTable *covered;
+	const gint64 *system_mtime;
+	gboolean ret;
+	guint i;
+
+	covered = g_hash_table_new( g_str_hash, g_str_equal );
+	for( i = 0; i < scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( scan_dirs, i );
+		if( scan_dir->status != GR_PATH_SCAN_STATUS_DONE && scan_dir->status != GR_PATH_SCAN_STATUS_UNCHANGED )
+			continue;
+
+		system_mtime = (const gint64*)g_hash_table_lookup( system_mtimes, scan_dir->path );
+		if( system_mtime != NULL && scan_dir->mtime >= 0 && scan_dir->mtime == *system_mtime )
+			g_hash_table_add( covered, scan_dir->path );
+	}
+	ret = g_hash_table_size( covered ) == g_hash_table_size( system_mtimes );
+	g_hash_table_unref( covered );
+
+	return ret;
+}
+
+/*
+ * Enumerates the directories the scan skipped as unchanged, except the ones in system_mtimes
+ * if it is not NULL, and puts their results in place of the skipped ones.
+ */
+static void
+gr_path_index_scan_unchanged(
+	GrPathIndex *self,
+	GPtrArray *scan_dirs,
+	GHashTable *system_mtimes )
+{
+	GrPathScanDir *scan_dir, *rescan_dir;
+	GPtrArray *dirs, *rescan_dirs;
+	GArray *positions;
+	guint i, pos;
+
+	dirs = g_ptr_array_new();
+	positions = g_array_new( FALSE, FALSE, sizeof( guint ) );
+	for( i = 0; i < scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( scan_dirs, i );
+		if( scan_dir->status != GR_PATH_SCAN_STATUS_UNCHANGED || ( system_mtimes != NULL && g_hash_table_contains( system_mtimes, scan_dir->path ) ) )
+			continue;
+
+		g_ptr_array_add( dirs, scan_dir->path );
+		g_array_append_val( positions, i );
+	}
+
+	if( dirs->len > 0 )
+	{
+		g_ptr_array_add( dirs, NULL );
+		rescan_dirs = gr_path_scan( (const gchar* const*)dirs->pdata, PATH_SCAN_TIMEOUT * G_TIME_SPAN_MILLISECOND, PATH_SCAN_CACHE_TTL, self->cache_path, NULL );
+
+		/* the paths are distinct, so every one of them has its result */
+		for( i = 0; i < rescan_dirs->len && i < positions->len; ++i )
+		{
+			pos = g_array_index( positions, guint, i );
+			scan_dir = (GrPathScanDir*)g_ptr_array_index( scan_dirs, pos );
+			rescan_dir = (GrPathScanDir*)g_ptr_array_index( rescan_dirs, i );
+			g_ptr_array_index( rescan_dirs, i ) = NULL;
+
+			rescan_dir->elapsed += scan_dir->elapsed;
+			gr_path_scan_dir_free( scan_dir );
+			g_ptr_array_index( scan_dirs, pos ) = rescan_dir;
+		}
+		g_ptr_array_unref( rescan_dirs );
+	}
+	g_ptr_array_unref( dirs );
+	g_array_unref( positions );
+}
+
+/*
+ * Returns TRUE, if the stored index is up to date: no directory is modified since it was
+ * stored. The shards are not read then, they are mapped on demand. Otherwise sets stale_dirs
+ * to the scan checking it, if the directories are scanned, NULL if not: the modified ones are
+ * enumerated by it, the others are skipped as unchanged.
+ */
+static gboolean
+gr_path_index_load_store(
+	GrPathIndex *self,
+	const gchar *env_str,
+	const gchar* const *dirs,
+	GPtrArray **stale_dirs )
+{
+	GKeyFile *key_file;
+	GHashTable *known_mtimes, *system_mtimes;
+	GPtrArray *scan_dirs;
+	GrPathScanDir *scan_dir;
+	GrPathIndexLayerSize layer_size;
+	gchar *stored_env_str;
+	gboolean fresh, system_used;
+	guint64 stamp, system_stamp, stored_system_stamp;
+	guint i;
+	GError *error = NULL;
+
+	/* the index of another format or of another $PATH */
+	*stale_dirs = NULL;
+	key_file = gr_path_index_load_manifest( self->store_path );
+	if( key_file == NULL )
+		return FALSE;
+	stored_env_str = g_key_file_get_string( key_file, STORE_INDEX_GROUP, "path", NULL );
+	fresh = g_strcmp0( stored_env_str, env_str ) == 0;
+	g_free( stored_env_str );
+
+	stamp = fresh ? g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "stamp", &error ) : 0;
+	if( error != NULL )
+	{
+		g_clear_error( &error );
+		fresh = FALSE;
+	}
+
+	/* the index built over the system index is valid while the system index is the same */
+	system_used = fresh && g_key_file_has_key( key_file, STORE_INDEX_GROUP, "system-stamp", NULL );
+	if( system_used )
+	{
+		stored_system_stamp = g_key_file_get_uint64( key_file, STORE_INDEX_GROUP, "system-stamp", NULL );
+		system_mtimes = gr_path_index_load_system( self, &system_stamp );
+		fresh = system_mtimes != NULL && system_stamp == stored_system_stamp;
+		if( system_mtimes != NULL )
+			g_hash_table_unref( system_mtimes );
+	}
+
+	if( !fresh )
+	{
+		g_key_file_free( key_file );
+		return FALSE;
+	}
+
+	known_mtimes = gr_path_index_get_manifest_mtimes( key_file );
+	gr_path_index_get_manifest_size( key_file, &layer_size );
+	g_key_file_free( key_file );
+
+	/* the directories stored must be unchanged, the others must stay unreadable */
+	scan_dirs = gr_path_scan( dirs, PATH_SCAN_TIMEOUT * G_TIME_SPAN_MILLISECOND, PATH_SCAN_CACHE_TTL, self->cache_path, known_mtimes );
+	for( i = 0; fresh && i < scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( scan_dirs, i );
+		if( g_hash_table_contains( known_mtimes, scan_dir->path ) )
+			fresh = scan_dir->status == GR_PATH_SCAN_STATUS_UNCHANGED;
+		else
+			fresh = scan_dir->status != GR_PATH_SCAN_STATUS_DONE;
+	}
+	g_hash_table_unref( known_mtimes );
+
+	if( !fresh )
+	{
+		*stale_dirs = scan_dirs;
+		return FALSE;
+	}
+
+	self->scan_dirs = scan_dirs;
+	self->stamp = stamp;
+	self->layer_sizes[PATH_INDEX_LAYER_OWN] = layer_size;
+	if( system_used )
+	{
+		self->n_layers = PATH_INDEX_N_LAYERS;
+		self->system_stamp = system_stamp;
+	}
+	self->stored = TRUE;
+
+	return TRUE;
+}
+
+static void
+gr_path_index_load_list(
+	GrPathIndex *self )
+{
+	const gchar env_delim[] = ":";
+	const gchar *env_str = NULL;
+
+	GStrv env_arr;
+	GHashTable *system_mtimes;
+	GrPathScanDir *scan_dir;
+	GPtrArray *names;
+	gchar *dirs_str;
+	guint i;
+
+	g_return_if_fail( GR_IS_PATH_INDEX( self ) );
+
+	names = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+	dirs_str = self->dirs != NULL ? g_strjoinv( env_delim, self->dirs ) : NULL;
+	env_str = dirs_str != NULL ? dirs_str : ( self->env_path != NULL ? g_getenv( self->env_path ) : NULL );
+	if( env_str == NULL )
+	{
+		gr_path_index_build( self, names );
+		g_ptr_array_unref( names );
+		return;
+	}
+
+	/* the stored index is used while no directory is modified, otherwise its check has
+	 * enumerated the modified ones already */
+	env_arr = g_strsplit( env_str, env_delim, -1 );
+	if( self->store_path != NULL && gr_path_index_load_store( self, env_str, (const gchar* const*)env_arr, &self->scan_dirs ) )
+	{
+		g_strfreev( env_arr );
+		g_ptr_array_unref( names );
+		g_free( dirs_str );
+		return;
+	}
+
+	/* scan directories, not waiting for a hung one longer than the timeout; the directories
+	 * of the system index are not enumerated while they are not modified */
+	system_mtimes = gr_path_index_load_system( self, &self->system_stamp );
+	if( self->scan_dirs == NULL )
+		self->scan_dirs = gr_path_scan( (const gchar* const*)env_arr, PATH_SCAN_TIMEOUT * G_TIME_SPAN_MILLISECOND, PATH_SCAN_CACHE_TTL, self->cache_path, system_mtimes );
+	g_strfreev( env_arr );
+
+	/* the system index is used while none of its directories is modified or out of $PATH,
+	 * the names of its directories are in its shards then */
+	if( system_mtimes != NULL && gr_path_index_covers_system( self->scan_dirs, system_mtimes ) )
+	{
+		self->n_layers = PATH_INDEX_N_LAYERS;
+		for( i = 0; i < self->scan_dirs->len; ++i )
+		{
+			scan_dir = (GrPathScanDir*)g_ptr_array_index( self->scan_dirs, i );
+			if( scan_dir->status == GR_PATH_SCAN_STATUS_DONE && g_hash_table_contains( system_mtimes, scan_dir->path ) )
+			{
+				g_clear_pointer( &scan_dir->names, g_ptr_array_unref );
+				scan_dir->status = GR_PATH_SCAN_STATUS_UNCHANGED;
+			}
+		}
+	}
+
+	/* otherwise the modified directories are enumerated already, only the ones skipped as
+	 * unchanged are enumerated now */
+	gr_path_index_scan_unchanged( self, self->scan_dirs, self->n_layers > 1 ? system_mtimes : NULL );
+	if( system_mtimes != NULL )
+		g_hash_table_unref( system_mtimes );
+
+	/* collect names of all directories */
+	for( i = 0; i < self->scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( self->scan_dirs, i );
+		if( scan_dir->names == NULL )
+			continue;
+
+		g_ptr_array_extend_and_steal( names, g_steal_pointer( &scan_dir->names ) );
+	}
+
+	g_ptr_array_sort( names, gr_path_index_compare_names );
+	gr_path_index_build( self, names );
+	g_ptr_array_unref( names );
+	if( self->n_layers > 1 )
+		self->stamp = gr_completion_hash( self->stamp, &self->system_stamp, sizeof( self->system_stamp ) );
+
+	if( self->store_path != NULL )
+		gr_path_index_store( self, env_str );
+	g_free( dirs_str );
+}
+
+/* returns TRUE, if the head of the cursor starts with the len bytes of str; the name of a key is decoded */
+static gboolean
+gr_path_index_cursor_check(
+	GrPathIndexCursor *cursor,
+	const gchar *str,
+	gsize len,
+	gboolean keys )
+{
+	if( strncmp( cursor->iter.str, str, len ) != 0 )
+		return FALSE;
+
+	if( keys )
+		gr_front_coding_iter_init( &cursor->name_iter, cursor->shard->names, cursor->shard->key_names[cursor->iter.index] );
+
+	return TRUE;
+}
+
+/*
+ * Adds the completions of the names, or of the keys, starting with str among the shards, not
+ * more than limit if it is not 0. The heads of the shards are merged in the order of their
+ * strings, equal keys in the order of their names, so a name of several layers goes once.
+ */
+static void
+gr_path_index_merge_shards(
+	GrPathShard **shards,
+	guint n_shards,
+	const gchar *str,
+	gboolean keys,
+	guint limit,
+	GPtrArray *completions )
+{
+	GrPathIndexCursor cursors[PATH_INDEX_MAX_QUERY_SHARDS];
+	GrPathIndexCursor *cursor, *best;
+	const gchar *name, *last;
+	gsize len;
+	gint ret;
+	guint j;
+
+	len = strlen( str );
+	for( j = 0; j < n_shards; ++j )
+	{
+		cursor = &cursors[j];
+		cursor->shard = shards[j];
+		gr_front_coding_lower_bound( keys ? cursor->shard->keys : cursor->shard->names, str, len, &cursor->iter );
+		cursor->valid = gr_path_index_cursor_check( cursor, str, len, keys );
+	}
+
+	last = NULL;
+	while( limit == 0 || completions->len < limit )
+	{
+		best = NULL;
+		for( j = 0; j < n_shards; ++j )
+		{
+			cursor = &cursors[j];
+			if( !cursor->valid )
+				continue;
+
+			if( best == NULL )
+			{
+				best = cursor;
+				continue;
+			}
+
+			ret = strcmp( cursor->iter.str, best->iter.str );
+			if( ret == 0 && keys )
+				ret = strcmp( cursor->name_iter.str, best->name_iter.str );
+			if( ret < 0 )
+				best = cursor;
+		}
+		if( best == NULL )
+			break;
+
+		name = keys ? best->name_iter.str : best->iter.str;
+		if( last == NULL || strcmp( name, last ) != 0 )
+		{
+			g_ptr_array_add( completions, gr_completion_new( name, PATH_INDEX_SCORE ) );
+			last = ( (GrCompletion*)g_ptr_array_index( completions, completions->len - 1 ) )->text;
+		}
+		best->valid = gr_front_coding_iter_next( &best->iter ) && gr_path_index_cursor_check( best, str, len, keys );
+	}
+}
+
+static const gchar*
+gr_path_index_get_name(
+	GrCompletionProvider *provider )
+{
+	return "path";
+}
+
+static GPtrArray*
+gr_path_index_query(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	guint limit,
+	GCancellable *cancellable )
+{
+	GrPathIndex *self = GR_PATH_INDEX( provider );
+	GrPathShard *shards[PATH_INDEX_MAX_QUERY_SHARDS];
+	GPtrArray *completions;
+	gchar *key;
+	gboolean keys;
+	guint n_shards;
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	if( str == NULL || *str == '\0' )
+		return completions;
+
+	/* names starting with str follow the first name not less than str in the shards of its first byte */
+	key = NULL;
+	keys = g_atomic_int_get( &self->ignore_case );
+	if( keys )
+		str = key = gr_completion_fold( str );
+
+	n_shards = gr_path_index_get_query_shards( self, (guchar)str[0], keys, shards );
+	gr_path_index_merge_shards( shards, n_shards, str, keys, limit, completions );
+	g_free( key );
+
+	return completions;
+}
+
+static guint64
+gr_path_index_get_stamp(
+	GrCompletionProvider *provider )
+{
+	GrPathIndex *self = GR_PATH_INDEX( provider );
+	gint ignore_case;
+
+	/* the names are not changed after construction, a stored index keeps its stamp, the stamp of the system index is hashed in */
+	ignore_case = g_atomic_int_get( &self->ignore_case );
+
+	return gr_completion_hash( self->stamp, &ignore_case, sizeof( ignore_case ) );
+}
+
+/*
+ * A shard is mapped on its first lookup, the name is decoded into the lookup iterator of its
+ * layer. The name of the least key is looked up like a query by keys does, among the shards
+ * of the first byte and of non-ASCII names, its name is copied into the first iterator.
+ */
+static const gchar*
+gr_path_index_lookup(
+	GrCompletionProvider *provider,
+	const gchar *str,
+	gsize len,
+	gboolean folded,
+	gdouble *score )
+{
+	GrPathIndex *self = GR_PATH_INDEX( provider );
+	GrPathShard *shard, *shards[PATH_INDEX_MAX_QUERY_SHARDS];
+	GrPathIndexCursor cursors[PATH_INDEX_MAX_QUERY_SHARDS];
+	GrPathIndexCursor *cursor, *best_cursor;
+	GrFrontCodingIter *iter;
+	const gchar *best;
+	gint ret;
+	guint layer, j, n_shards;
+
+	if( len == 0 )
+		return NULL;
+
+	/* the least key of the shards, the least name among equal keys */
+	best = NULL;
+	if( folded )
+	{
+		best_cursor = NULL;
+		n_shards = gr_path_index_get_query_shards( self, (guchar)str[0], TRUE, shards );
+		for( j = 0; j < n_shards; ++j )
+		{
+			cursor = &cursors[j];
+			cursor->shard = shards[j];
+			gr_front_coding_lower_bound( cursor->shard->keys, str, len, &cursor->iter );
+			if( !gr_path_index_cursor_check( cursor, str, len, TRUE ) )
+				continue;
+
+			if( best_cursor != NULL )
+			{
+				ret = strcmp( cursor->iter.str, best_cursor->iter.str );
+				if( ret > 0 || ( ret == 0 && strcmp( cursor->name_iter.str, best_cursor->name_iter.str ) >= 0 ) )
+					continue;
+			}
+			best_cursor = cursor;
+		}
+
+		if( best_cursor != NULL )
+		{
+			self->lookup_iters[0] = best_cursor->name_iter;
+			best = self->lookup_iters[0].str;
+		}
+	}
+
+	/* the least name of the layers */
+	for( layer = 0; !folded && layer < self->n_layers; ++layer )
+	{
+		shard = gr_path_index_get_shard( self, layer, gr_path_shard_get_id( (guchar)str[0] ) );
+		iter = &self->lookup_iters[layer];
+		if( gr_front_coding_lower_bound( shard->names, str, len, iter ) == gr_front_coding_get_length( shard->names ) )
+			continue;
+
+		if( strncmp( iter->str, str, len ) == 0 && ( best == NULL || strcmp( iter->str, best ) < 0 ) )
+			best = iter->str;
+	}
+
+	if( best != NULL && score != NULL )
+		*score = PATH_INDEX_SCORE;
+
+	return best;
+}
+
+static void
+gr_path_index_completion_provider_init(
+	GrCompletionProviderInterface *iface )
+{
+	iface->get_name = gr_path_index_get_name;
+	iface->query = gr_path_index_query;
+	iface->get_stamp = gr_path_index_get_stamp;
+	iface->lookup = gr_path_index_lookup;
+}
+
+static void
+gr_path_index_init(
+	GrPathIndex *self )
+{
+	guint layer, id;
+
+	self->env_path = NULL;
+	self->dirs = NULL;
+	self->cache_path = NULL;
+	self->store_path = NULL;
+	self->system_path = NULL;
+	g_mutex_init( &self->mutex );
+	for( layer = 0; layer < PATH_INDEX_N_LAYERS; ++layer )
+	{
+		for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+			self->shards[layer][id] = NULL;
+		self->lookup_iters[layer].coding = NULL;
+		self->layer_sizes[layer].known = FALSE;
+	}
+	self->n_layers = 1;
+	self->system_stamp = 0;
+	self->scan_dirs = NULL;
+	self->stamp = 0;
+	self->stored = FALSE;
+	self->ignore_case = FALSE;
+}
+
+static void
+gr_path_index_constructed(
+	GObject *object )
+{
+	GrPathIndex *self = GR_PATH_INDEX( object );
+
+	gr_path_index_load_list( self );
+
+	G_OBJECT_CLASS( gr_path_index_parent_class )->constructed( object );
+}
+
+static void
+gr_path_index_finalize(
+	GObject *object )
+{
+	GrPathIndex *self = GR_PATH_INDEX( object );
+	guint layer, id;
+
+	g_free( self->env_path );
+	g_strfreev( self->dirs );
+	g_free( self->cache_path );
+	g_free( self->store_path );
+	g_free( self->system_path );
+	for( layer = 0; layer < PATH_INDEX_N_LAYERS; ++layer )
+		for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+			gr_path_shard_free( self->shards[layer][id] );
+	g_mutex_clear( &self->mutex );
+	if( self->scan_dirs != NULL )
+		g_ptr_array_unref( self->scan_dirs );
+
+	G_OBJECT_CLASS( gr_path_index_parent_class )->finalize( object );
+}
+
+static void
+gr_path_index_get_property(
+	GObject *object,
+	guint prop_id,
+	GValue *value,
+	GParamSpec *pspec )
+{
+	GrPathIndex *self = GR_PATH_INDEX( object );
+
+	switch( (GrPathIndexPropertyID)prop_id )
+	{
+		case PROP_ENV_PATH:
+			g_value_set_string( value, self->env_path );
+			break;
+		case PROP_DIRS:
+			g_value_set_boxed( value, self->dirs );
+			break;
+		case PROP_CACHE_PATH:
+			g_value_set_string( value, self->cache_path );
+			break;
+		case PROP_STORE_PATH:
+			g_value_set_string( value, self->store_path );
+			break;
+		case PROP_SYSTEM_PATH:
+			g_value_set_string( value, self->system_path );
+			break;
+		case PROP_IGNORE_CASE:
+			g_value_set_boolean( value, gr_path_index_get_ignore_case( self ) );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_path_index_set_property(
+	GObject *object,
+	guint prop_id,
+	const GValue *value,
+	GParamSpec *pspec )
+{
+	GrPathIndex *self = GR_PATH_INDEX( object );
+
+	switch( (GrPathIndexPropertyID)prop_id )
+	{
+		case PROP_ENV_PATH:
+			g_free( self->env_path );
+			self->env_path = g_value_dup_string( value );
+			break;
+		case PROP_DIRS:
+			g_strfreev( self->dirs );
+			self->dirs = g_value_dup_boxed( value );
+			break;
+		case PROP_CACHE_PATH:
+			g_free( self->cache_path );
+			self->cache_path = g_value_dup_string( value );
+			break;
+		case PROP_STORE_PATH:
+			g_free( self->store_path );
+			self->store_path = g_value_dup_string( value );
+			break;
+		case PROP_SYSTEM_PATH:
+			g_free( self->system_path );
+			self->system_path = g_value_dup_string( value );
+			break;
+		case PROP_IGNORE_CASE:
+			gr_path_index_set_ignore_case( self, g_value_get_boolean( value ) );
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID( object, prop_id, pspec );
+			break;
+	}
+}
+
+static void
+gr_path_index_class_init(
+	GrPathIndexClass *klass )
+{
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->constructed = gr_path_index_constructed;
+	object_class->finalize = gr_path_index_finalize;
+	object_class->get_property = gr_path_index_get_property;
+	object_class->set_property = gr_path_index_set_property;
+
+	object_props[PROP_ENV_PATH] = g_param_spec_string(
+		"env-path",
+		"Environment path",
+		"Name of the environment variable listing binary directories",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_DIRS] = g_param_spec_boxed(
+		"dirs",
+		"Directories",
+		"Binary directories indexed instead of the ones of the environment variable",
+		G_TYPE_STRV,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_CACHE_PATH] = g_param_spec_string(
+		"cache-path",
+		"Cache path",
+		"Path to the file storing directories timed out",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_STORE_PATH] = g_param_spec_string(
+		"store-path",
+		"Store path",
+		"Path to the directory storing the index, its parts are mapped on demand",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_SYSTEM_PATH] = g_param_spec_string(
+		"system-path",
+		"System path",
+		"Path to the directory storing the index of the system directories, used read-only",
+		NULL,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS );
+	object_props[PROP_IGNORE_CASE] = g_param_spec_boolean(
+		"ignore-case",
+		"Ignoring case",
+		"Match names regardless of case",
+		FALSE,
+		G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS );
+	g_object_class_install_properties( object_class, N_PROPS, object_props );
+}
+
+/*
+ * If store_path is not NULL, the index is stored there and loaded by parts on demand. If
+ * system_path is not NULL and the index stored there by gtkrun-indexer lists only unchanged
+ * directories of env_path, it is mapped read-only and only the other directories are scanned.
+ */
+GrPathIndex*
+gr_path_index_new(
+	const gchar *env_path,
+	const gchar *cache_path,
+	const gchar *store_path,
+	const gchar *system_path )
+{
+	return GR_PATH_INDEX( g_object_new( GR_TYPE_PATH_INDEX, "env-path", env_path, "cache-path", cache_path, "store-path", store_path, "system-path", system_path, NULL ) );
+}
+
+/* the index of dirs stored in store_path for all users, see gr_path_index_new() */
+GrPathIndex*
+gr_path_index_new_for_dirs(
+	const gchar* const *dirs,
+	const gchar *store_path )
+{
+	g_return_val_if_fail( dirs != NULL, NULL );
+	g_return_val_if_fail( store_path != NULL, NULL );
+
+	return GR_PATH_INDEX( g_object_new( GR_TYPE_PATH_INDEX, "dirs", dirs, "store-path", store_path, NULL ) );
+}
+
+/* returns TRUE, if the index is stored or it is loaded from the store up to date */
+gboolean
+gr_path_index_get_stored(
+	GrPathIndex *self )
+{
+	g_return_val_if_fail( GR_IS_PATH_INDEX( self ), FALSE );
+
+	return self->stored;
+}
+
+/*
+ * Adds the strings of the shard having a prefix within the edits of the automaton, the names or
+ * the keys. The sorted strings are the leaves of a trie: the rows of the prefix shared with the
+ * previous string are kept, and a subtree rejected by the automaton is skipped by the lower bound
+ * of the next byte, a binary search of the block heads and the decoding of one block. So only
+ * the blocks of the frontier of the automaton are decoded and touched, not the whole shard.
+ */
+static void
+gr_path_index_walk_fuzzy(
+	GrPathShard *shard,
+	gboolean keys,
+	GrLevenshtein *automaton,
+	GStringChunk *chunk,
+	GArray *matches )
+{
+	GrFrontCoding *coding;
+	GrFrontCodingIter iter, name_iter;
+	GrPathIndexMatch match;
+	gchar path[GR_FRONT_CODING_MAX_LENGTH + 1];
+	gboolean valid, alive;
+	guint depth, computed, distance;
+	gsize len;
+
+	coding = keys ? shard->keys : shard->names;
+
+	/* the rows of the automaton are of the computed bytes of path, all of them alive but the last one maybe */
+	computed = 0;
+	alive = TRUE;
+	valid = gr_front_coding_iter_init( &iter, coding, 0 );
+	while( valid )
+	{
+		for( depth = 0; depth < computed && path[depth] == iter.str[depth]; ++depth );
+		if( depth < computed )
+			alive = TRUE;
+		computed = depth;
+
+		len = strlen( iter.str );
+		while( alive && computed < len )
+		{
+			path[computed] = iter.str[computed];
+			alive = gr_levenshtein_step( automaton, iter.str, computed );
+			++computed;
+		}
+
+		/* a prefix is close enough, the strings of a rejected subtree match by it too */
+		distance = gr_levenshtein_get_distance( automaton, computed );
+		if( distance != G_MAXUINT )
+		{
+			match.distance = distance;
+			match.key = g_string_chunk_insert( chunk, iter.str );
+			match.name = match.key;
+			if( keys )
+			{
+				gr_front_coding_iter_init( &name_iter, shard->names, shard->key_names[iter.index] );
+				match.name = g_string_chunk_insert( chunk, name_iter.str );
+			}
+			g_array_append_val( matches, match );
+			valid = gr_front_coding_iter_next( &iter );
+			continue;
+		}
+
+		if( alive || (guchar)path[computed - 1] == G_MAXUINT8 )
+		{
+			valid = gr_front_coding_iter_next( &iter );
+			continue;
+		}
+
+		/* the first string after the rejected subtree starts with the next byte */
+		++path[computed - 1];
+		valid = gr_front_coding_lower_bound( coding, path, computed, &iter ) < gr_front_coding_get_length( coding );
+		--path[computed - 1];
+	}
+}
+
+/*
+ * Returns the array of GrCompletion: the names having a prefix within max_distance edits
+ * from str, the closest first, but not more than limit if it is not 0. The first character
+ * may be mistyped too, so all the shards are walked, but only the blocks the automaton does
+ * not reject are decoded, which keeps the pages of a mapped shard untouched.
+ */
+GPtrArray*
+gr_path_index_query_fuzzy(
+	GrPathIndex *self,
+	const gchar *str,
+	guint max_distance,
+	guint limit )
+{
+	GrLevenshtein *automaton;
+	GStringChunk *chunk;
+	GPtrArray *completions;
+	GArray *matches;
+	gboolean ignore_case;
+	const gchar *name, *last;
+	gchar *key;
+	guint i, layer, id;
+
+	g_return_val_if_fail( GR_IS_PATH_INDEX( self ), NULL );
+
+	completions = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_completion_free );
+	if( str == NULL || *str == '\0' )
+		return completions;
+
+	key = NULL;
+	ignore_case = g_atomic_int_get( &self->ignore_case );
+	if( ignore_case )
+		str = key = gr_completion_fold( str );
+
+	automaton = gr_levenshtein_new( str, max_distance );
+	chunk = g_string_chunk_new( 4096 );
+	matches = g_array_new( FALSE, FALSE, sizeof( GrPathIndexMatch ) );
+	for( layer = 0; layer < self->n_layers; ++layer )
+		for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+			gr_path_index_walk_fuzzy( gr_path_index_get_shard( self, layer, id ), ignore_case, automaton, chunk, matches );
+	gr_levenshtein_free( automaton );
+	g_free( key );
+
+	/* a name of several layers is matched once per layer, the matches are adjacent */
+	g_array_sort( matches, gr_path_index_compare_matches );
+	last = NULL;
+	for( i = 0; i < matches->len && ( limit == 0 || completions->len < limit ); ++i )
+	{
+		name = g_array_index( matches, GrPathIndexMatch, i ).name;
+		if( last == NULL || strcmp( name, last ) != 0 )
+			g_ptr_array_add( completions, gr_completion_new( name, PATH_INDEX_SCORE ) );
+		last = name;
+	}
+	g_array_unref( matches );
+	g_string_chunk_free( chunk );
+
+	return completions;
+}
+
+gboolean
+gr_path_index_get_ignore_case(
+	GrPathIndex *self )
+{
+	g_return_val_if_fail( GR_IS_PATH_INDEX( self ), FALSE );
+
+	return g_atomic_int_get( &self->ignore_case );
+}
+
+void
+gr_path_index_set_ignore_case(
+	GrPathIndex *self,
+	gboolean ignore_case )
+{
+	g_return_if_fail( GR_IS_PATH_INDEX( self ) );
+
+	/* read by the query threads */
+	g_atomic_int_set( &self->ignore_case, ignore_case ? TRUE : FALSE );
+
+	g_object_notify_by_pspec( G_OBJECT( self ), object_props[PROP_IGNORE_CASE] );
+}
+
+/*
+ * Returns a{sv}: the number of names and the bytes of the loaded shards of both layers, a
+ * stored shard is counted when it is mapped, whether the system index is used, and the time
+ * and the number of names of every directory.
+ */
+GVariant*
+gr_path_index_get_stats(
+	GrPathIndex *self )
+{
+	GVariantBuilder builder, dirs_builder, dir_builder;
+	GrPathShard *shard;
+	GrPathScanDir *scan_dir;
+	GrPathIndexLayerSize *layer_size;
+	gchar *path;
+	guint64 bytes, mapped_bytes, size;
+	guint i, layer, id, n_names, n_shards, n_mapped;
+
+	g_return_val_if_fail( GR_IS_PATH_INDEX( self ), NULL );
+
+	/* the shards of a stored layer are mapped on demand, its size is read from its manifest */
+	bytes = sizeof( GrPathIndex );
+	mapped_bytes = sizeof( GrPathIndex );
+	n_names = 0;
+	n_shards = 0;
+	n_mapped = 0;
+	for( layer = 0; layer < self->n_layers; ++layer )
+	{
+		layer_size = &self->layer_sizes[layer];
+		for( id = 0; id < GR_PATH_SHARD_N_IDS; ++id )
+		{
+			shard = (GrPathShard*)g_atomic_pointer_get( &self->shards[layer][id] );
+			if( shard == NULL )
+				continue;
+
+			size = sizeof( GrPathShard ) + g_bytes_get_size( shard->bytes );
+			mapped_bytes += size;
+			++n_mapped;
+			if( !layer_size->known )
+			{
+				bytes += size;
+				n_names += gr_front_coding_get_length( shard->names );
+				++n_shards;
+			}
+		}
+
+		if( layer_size->known )
+		{
+			bytes += layer_size->bytes;
+			n_names += layer_size->n_names;
+			n_shards += layer_size->n_shards;
+		}
+	}
+
+	g_variant_builder_init( &dirs_builder, G_VARIANT_TYPE( "aa{sv}" ) );
+	for( i = 0; self->scan_dirs != NULL && i < self->scan_dirs->len; ++i )
+	{
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( self->scan_dirs, i );
+		path = g_filename_display_name( scan_dir->path );
+
+		g_variant_builder_init( &dir_builder, G_VARIANT_TYPE_VARDICT );
+		g_variant_builder_add( &dir_builder, "{sv}", "path", g_variant_new_take_string( path ) );
+		g_variant_builder_add( &dir_builder, "{sv}", "status", g_variant_new_string( gr_path_scan_status_to_string( scan_dir->status ) ) );
+		g_variant_builder_add( &dir_builder, "{sv}", "entries", g_variant_new_uint32( scan_dir->n_names ) );
+		g_variant_builder_add( &dir_builder, "{sv}", "time", g_variant_new_int64( scan_dir->elapsed ) );
+		g_variant_builder_add_value( &dirs_builder, g_variant_builder_end( &dir_builder ) );
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( n_names ) );
+	g_variant_builder_add( &builder, "{sv}", "shards", g_variant_new_uint32( n_shards ) );
+	g_variant_builder_add( &builder, "{sv}", "system", g_variant_new_boolean( self->n_layers > 1 ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+	g_variant_builder_add( &builder, "{sv}", "mapped-shards", g_variant_new_uint32( n_mapped ) );
+	g_variant_builder_add( &builder, "{sv}", "mapped-bytes", g_variant_new_uint64( mapped_bytes ) );
+	g_variant_builder_add( &builder, "{sv}", "directories", g_variant_builder_end( &dirs_builder ) );
+
+	return g_variant_builder_end( &builder );
+}
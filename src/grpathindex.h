@@ -0,0 +1,23 @@
+#ifndef GRPATHINDEX_H
+#define GRPATHINDEX_H
+
+#include <glib-object.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GR_TYPE_PATH_INDEX ( gr_path_index_get_type() )
+G_DECLARE_FINAL_TYPE( GrPathIndex, gr_path_index, GR, PATH_INDEX, GObject )
+
+GrPathIndex* gr_path_index_new( const gchar *env_path, const gchar *cache_path, const gchar *store_path, const gchar *system_path );
+GrPathIndex* gr_path_index_new_for_dirs( const gchar* const *dirs, const gchar *store_path );
+gboolean gr_path_index_get_stored( GrPathIndex *self );
+GPtrArray* gr_path_index_query_fuzzy( GrPathIndex *self, const gchar *str, guint max_distance, guint limit );
+gboolean gr_path_index_get_ignore_case( GrPathIndex *self );
+void gr_path_index_set_ignore_case( GrPathIndex *self, gboolean ignore_case );
+GVariant* gr_path_index_get_stats( GrPathIndex *self );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,326 @@
+#include "grpathscan.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+/* a directory is enumerated in its own thread, so a hung mount cannot block the caller:
+ * the caller waits until the deadline and abandons the job, the thread frees it later */
+struct _GrPathScanJob
+{
+	gint ref_count;
+
+	GMutex mutex;
+	GCond cond;
+	gboolean done;
+
+	gchar *path;
+	gint64 known_mtime; /* the directory is not enumerated if it is not modified since */
+	GCancellable *cancellable;
+
+	gboolean failed;
+	gboolean unchanged;
+	gint64 elapsed;
+	gint64 mtime;
+	GPtrArray *names;
+};
+typedef struct _GrPathScanJob GrPathScanJob;
+
+static GrPathScanJob*
+gr_path_scan_job_new(
+	const gchar *path,
+	gint64 known_mtime )
+{
+	GrPathScanJob *job;
+
+	job = g_new( GrPathScanJob, 1 );
+	job->ref_count = 1;
+	g_mutex_init( &job->mutex );
+	g_cond_init( &job->cond );
+	job->done = FALSE;
+	job->path = g_strdup( path );
+	job->known_mtime = known_mtime;
+	job->cancellable = g_cancellable_new();
+	job->failed = FALSE;
+	job->unchanged = FALSE;
+	job->elapsed = 0;
+	job->mtime = -1;
+	job->names = NULL;
+
+	return job;
+}
+
+static GrPathScanJob*
+gr_path_scan_job_ref(
+	GrPathScanJob *job )
+{
+	g_atomic_int_inc( &job->ref_count );
+
+	return job;
+}
+
+static void
+gr_path_scan_job_unref(
+	GrPathScanJob *job )
+{
+	if( !g_atomic_int_dec_and_test( &job->ref_count ) )
+		return;
+
+	g_mutex_clear( &job->mutex );
+	g_cond_clear( &job->cond );
+	g_free( job->path );
+	g_object_unref( G_OBJECT( job->cancellable ) );
+	if( job->names != NULL )
+		g_ptr_array_unref( job->names );
+	g_free( job );
+}
+
+static gpointer
+gr_path_scan_job_run(
+	gpointer data )
+{
+	GrPathScanJob *job = (GrPathScanJob*)data;
+	GFile *dir;
+	GFileEnumerator *dir_enum;
+	GFileInfo *file_info;
+	GPtrArray *names;
+	gboolean unchanged;
+	gint64 start, mtime;
+
+	start = g_get_monotonic_time();
+	names = g_ptr_array_new_with_free_func( (GDestroyNotify)g_free );
+
+	dir = g_file_new_for_path( job->path );
+
+	/* the modification time is read first, the entries added later change it */
+	mtime = -1;
+	file_info = g_file_query_info( dir, G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, G_FILE_QUERY_INFO_NONE, job->cancellable, NULL );
+	if( file_info != NULL )
+	{
+		mtime = (gint64)g_file_info_get_attribute_uint64( file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED ) * G_USEC_PER_SEC +
+			g_file_info_get_attribute_uint32( file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC );
+		g_object_unref( G_OBJECT( file_info ) );
+	}
+	unchanged = mtime >= 0 && mtime == job->known_mtime;
+
+	dir_enum = NULL;
+	if( !unchanged )
+		dir_enum = g_file_enumerate_children( dir, G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME, G_FILE_QUERY_INFO_NONE, job->cancellable, NULL );
+	if( dir_enum != NULL )
+	{
+		while( TRUE )
+		{
+			if( !g_file_enumerator_iterate( dir_enum, &file_info, NULL, job->cancellable, NULL ) )
+				break;
+
+			if( file_info == NULL )
+				break;
+
+			g_ptr_array_add( names, g_strdup( g_file_info_get_display_name( file_info ) ) );
+		}
+		g_object_unref( G_OBJECT( dir_enum ) );
+	}
+	g_object_unref( G_OBJECT( dir ) );
+
+	g_mutex_lock( &job->mutex );
+	job->failed = !unchanged && dir_enum == NULL;
+	job->unchanged = unchanged;
+	job->elapsed = g_get_monotonic_time() - start;
+	job->mtime = mtime;
+	job->names = names;
+	job->done = TRUE;
+	g_cond_signal( &job->cond );
+	g_mutex_unlock( &job->mutex );
+
+	gr_path_scan_job_unref( job );
+
+	return NULL;
+}
+
+static void
+gr_path_scan_store_cache(
+	GKeyFile *key_file,
+	const gchar *cache_path )
+{
+	gchar *dir_path;
+
+	dir_path = g_path_get_dirname( cache_path );
+	g_mkdir_with_parents( dir_path, 0700 );
+	g_free( dir_path );
+
+	g_key_file_save_to_file( key_file, cache_path, NULL );
+}
+
+/*
+ * Enumerate directories concurrently, waiting at most timeout microseconds for them.
+ * The directories timed out are stored in the negative cache at cache_path
+ * and skipped for cache_ttl seconds. A directory found in known_mtimes (path to gint64)
+ * with the same modification time is not enumerated. Returns the array of GrPathScanDir.
+ */
+GPtrArray*
+gr_path_scan(
+	const gchar* const *dirs,
+	gint64 timeout,
+	gint64 cache_ttl,
+	const gchar *cache_path,
+	GHashTable *known_mtimes )
+{
+	GKeyFile *key_file;
+	gboolean cache_changed;
+	GPtrArray *scan_dirs, *jobs;
+	GrPathScanDir *scan_dir;
+	GrPathScanJob *job;
+	GThread *thread;
+	const gchar* const *d;
+	const gint64 *known_mtime;
+	gint64 now, time, deadline;
+	guint i;
+
+	g_return_val_if_fail( dirs != NULL, NULL );
+
+	now = g_get_real_time() / G_USEC_PER_SEC;
+	key_file = g_key_file_new();
+	if( cache_path != NULL )
+		g_key_file_load_from_file( key_file, cache_path, G_KEY_FILE_NONE, NULL );
+	cache_changed = FALSE;
+
+	/* start jobs */
+	scan_dirs = g_ptr_array_new_with_free_func( (GDestroyNotify)gr_path_scan_dir_free );
+	jobs = g_ptr_array_new();
+	for( d = dirs; *d != NULL; ++d )
+	{
+		/* ignore empty and repeated directories */
+		if( **d == '\0' )
+			continue;
+		for( i = 0; i < scan_dirs->len; ++i )
+			if( g_strcmp0( ( (GrPathScanDir*)g_ptr_array_index( scan_dirs, i ) )->path, *d ) == 0 )
+				break;
+		if( i < scan_dirs->len )
+			continue;
+
+		scan_dir = g_new( GrPathScanDir, 1 );
+		scan_dir->path = g_strdup( *d );
+		scan_dir->status = GR_PATH_SCAN_STATUS_SKIPPED;
+		scan_dir->elapsed = 0;
+		scan_dir->mtime = -1;
+		scan_dir->names = NULL;
+		scan_dir->n_names = 0;
+		g_ptr_array_add( scan_dirs, scan_dir );
+
+		/* the directory was slow recently, do not wait for it again */
+		if( g_key_file_has_group( key_file, *d ) )
+		{
+			time = g_key_file_get_int64( key_file, *d, "time", NULL );
+			if( now - time < cache_ttl )
+			{
+				g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+					"MESSAGE", "Skipping %s: timed out recently", *d,
+					NULL );
+				g_ptr_array_add( jobs, NULL );
+				continue;
+			}
+		}
+
+		known_mtime = known_mtimes != NULL ? (const gint64*)g_hash_table_lookup( known_mtimes, *d ) : NULL;
+		job = gr_path_scan_job_new( *d, known_mtime != NULL ? *known_mtime : -1 );
+		g_ptr_array_add( jobs, job );
+
+		/* if no thread available, enumerate the directory right now */
+		thread = g_thread_try_new( "path-scan", gr_path_scan_job_run, gr_path_scan_job_ref( job ), NULL );
+		if( thread == NULL )
+			gr_path_scan_job_run( job );
+		else
+			g_thread_unref( thread );
+	}
+
+	/* collect results */
+	deadline = g_get_monotonic_time() + timeout;
+	for( i = 0; i < jobs->len; ++i )
+	{
+		job = (GrPathScanJob*)g_ptr_array_index( jobs, i );
+		if( job == NULL )
+			continue;
+		scan_dir = (GrPathScanDir*)g_ptr_array_index( scan_dirs, i );
+
+		g_mutex_lock( &job->mutex );
+		while( !job->done && g_cond_wait_until( &job->cond, &job->mutex, deadline ) );
+		if( job->done )
+		{
+			if( job->unchanged )
+				scan_dir->status = GR_PATH_SCAN_STATUS_UNCHANGED;
+			else
+				scan_dir->status = job->failed ? GR_PATH_SCAN_STATUS_FAILED : GR_PATH_SCAN_STATUS_DONE;
+			scan_dir->elapsed = job->elapsed;
+			scan_dir->mtime = job->mtime;
+			if( scan_dir->status == GR_PATH_SCAN_STATUS_DONE )
+			{
+				scan_dir->names = job->names;
+				scan_dir->n_names = job->names->len;
+				job->names = NULL;
+			}
+		}
+		else
+		{
+			scan_dir->status = GR_PATH_SCAN_STATUS_TIMED_OUT;
+			scan_dir->elapsed = timeout;
+			g_cancellable_cancel( job->cancellable );
+		}
+		g_mutex_unlock( &job->mutex );
+		gr_path_scan_job_unref( job );
+
+		/* remember timed out directories, forget the ones responding again */
+		if( scan_dir->status == GR_PATH_SCAN_STATUS_TIMED_OUT )
+		{
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+				"MESSAGE", "Skipping %s: timed out", scan_dir->path,
+				NULL );
+			g_key_file_set_int64( key_file, scan_dir->path, "time", now );
+			cache_changed = TRUE;
+		}
+		else if( g_key_file_has_group( key_file, scan_dir->path ) )
+		{
+			g_key_file_remove_group( key_file, scan_dir->path, NULL );
+			cache_changed = TRUE;
+		}
+	}
+	g_ptr_array_unref( jobs );
+
+	if( cache_changed && cache_path != NULL )
+		gr_path_scan_store_cache( key_file, cache_path );
+	g_key_file_free( key_file );
+
+	return scan_dirs;
+}
+
+void
+gr_path_scan_dir_free(
+	GrPathScanDir *dir )
+{
+	if( dir == NULL )
+		return;
+
+	g_free( dir->path );
+	if( dir->names != NULL )
+		g_ptr_array_unref( dir->names );
+	g_free( dir );
+}
+
+const gchar*
+gr_path_scan_status_to_string(
+	GrPathScanStatus status )
+{
+	switch( status )
+	{
+		case GR_PATH_SCAN_STATUS_DONE:
+			return "done";
+		case GR_PATH_SCAN_STATUS_FAILED:
+			return "failed";
+		case GR_PATH_SCAN_STATUS_TIMED_OUT:
+			return "timed out";
+		case GR_PATH_SCAN_STATUS_SKIPPED:
+			return "skipped";
+		case GR_PATH_SCAN_STATUS_UNCHANGED:
+			return "unchanged";
+	}
+
+	return NULL;
+}
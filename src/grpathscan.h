@@ -0,0 +1,35 @@
+#ifndef GRPATHSCAN_H
+#define GRPATHSCAN_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+enum _GrPathScanStatus
+{
+	GR_PATH_SCAN_STATUS_DONE,
+	GR_PATH_SCAN_STATUS_FAILED,
+	GR_PATH_SCAN_STATUS_TIMED_OUT,
+	GR_PATH_SCAN_STATUS_SKIPPED,
+	GR_PATH_SCAN_STATUS_UNCHANGED
+};
+typedef enum _GrPathScanStatus GrPathScanStatus;
+
+struct _GrPathScanDir
+{
+	gchar *path;
+	GrPathScanStatus status;
+	gint64 elapsed; /* microseconds */
+	gint64 mtime; /* microseconds since the epoch, -1 if unknown */
+	GPtrArray *names; /* NULL, if status is not GR_PATH_SCAN_STATUS_DONE */
+	guint n_names; /* kept, when the names are taken */
+};
+typedef struct _GrPathScanDir GrPathScanDir;
+
+GPtrArray* gr_path_scan( const gchar* const *dirs, gint64 timeout, gint64 cache_ttl, const gchar *cache_path, GHashTable *known_mtimes );
+void gr_path_scan_dir_free( GrPathScanDir *dir );
+const gchar* gr_path_scan_status_to_string( GrPathScanStatus status );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,211 @@
+#include "grpathshard.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* the header is the version and the sizes of the encoded names and keys */
+#define PATH_SHARD_HEADER_SIZE ( 3 * sizeof( guint32 ) )
+
+static gint
+gr_path_shard_compare_keys(
+	gconstpointer a,
+	gconstpointer b,
+	gpointer user_data )
+{
+	const gchar* const *keys = (const gchar* const*)user_data;
+	guint32 x = *(const guint32*)a;
+	guint32 y = *(const guint32*)b;
+	gint ret;
+
+	/* the names are sorted, so equal keys go in the order of their names */
+	ret = strcmp( keys[x], keys[y] );
+	if( ret != 0 )
+		return ret;
+
+	return x < y ? -1 : ( x > y ? 1 : 0 );
+}
+
+/*
+ * Returns the shard of the sorted names, keys are their keys in the same order. The names
+ * and the keys are front coded, the keys are followed by the indexes of their names. NULL,
+ * if a name or a key is longer than GR_FRONT_CODING_MAX_LENGTH bytes.
+ */
+GBytes*
+gr_path_shard_encode(
+	const gchar* const *names,
+	const gchar* const *keys,
+	guint n_names )
+{
+	GArray *order;
+	GPtrArray *sorted_keys;
+	GBytes *names_bytes, *keys_bytes;
+	GByteArray *arr;
+	gconstpointer data;
+	guint32 header[3], i;
+	gsize size;
+
+	/* the keys are matched in their own order */
+	order = g_array_sized_new( FALSE, FALSE, sizeof( guint32 ), n_names );
+	for( i = 0; i < n_names; ++i )
+		g_array_append_val( order, i );
+	g_array_sort_with_data( order, gr_path_shard_compare_keys, (gpointer)keys );
+
+	sorted_keys = g_ptr_array_sized_new( n_names );
+	for( i = 0; i < n_names; ++i )
+		g_ptr_array_add( sorted_keys, (gpointer)keys[g_array_index( order, guint32, i )] );
+
+	names_bytes = gr_front_coding_encode( names, n_names );
+	keys_bytes = gr_front_coding_encode( (const gchar* const*)sorted_keys->pdata, n_names );
+	g_ptr_array_unref( sorted_keys );
+	if( names_bytes == NULL || keys_bytes == NULL )
+	{
+		if( names_bytes != NULL )
+			g_bytes_unref( names_bytes );
+		if( keys_bytes != NULL )
+			g_bytes_unref( keys_bytes );
+		g_array_unref( order );
+		return NULL;
+	}
+
+	header[0] = GR_PATH_SHARD_VERSION;
+	header[1] = (guint32)g_bytes_get_size( names_bytes );
+	header[2] = (guint32)g_bytes_get_size( keys_bytes );
+
+	arr = g_byte_array_new();
+	g_byte_array_append( arr, (const guint8*)header, sizeof( header ) );
+	data = g_bytes_get_data( names_bytes, &size );
+	g_byte_array_append( arr, (const guint8*)data, (guint)size );
+	data = g_bytes_get_data( keys_bytes, &size );
+	g_byte_array_append( arr, (const guint8*)data, (guint)size );
+	g_byte_array_append( arr, (const guint8*)order->data, order->len * sizeof( guint32 ) );
+
+	g_bytes_unref( names_bytes );
+	g_bytes_unref( keys_bytes );
+	g_array_unref( order );
+
+	return g_byte_array_free_to_bytes( arr );
+}
+
+/*
+ * Returns the shard encoded in bytes by gr_path_shard_encode(), NULL if it is malformed or
+ * of another version. Empty bytes have no names. The shard takes the reference to bytes.
+ */
+GrPathShard*
+gr_path_shard_new(
+	GBytes *bytes )
+{
+	GrPathShard *shard;
+	const guint32 *header;
+	const guchar *data;
+	gsize size, names_size, keys_size;
+	guint i, n_names;
+
+	g_return_val_if_fail( bytes != NULL, NULL );
+
+	shard = g_new( GrPathShard, 1 );
+	shard->bytes = bytes;
+	shard->names = NULL;
+	shard->keys = NULL;
+	shard->key_names = NULL;
+
+	data = (const guchar*)g_bytes_get_data( bytes, &size );
+	if( size == 0 )
+	{
+		shard->names = gr_front_coding_new( g_bytes_new_static( "", 0 ) );
+		shard->keys = gr_front_coding_new( g_bytes_new_static( "", 0 ) );
+		return shard;
+	}
+
+	if( size < PATH_SHARD_HEADER_SIZE || (guintptr)data % sizeof( guint32 ) != 0 )
+		goto malformed;
+
+	header = (const guint32*)data;
+	names_size = header[1];
+	keys_size = header[2];
+	if( header[0] != GR_PATH_SHARD_VERSION ||
+		names_size % sizeof( guint32 ) != 0 || keys_size % sizeof( guint32 ) != 0 ||
+		names_size > size - PATH_SHARD_HEADER_SIZE || keys_size > size - PATH_SHARD_HEADER_SIZE - names_size )
+		goto malformed;
+
+	/* the encoded names and keys share the bytes */
+	shard->names = gr_front_coding_new( g_bytes_new_from_bytes( bytes, PATH_SHARD_HEADER_SIZE, names_size ) );
+	shard->keys = gr_front_coding_new( g_bytes_new_from_bytes( bytes, PATH_SHARD_HEADER_SIZE + names_size, keys_size ) );
+	if( shard->names == NULL || shard->keys == NULL )
+		goto malformed;
+
+	/* every key must have a name */
+	n_names = gr_front_coding_get_length( shard->names );
+	if( gr_front_coding_get_length( shard->keys ) != n_names ||
+		size - PATH_SHARD_HEADER_SIZE - names_size - keys_size != (gsize)n_names * sizeof( guint32 ) )
+		goto malformed;
+
+	shard->key_names = (const guint32*)( data + PATH_SHARD_HEADER_SIZE + names_size + keys_size );
+	for( i = 0; i < n_names; ++i )
+		if( shard->key_names[i] >= n_names )
+			goto malformed;
+
+	return shard;
+
+malformed:
+	gr_path_shard_free( shard );
+	return NULL;
+}
+
+/* the file is mapped, so only the pages touched by queries are read; a missing or malformed file is empty */
+GrPathShard*
+gr_path_shard_new_from_file(
+	const gchar *path )
+{
+	GrPathShard *shard;
+	GMappedFile *file;
+	GBytes *bytes;
+	GError *error = NULL;
+
+	g_return_val_if_fail( path != NULL, NULL );
+
+	file = g_mapped_file_new( path, FALSE, &error );
+	if( file == NULL )
+	{
+		if( !g_error_matches( error, G_FILE_ERROR, G_FILE_ERROR_NOENT ) )
+			g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+				"MESSAGE", "Failed to map %s: %s", path, error->message,
+				NULL );
+		g_error_free( error );
+		return gr_path_shard_new( g_bytes_new_static( "", 0 ) );
+	}
+
+	bytes = g_mapped_file_get_bytes( file );
+	g_mapped_file_unref( file );
+
+	shard = gr_path_shard_new( bytes );
+	if( shard == NULL )
+	{
+		g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+			"MESSAGE", "Malformed index file %s", path,
+			NULL );
+		return gr_path_shard_new( g_bytes_new_static( "", 0 ) );
+	}
+
+	return shard;
+}
+
+void
+gr_path_shard_free(
+	GrPathShard *shard )
+{
+	if( shard == NULL )
+		return;
+
+	gr_front_coding_free( shard->names );
+	gr_front_coding_free( shard->keys );
+	g_bytes_unref( shard->bytes );
+	g_free( shard );
+}
+
+/* ASCII bytes regardless of case have their own shards, all the other bytes share the last one */
+guint
+gr_path_shard_get_id(
+	guchar c )
+{
+	return c < 0x80 ? (guint)g_ascii_tolower( c ) : GR_PATH_SHARD_ID_OTHER;
+}
@@ -0,0 +1,35 @@
+#ifndef GRPATHSHARD_H
+#define GRPATHSHARD_H
+
+#include "grfrontcoding.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* the names of the binaries starting with the same byte */
+struct _GrPathShard
+{
+	GBytes *bytes;
+	GrFrontCoding *names; /* sorted */
+	GrFrontCoding *keys; /* sorted */
+	const guint32 *key_names; /* the index of the name of every key */
+};
+typedef struct _GrPathShard GrPathShard;
+
+/* the shard of the names starting with a non-ASCII byte */
+#define GR_PATH_SHARD_ID_OTHER 0x80
+#define GR_PATH_SHARD_N_IDS ( GR_PATH_SHARD_ID_OTHER + 1 )
+
+/* changed with the format of the stored shards */
+#define GR_PATH_SHARD_VERSION 2
+
+GBytes* gr_path_shard_encode( const gchar* const *names, const gchar* const *keys, guint n_names );
+GrPathShard* gr_path_shard_new( GBytes *bytes );
+GrPathShard* gr_path_shard_new_from_file( const gchar *path );
+void gr_path_shard_free( GrPathShard *shard );
+guint gr_path_shard_get_id( guchar c );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,485 @@
+#include "grquerycache.h"
+
+#include "grcompletionprovider.h"
+#include "grstats.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define QUERY_GROUP_PREFIX "Query "
+
+/* the completions of a query by every provider, each of them valid for its own stamp */
+struct _GrQueryCacheEntry
+{
+	gchar *str;
+	guint limit;
+	guint64 *stamps; /* 0 if no completions of the provider are stored */
+	GPtrArray **results;
+	GList link; /* in the queue of entries */
+};
+
+/* the cache is used by the main thread only */
+struct _GrQueryCache
+{
+	guint size;
+	GStrv provider_names;
+	guint n_providers;
+
+	GHashTable *entries; /* the set of entries by their str and limit */
+	GQueue queue; /* the most recently used first */
+
+	/* the entries are changed since the cache was loaded */
+	gboolean changed;
+};
+
+static guint
+gr_query_cache_entry_hash(
+	gconstpointer key )
+{
+	const GrQueryCacheEntry *entry = (const GrQueryCacheEntry*)key;
+
+	return g_str_hash( entry->str ) ^ entry->limit;
+}
+
+static gboolean
+gr_query_cache_entry_equal(
+	gconstpointer a,
+	gconstpointer b )
+{
+	const GrQueryCacheEntry *entry_a = (const GrQueryCacheEntry*)a;
+	const GrQueryCacheEntry *entry_b = (const GrQueryCacheEntry*)b;
+
+	return entry_a->limit == entry_b->limit && g_str_equal( entry_a->str, entry_b->str );
+}
+
+static GrQueryCacheEntry*
+gr_query_cache_entry_new(
+	GrQueryCache *self,
+	const gchar *str,
+	guint limit )
+{
+	GrQueryCacheEntry *entry;
+
+	entry = g_new( GrQueryCacheEntry, 1 );
+	entry->str = g_strdup( str );
+	entry->limit = limit;
+	entry->stamps = g_new0( guint64, self->n_providers );
+	entry->results = g_new0( GPtrArray*, self->n_providers );
+	entry->link.data = entry;
+	entry->link.next = NULL;
+	entry->link.prev = NULL;
+
+	return entry;
+}
+
+static void
+gr_query_cache_entry_free(
+	GrQueryCache *self,
+	GrQueryCacheEntry *entry )
+{
+	guint i;
+
+	for( i = 0; i < self->n_providers; ++i )
+		if( entry->results[i] != NULL )
+			g_ptr_array_unref( entry->results[i] );
+
+	g_free( entry->str );
+	g_free( entry->stamps );
+	g_free( entry->results );
+	g_free( entry );
+}
+
+static gboolean
+gr_query_cache_entry_is_empty(
+	GrQueryCache *self,
+	GrQueryCacheEntry *entry )
+{
+	guint i;
+
+	for( i = 0; i < self->n_providers; ++i )
+		if( entry->stamps[i] != 0 )
+			return FALSE;
+
+	return TRUE;
+}
+
+static GPtrArray*
+gr_query_cache_copy_completions(
+	GPtrArray *completions )
+{
+	GPtrArray *copy;
+	guint i;
+
+	copy = g_ptr_array_new_full( completions->len, (GDestroyNotify)gr_completion_free );
+	for( i = 0; i < completions->len; ++i )
+		g_ptr_array_add( copy, gr_completion_copy( (const GrCompletion*)g_ptr_array_index( completions, i ) ) );
+
+	return copy;
+}
+
+/* add the entry as the least recently used one, if the cache is not full */
+static gboolean
+gr_query_cache_append(
+	GrQueryCache *self,
+	GrQueryCacheEntry *entry )
+{
+	if( self->queue.length >= self->size || g_hash_table_contains( self->entries, entry ) )
+		return FALSE;
+
+	g_hash_table_add( self->entries, entry );
+	g_queue_push_tail_link( &self->queue, &entry->link );
+
+	return TRUE;
+}
+
+static void
+gr_query_cache_load_results(
+	GrQueryCache *self,
+	GKeyFile *key_file,
+	const gchar *group,
+	GrQueryCacheEntry *entry,
+	guint provider )
+{
+	const gchar *name = self->provider_names[provider];
+	GPtrArray *completions;
+	GStrv texts = NULL;
+	gdouble *scores = NULL;
+	gchar *key;
+	gsize n_texts = 0, n_scores = 0, i;
+	guint64 stamp;
+	GError *error = NULL;
+
+	key = g_strconcat( name, "-stamp", NULL );
+	stamp = g_key_file_get_uint64( key_file, group, key, &error );
+	g_free( key );
+
+	if( error == NULL )
+	{
+		key = g_strconcat( name, "-texts", NULL );
+		texts = g_key_file_get_string_list( key_file, group, key, &n_texts, &error );
+		g_free( key );
+	}
+
+	/* an empty list of doubles is NULL */
+	if( error == NULL )
+	{
+		key = g_strconcat( name, "-scores", NULL );
+		scores = g_key_file_get_double_list( key_file, group, key, &n_scores, &error );
+		g_free( key );
+	}
+
+	if( error == NULL && stamp != 0 && n_texts == n_scores )
+	{
+		completions = g_ptr_array_new_full( (guint)n_texts, (GDestroyNotify)gr_completion_free );
+		for( i = 0; i < n_texts; ++i )
+			g_ptr_array_add( completions, gr_completion_new( texts[i], scores[i] ) );
+
+		entry->stamps[provider] = stamp;
+		entry->results[provider] = completions;
+	}
+
+	g_clear_error( &error );
+	g_strfreev( texts );
+	g_free( scores );
+}
+
+static void
+gr_query_cache_save_results(
+	GrQueryCache *self,
+	GKeyFile *key_file,
+	const gchar *group,
+	GrQueryCacheEntry *entry,
+	guint provider )
+{
+	const gchar *name = self->provider_names[provider];
+	GPtrArray *completions = entry->results[provider];
+	const gchar **texts;
+	gdouble *scores;
+	gchar *key;
+	guint i;
+
+	texts = g_new( const gchar*, completions->len + 1 );
+	scores = g_new( gdouble, completions->len + 1 );
+	for( i = 0; i < completions->len; ++i )
+	{
+		texts[i] = ( (const GrCompletion*)g_ptr_array_index( completions, i ) )->text;
+		scores[i] = ( (const GrCompletion*)g_ptr_array_index( completions, i ) )->score;
+	}
+	texts[completions->len] = NULL;
+
+	key = g_strconcat( name, "-stamp", NULL );
+	g_key_file_set_uint64( key_file, group, key, entry->stamps[provider] );
+	g_free( key );
+
+	key = g_strconcat( name, "-texts", NULL );
+	g_key_file_set_string_list( key_file, group, key, texts, completions->len );
+	g_free( key );
+
+	key = g_strconcat( name, "-scores", NULL );
+	g_key_file_set_double_list( key_file, group, key, scores, completions->len );
+	g_free( key );
+
+	g_free( texts );
+	g_free( scores );
+}
+
+/*
+ * The cache keeps the completions of size recent queries, the completions of each
+ * provider separately, so a change of a provider does not drop the others.
+ */
+GrQueryCache*
+gr_query_cache_new(
+	guint size,
+	const gchar* const *provider_names )
+{
+	GrQueryCache *self;
+
+	g_return_val_if_fail( size > 0, NULL );
+	g_return_val_if_fail( provider_names != NULL, NULL );
+
+	self = g_new( GrQueryCache, 1 );
+	self->size = size;
+	self->provider_names = g_strdupv( (GStrv)provider_names );
+	self->n_providers = g_strv_length( self->provider_names );
+	self->entries = g_hash_table_new( gr_query_cache_entry_hash, gr_query_cache_entry_equal );
+	g_queue_init( &self->queue );
+	self->changed = FALSE;
+
+	return self;
+}
+
+void
+gr_query_cache_free(
+	GrQueryCache *self )
+{
+	GList *link;
+
+	if( self == NULL )
+		return;
+
+	while( ( link = g_queue_pop_head_link( &self->queue ) ) != NULL )
+		gr_query_cache_entry_free( self, (GrQueryCacheEntry*)link->data );
+	g_hash_table_unref( self->entries );
+	g_strfreev( self->provider_names );
+	g_free( self );
+}
+
+/*
+ * Returns the entry of the query, it is added if not found, and the least recently used
+ * one is dropped then. The entry is valid until the next call.
+ */
+GrQueryCacheEntry*
+gr_query_cache_get(
+	GrQueryCache *self,
+	const gchar *str,
+	guint limit )
+{
+	GrQueryCacheEntry key, *entry;
+	GList *link;
+
+	g_return_val_if_fail( self != NULL, NULL );
+	g_return_val_if_fail( str != NULL, NULL );
+
+	key.str = (gchar*)str;
+	key.limit = limit;
+	entry = (GrQueryCacheEntry*)g_hash_table_lookup( self->entries, &key );
+	if( entry != NULL )
+	{
+		g_queue_unlink( &self->queue, &entry->link );
+		g_queue_push_head_link( &self->queue, &entry->link );
+		return entry;
+	}
+
+	entry = gr_query_cache_entry_new( self, str, limit );
+	g_hash_table_add( self->entries, entry );
+	g_queue_push_head_link( &self->queue, &entry->link );
+
+	while( self->queue.length > self->size )
+	{
+		link = g_queue_pop_tail_link( &self->queue );
+		g_hash_table_remove( self->entries, link->data );
+		gr_query_cache_entry_free( self, (GrQueryCacheEntry*)link->data );
+		self->changed = TRUE;
+	}
+
+	return entry;
+}
+
+/* returns a copy of the completions of the provider stored with the stamp, NULL if none */
+GPtrArray*
+gr_query_cache_lookup(
+	GrQueryCache *self,
+	GrQueryCacheEntry *entry,
+	guint provider,
+	guint64 stamp )
+{
+	g_return_val_if_fail( self != NULL, NULL );
+	g_return_val_if_fail( entry != NULL, NULL );
+	g_return_val_if_fail( provider < self->n_providers, NULL );
+
+	if( stamp == 0 || entry->stamps[provider] != stamp )
+		return NULL;
+
+	return gr_query_cache_copy_completions( entry->results[provider] );
+}
+
+/* a copy of the completions is stored, nothing is stored with the stamp 0 */
+void
+gr_query_cache_store(
+	GrQueryCache *self,
+	GrQueryCacheEntry *entry,
+	guint provider,
+	guint64 stamp,
+	GPtrArray *completions )
+{
+	g_return_if_fail( self != NULL );
+	g_return_if_fail( entry != NULL );
+	g_return_if_fail( provider < self->n_providers );
+	g_return_if_fail( completions != NULL );
+
+	if( stamp == 0 || entry->stamps[provider] == stamp )
+		return;
+
+	if( entry->results[provider] != NULL )
+		g_ptr_array_unref( entry->results[provider] );
+	entry->results[provider] = gr_query_cache_copy_completions( completions );
+	entry->stamps[provider] = stamp;
+	self->changed = TRUE;
+}
+
+/* the stored entries go after the ones already in the cache */
+void
+gr_query_cache_load(
+	GrQueryCache *self,
+	const gchar *path )
+{
+	GKeyFile *key_file;
+	GrQueryCacheEntry *entry;
+	GStrv groups, g;
+	gchar *str;
+	gint limit;
+	guint i;
+	GError *error = NULL;
+
+	g_return_if_fail( self != NULL );
+
+	if( path == NULL )
+		return;
+
+	key_file = g_key_file_new();
+	if( !g_key_file_load_from_file( key_file, path, G_KEY_FILE_NONE, NULL ) )
+	{
+		g_key_file_free( key_file );
+		return;
+	}
+
+	/* the groups are stored the most recently used first */
+	groups = g_key_file_get_groups( key_file, NULL );
+	for( g = groups; *g != NULL && self->queue.length < self->size; ++g )
+	{
+		if( !g_str_has_prefix( *g, QUERY_GROUP_PREFIX ) )
+			continue;
+
+		str = g_key_file_get_string( key_file, *g, "Text", NULL );
+		limit = g_key_file_get_integer( key_file, *g, "Limit", &error );
+		if( str == NULL || error != NULL || limit < 0 )
+		{
+			g_clear_error( &error );
+			g_free( str );
+			continue;
+		}
+
+		entry = gr_query_cache_entry_new( self, str, (guint)limit );
+		g_free( str );
+		for( i = 0; i < self->n_providers; ++i )
+			gr_query_cache_load_results( self, key_file, *g, entry, i );
+
+		if( gr_query_cache_entry_is_empty( self, entry ) || !gr_query_cache_append( self, entry ) )
+			gr_query_cache_entry_free( self, entry );
+	}
+	g_strfreev( groups );
+	g_key_file_free( key_file );
+}
+
+/* the cache is stored only if it is changed since it was loaded */
+void
+gr_query_cache_save(
+	GrQueryCache *self,
+	const gchar *path )
+{
+	GKeyFile *key_file;
+	GrQueryCacheEntry *entry;
+	GList *link;
+	gchar *group, *dir;
+	guint i, n;
+
+	g_return_if_fail( self != NULL );
+
+	if( path == NULL || !self->changed )
+		return;
+
+	key_file = g_key_file_new();
+	for( link = self->queue.head, n = 0; link != NULL; link = link->next )
+	{
+		entry = (GrQueryCacheEntry*)link->data;
+		if( gr_query_cache_entry_is_empty( self, entry ) )
+			continue;
+
+		group = g_strdup_printf( QUERY_GROUP_PREFIX "%u", n++ );
+		g_key_file_set_string( key_file, group, "Text", entry->str );
+		g_key_file_set_integer( key_file, group, "Limit", (gint)entry->limit );
+		for( i = 0; i < self->n_providers; ++i )
+			if( entry->stamps[i] != 0 )
+				gr_query_cache_save_results( self, key_file, group, entry, i );
+		g_free( group );
+	}
+
+	dir = g_path_get_dirname( path );
+	g_mkdir_with_parents( dir, 0700 );
+	g_free( dir );
+	if( g_key_file_save_to_file( key_file, path, NULL ) )
+		self->changed = FALSE;
+	g_key_file_free( key_file );
+}
+
+/* Returns a{sv}: the number of entries and their bytes */
+GVariant*
+gr_query_cache_get_stats(
+	GrQueryCache *self )
+{
+	GVariantBuilder builder;
+	GrQueryCacheEntry *entry;
+	GrCompletion *completion;
+	GList *l;
+	guint64 bytes;
+	guint i, j;
+
+	g_return_val_if_fail( self != NULL, NULL );
+
+	bytes = sizeof( GrQueryCache );
+	for( l = self->queue.head; l != NULL; l = l->next )
+	{
+		entry = (GrQueryCacheEntry*)l->data;
+		bytes += GR_STATS_HASH_ENTRY_SIZE + sizeof( GrQueryCacheEntry ) + strlen( entry->str ) + 1;
+		bytes += self->n_providers * ( sizeof( guint64 ) + sizeof( GPtrArray* ) );
+		for( i = 0; i < self->n_providers; ++i )
+		{
+			if( entry->results[i] == NULL )
+				continue;
+
+			bytes += sizeof( GPtrArray );
+			for( j = 0; j < entry->results[i]->len; ++j )
+			{
+				completion = (GrCompletion*)g_ptr_array_index( entry->results[i], j );
+				bytes += sizeof( gpointer ) + sizeof( GrCompletion ) + strlen( completion->text ) + 1;
+			}
+		}
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "entries", g_variant_new_uint32( self->queue.length ) );
+	g_variant_builder_add( &builder, "{sv}", "bytes", g_variant_new_uint64( bytes ) );
+
+	return g_variant_builder_end( &builder );
+}
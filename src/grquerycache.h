@@ -0,0 +1,22 @@
+#ifndef GRQUERYCACHE_H
+#define GRQUERYCACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrQueryCache GrQueryCache;
+typedef struct _GrQueryCacheEntry GrQueryCacheEntry;
+
+GrQueryCache* gr_query_cache_new( guint size, const gchar* const *provider_names );
+void gr_query_cache_free( GrQueryCache *self );
+GrQueryCacheEntry* gr_query_cache_get( GrQueryCache *self, const gchar *str, guint limit );
+GPtrArray* gr_query_cache_lookup( GrQueryCache *self, GrQueryCacheEntry *entry, guint provider, guint64 stamp );
+void gr_query_cache_store( GrQueryCache *self, GrQueryCacheEntry *entry, guint provider, guint64 stamp, GPtrArray *completions );
+void gr_query_cache_load( GrQueryCache *self, const gchar *path );
+void gr_query_cache_save( GrQueryCache *self, const gchar *path );
+GVariant* gr_query_cache_get_stats( GrQueryCache *self );
+
+G_END_DECLS
+
+#endif
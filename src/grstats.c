@@ -0,0 +1,208 @@
+#include "grstats.h"
+
+#include <glib.h>
+#include <sys/resource.h>
+
+#define STATS_INDENT "  "
+
+static void
+gr_stats_append_json_string(
+	GString *out,
+	const gchar *str )
+{
+	const gchar *p;
+
+	g_string_append_c( out, '"' );
+	for( p = str; *p != '\0'; ++p )
+	{
+		if( *p == '"' || *p == '\\' )
+		{
+			g_string_append_c( out, '\\' );
+			g_string_append_c( out, *p );
+		}
+		else if( (guchar)*p < 0x20 )
+			g_string_append_printf( out, "\\u%04x", (guint)(guchar)*p );
+		else
+			g_string_append_c( out, *p );
+	}
+	g_string_append_c( out, '"' );
+}
+
+static void
+gr_stats_append_scalar(
+	GString *out,
+	GVariant *value,
+	gboolean json )
+{
+	switch( g_variant_classify( value ) )
+	{
+		case G_VARIANT_CLASS_STRING:
+			if( json )
+				gr_stats_append_json_string( out, g_variant_get_string( value, NULL ) );
+			else
+				g_string_append( out, g_variant_get_string( value, NULL ) );
+			break;
+		case G_VARIANT_CLASS_BOOLEAN:
+			g_string_append( out, g_variant_get_boolean( value ) ? "true" : "false" );
+			break;
+		case G_VARIANT_CLASS_UINT32:
+			g_string_append_printf( out, "%u", g_variant_get_uint32( value ) );
+			break;
+		case G_VARIANT_CLASS_UINT64:
+			g_string_append_printf( out, "%" G_GUINT64_FORMAT, g_variant_get_uint64( value ) );
+			break;
+		case G_VARIANT_CLASS_INT64:
+			g_string_append_printf( out, "%" G_GINT64_FORMAT, g_variant_get_int64( value ) );
+			break;
+		case G_VARIANT_CLASS_DOUBLE:
+			g_string_append_printf( out, "%g", g_variant_get_double( value ) );
+			break;
+		default:
+			g_string_append( out, json ? "null" : "?" );
+			break;
+	}
+}
+
+static void
+gr_stats_append_json(
+	GString *out,
+	GVariant *value )
+{
+	GVariantIter iter;
+	GVariant *child;
+	const gchar *key;
+	gboolean first;
+
+	first = TRUE;
+	if( g_variant_is_of_type( value, G_VARIANT_TYPE_VARDICT ) )
+	{
+		g_string_append_c( out, '{' );
+		g_variant_iter_init( &iter, value );
+		while( g_variant_iter_next( &iter, "{&sv}", &key, &child ) )
+		{
+			if( !first )
+				g_string_append_c( out, ',' );
+			first = FALSE;
+
+			gr_stats_append_json_string( out, key );
+			g_string_append_c( out, ':' );
+			gr_stats_append_json( out, child );
+			g_variant_unref( child );
+		}
+		g_string_append_c( out, '}' );
+	}
+	else if( g_variant_is_of_type( value, G_VARIANT_TYPE_ARRAY ) )
+	{
+		g_string_append_c( out, '[' );
+		g_variant_iter_init( &iter, value );
+		while( ( child = g_variant_iter_next_value( &iter ) ) != NULL )
+		{
+			if( !first )
+				g_string_append_c( out, ',' );
+			first = FALSE;
+
+			gr_stats_append_json( out, child );
+			g_variant_unref( child );
+		}
+		g_string_append_c( out, ']' );
+	}
+	else
+		gr_stats_append_scalar( out, value, TRUE );
+}
+
+/* a dictionary is a line per key, an array is a dash line per element, nested ones are indented */
+static void
+gr_stats_append_text(
+	GString *out,
+	GVariant *value,
+	guint depth )
+{
+	GVariantIter iter;
+	GVariant *child;
+	const gchar *key;
+	guint i;
+
+	g_variant_iter_init( &iter, value );
+	if( g_variant_is_of_type( value, G_VARIANT_TYPE_VARDICT ) )
+	{
+		while( g_variant_iter_next( &iter, "{&sv}", &key, &child ) )
+		{
+			for( i = 0; i < depth; ++i )
+				g_string_append( out, STATS_INDENT );
+			g_string_append_printf( out, "%s:", key );
+
+			if( g_variant_is_container( child ) )
+			{
+				g_string_append_c( out, '\n' );
+				gr_stats_append_text( out, child, depth + 1 );
+			}
+			else
+			{
+				g_string_append_c( out, ' ' );
+				gr_stats_append_scalar( out, child, FALSE );
+				g_string_append_c( out, '\n' );
+			}
+			g_variant_unref( child );
+		}
+	}
+	else
+	{
+		while( ( child = g_variant_iter_next_value( &iter ) ) != NULL )
+		{
+			for( i = 0; i < depth; ++i )
+				g_string_append( out, STATS_INDENT );
+			if( g_variant_is_container( child ) )
+			{
+				g_string_append( out, "-\n" );
+				gr_stats_append_text( out, child, depth + 1 );
+			}
+			else
+			{
+				g_string_append( out, "- " );
+				gr_stats_append_scalar( out, child, FALSE );
+				g_string_append_c( out, '\n' );
+			}
+			g_variant_unref( child );
+		}
+	}
+}
+
+/*
+ * Returns the statistics as plain text or as a line of JSON. The statistics are a dictionary
+ * of type a{sv}, its values are strings, numbers, booleans, dictionaries and arrays of them.
+ */
+gchar*
+gr_stats_format(
+	GVariant *stats,
+	gboolean json )
+{
+	GString *out;
+
+	g_return_val_if_fail( stats != NULL, NULL );
+	g_return_val_if_fail( g_variant_is_of_type( stats, G_VARIANT_TYPE_VARDICT ), NULL );
+
+	out = g_string_new( NULL );
+	if( json )
+	{
+		gr_stats_append_json( out, stats );
+		g_string_append_c( out, '\n' );
+	}
+	else
+		gr_stats_append_text( out, stats, 0 );
+
+	return g_string_free( out, FALSE );
+}
+
+/* the peak resident set size of the process in bytes, 0 if unknown */
+guint64
+gr_stats_get_peak_rss(
+	void )
+{
+	struct rusage usage;
+
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+		return 0;
+
+	/* kilobytes on Linux */
+	return (guint64)usage.ru_maxrss * 1024;
+}
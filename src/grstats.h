@@ -0,0 +1,16 @@
+#ifndef GRSTATS_H
+#define GRSTATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* the bytes of an entry of a GHashTable: the key, the value and the hash */
+#define GR_STATS_HASH_ENTRY_SIZE ( 2 * sizeof( gpointer ) + sizeof( guint ) )
+
+gchar* gr_stats_format( GVariant *stats, gboolean json );
+guint64 gr_stats_get_peak_rss( void );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,254 @@
+#include "grsuffixarray.h"
+
+#include <glib.h>
+#include <string.h>
+
+/* lines are stored one after another with their terminating zeros, a suffix is the offset
+ * of a character in the stored lines, so every suffix ends with its own line */
+struct _GrSuffixArray
+{
+	GByteArray *corpus;
+	GArray *line_offsets; /* guint, the offset of every line */
+	GArray *suffixes; /* guint, the offsets sorted by their suffixes */
+};
+
+static gint
+gr_suffix_array_compare(
+	gconstpointer a,
+	gconstpointer b,
+	gpointer user_data )
+{
+	const gchar *corpus = (const gchar*)user_data;
+	guint x = *(const guint*)a;
+	guint y = *(const guint*)b;
+	gint ret;
+
+	/* equal suffixes of different lines are ordered by their offsets */
+	ret = strcmp( corpus + x, corpus + y );
+	if( ret != 0 )
+		return ret;
+
+	return x < y ? -1 : ( x > y ? 1 : 0 );
+}
+
+static gint
+gr_suffix_array_compare_uint(
+	gconstpointer a,
+	gconstpointer b )
+{
+	guint x = *(const guint*)a;
+	guint y = *(const guint*)b;
+
+	return x < y ? -1 : ( x > y ? 1 : 0 );
+}
+
+/* merge the sorted suffixes into the array in a single pass */
+static void
+gr_suffix_array_merge(
+	GrSuffixArray *self,
+	GArray *suffixes )
+{
+	const gchar *corpus = (const gchar*)self->corpus->data;
+	GArray *merged;
+	guint i, j, x;
+
+	if( self->suffixes->len == 0 )
+	{
+		g_array_append_vals( self->suffixes, suffixes->data, suffixes->len );
+		return;
+	}
+
+	merged = g_array_sized_new( FALSE, FALSE, sizeof( guint ), self->suffixes->len + suffixes->len );
+	for( i = 0, j = 0; i < self->suffixes->len || j < suffixes->len; )
+	{
+		if( j == suffixes->len ||
+			( i < self->suffixes->len && gr_suffix_array_compare(
+				&g_array_index( self->suffixes, guint, i ), &g_array_index( suffixes, guint, j ), (gpointer)corpus ) < 0 ) )
+			x = g_array_index( self->suffixes, guint, i++ );
+		else
+			x = g_array_index( suffixes, guint, j++ );
+
+		g_array_append_val( merged, x );
+	}
+
+	g_array_unref( self->suffixes );
+	self->suffixes = merged;
+}
+
+/* the index of the line containing the offset */
+static guint
+gr_suffix_array_find_line(
+	GrSuffixArray *self,
+	guint offset )
+{
+	guint lo, hi, mid;
+
+	lo = 0;
+	hi = self->line_offsets->len;
+	while( hi - lo > 1 )
+	{
+		mid = lo + ( hi - lo ) / 2;
+		if( g_array_index( self->line_offsets, guint, mid ) <= offset )
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+GrSuffixArray*
+gr_suffix_array_new( void )
+{
+	GrSuffixArray *self;
+
+	self = g_new( GrSuffixArray, 1 );
+	self->corpus = g_byte_array_new();
+	self->line_offsets = g_array_new( FALSE, FALSE, sizeof( guint ) );
+	self->suffixes = g_array_new( FALSE, FALSE, sizeof( guint ) );
+
+	return self;
+}
+
+void
+gr_suffix_array_free(
+	GrSuffixArray *self )
+{
+	if( self == NULL )
+		return;
+
+	g_byte_array_unref( self->corpus );
+	g_array_unref( self->line_offsets );
+	g_array_unref( self->suffixes );
+	g_free( self );
+}
+
+/*
+ * Adds the lines to the array: only the suffixes of the new lines are sorted, then they are
+ * merged with the sorted ones, so adding m characters costs O(m log m + n).
+ */
+void
+gr_suffix_array_add_lines(
+	GrSuffixArray *self,
+	const gchar* const *lines,
+	guint n_lines )
+{
+	GArray *suffixes;
+	gsize len;
+	guint i, j, offset, suffix;
+
+	g_return_if_fail( self != NULL );
+
+	suffixes = g_array_new( FALSE, FALSE, sizeof( guint ) );
+	for( i = 0; i < n_lines; ++i )
+	{
+		offset = self->corpus->len;
+		len = strlen( lines[i] );
+		g_array_append_val( self->line_offsets, offset );
+		g_byte_array_append( self->corpus, (const guint8*)lines[i], len + 1 );
+
+		/* a UTF-8 string matches only from the first byte of a character */
+		for( j = 0; j < len; ++j )
+		{
+			if( ( lines[i][j] & 0xC0 ) == 0x80 )
+				continue;
+
+			suffix = offset + j;
+			g_array_append_val( suffixes, suffix );
+		}
+	}
+
+	g_array_sort_with_data( suffixes, gr_suffix_array_compare, self->corpus->data );
+	gr_suffix_array_merge( self, suffixes );
+	g_array_unref( suffixes );
+}
+
+void
+gr_suffix_array_add_line(
+	GrSuffixArray *self,
+	const gchar *line )
+{
+	gr_suffix_array_add_lines( self, &line, 1 );
+}
+
+guint
+gr_suffix_array_get_n_lines(
+	GrSuffixArray *self )
+{
+	g_return_val_if_fail( self != NULL, 0 );
+
+	return self->line_offsets->len;
+}
+
+/* the returned string is valid until the next line is added */
+const gchar*
+gr_suffix_array_get_line(
+	GrSuffixArray *self,
+	guint index )
+{
+	g_return_val_if_fail( self != NULL, NULL );
+	g_return_val_if_fail( index < self->line_offsets->len, NULL );
+
+	return (const gchar*)self->corpus->data + g_array_index( self->line_offsets, guint, index );
+}
+
+/* returns the sorted array of guint indexes of the lines containing str */
+GArray*
+gr_suffix_array_lookup(
+	GrSuffixArray *self,
+	const gchar *str )
+{
+	const gchar *corpus;
+	GArray *lines;
+	gsize len;
+	guint lo, hi, mid, i, j, line;
+
+	g_return_val_if_fail( self != NULL, NULL );
+
+	lines = g_array_new( FALSE, FALSE, sizeof( guint ) );
+	if( str == NULL || *str == '\0' )
+		return lines;
+
+	corpus = (const gchar*)self->corpus->data;
+	len = strlen( str );
+
+	/* the first suffix starting with str */
+	lo = 0;
+	hi = self->suffixes->len;
+	while( lo < hi )
+	{
+		mid = lo + ( hi - lo ) / 2;
+		if( strncmp( corpus + g_array_index( self->suffixes, guint, mid ), str, len ) < 0 )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for( i = lo; i < self->suffixes->len; ++i )
+	{
+		if( strncmp( corpus + g_array_index( self->suffixes, guint, i ), str, len ) != 0 )
+			break;
+
+		line = gr_suffix_array_find_line( self, g_array_index( self->suffixes, guint, i ) );
+		g_array_append_val( lines, line );
+	}
+
+	/* a line containing str several times is returned once */
+	g_array_sort( lines, gr_suffix_array_compare_uint );
+	for( i = 0, j = 0; i < lines->len; ++i )
+		if( j == 0 || g_array_index( lines, guint, i ) != g_array_index( lines, guint, j - 1 ) )
+			g_array_index( lines, guint, j++ ) = g_array_index( lines, guint, i );
+	g_array_set_size( lines, j );
+
+	return lines;
+}
+
+/* the bytes of the lines and of the offsets */
+gsize
+gr_suffix_array_get_size(
+	GrSuffixArray *self )
+{
+	g_return_val_if_fail( self != NULL, 0 );
+
+	return sizeof( GrSuffixArray ) + self->corpus->len + ( self->line_offsets->len + self->suffixes->len ) * sizeof( guint );
+}
@@ -0,0 +1,21 @@
+#ifndef GRSUFFIXARRAY_H
+#define GRSUFFIXARRAY_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GrSuffixArray GrSuffixArray;
+
+GrSuffixArray* gr_suffix_array_new( void );
+void gr_suffix_array_free( GrSuffixArray *self );
+void gr_suffix_array_add_lines( GrSuffixArray *self, const gchar* const *lines, guint n_lines );
+void gr_suffix_array_add_line( GrSuffixArray *self, const gchar *line );
+guint gr_suffix_array_get_n_lines( GrSuffixArray *self );
+const gchar* gr_suffix_array_get_line( GrSuffixArray *self, guint index );
+GArray* gr_suffix_array_lookup( GrSuffixArray *self, const gchar *str );
+gsize gr_suffix_array_get_size( GrSuffixArray *self );
+
+G_END_DECLS
+
+#endif
@@ -10,14 +10,26 @@
 #include <glib.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
+#include <gio/gdesktopappinfo.h>
+#include <unistd.h>
+
+/* completions listed at once, the next ones are listed when the list is scrolled to its end */
+#define LIST_PAGE_SIZE 64
 
 struct _GrWindow
 {
 	GtkApplicationWindow parent_instance;
 
+	GtkBox *box;
 	GrEntry *entry;
-	GrList *list;
+	GrList *list; /* NULL, until it is built on the first Tab or when idle after the first frame */
+	guint list_idle_id;
 	gboolean is_entry_visible;
+	gint64 init_time;
+	GCancellable *files_cancellable;
+
+	/* the completions not listed yet, NULL if all of them are listed */
+	GrCommandListCursor *list_cursor;
 
 	GrApplication *app;
 };
@@ -38,6 +50,43 @@ on_window_notify_application(
 	/*setup window and widgets with the options from the application */
 	gtk_window_set_default_size( GTK_WINDOW( self ), gr_application_get_width( self->app ), -1 );
 
+	com_list = gr_application_get_command_list( self->app );
+	gr_entry_set_command_list( self->entry, com_list );
+	g_object_unref( G_OBJECT( com_list ) );
+}
+
+static void
+on_list_end_reached(
+	GrList *self,
+	gpointer user_data );
+
+static void
+on_widget_activate(
+	GtkWidget *widget,
+	const gchar *text,
+	gpointer user_data );
+
+/* the list is built once, most launches never show it, nothing is done if it is built already */
+void
+gr_window_build_list(
+	GrWindow *self )
+{
+	GrCommandList *com_list;
+	gint64 start_time;
+
+	g_return_if_fail( GR_IS_WINDOW( self ) );
+
+	if( self->list != NULL )
+		return;
+
+	g_clear_handle_id( &self->list_idle_id, g_source_remove );
+
+	start_time = g_get_monotonic_time();
+
+	self->list = gr_list_new();
+	g_signal_connect( G_OBJECT( self->list ), "activate", G_CALLBACK( on_widget_activate ), self );
+	g_signal_connect( G_OBJECT( self->list ), "end-reached", G_CALLBACK( on_list_end_reached ), self );
+
 	if( gr_application_get_max_height_set( self->app ) )
 		gr_list_set_max_content_height( self->list, gr_application_get_max_height( self->app ) );
 	else
@@ -47,45 +96,207 @@ on_window_notify_application(
 	}
 
 	com_list = gr_application_get_command_list( self->app );
-	gr_entry_set_command_list( self->entry, com_list );
+	gr_list_set_command_list( self->list, com_list );
 	g_object_unref( G_OBJECT( com_list ) );
+
+	gtk_widget_set_visible( GTK_WIDGET( self->list ), FALSE );
+	gtk_box_append( self->box, GTK_WIDGET( self->list ) );
+
+	g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+		"MESSAGE", "List built in %" G_GINT64_FORMAT " us", g_get_monotonic_time() - start_time,
+		NULL );
+}
+
+static gboolean
+on_list_idle(
+	gpointer user_data )
+{
+	GrWindow *window = GR_WINDOW( user_data );
+
+	window->list_idle_id = 0;
+	gr_window_build_list( window );
+
+	return G_SOURCE_REMOVE;
 }
 
+/* the list is built when idle after the first frame, before a human reaches for Tab */
 static void
-gr_window_switch_widgets(
+on_frame_clock_after_paint(
+	GdkFrameClock *clock,
+	gpointer user_data )
+{
+	GrWindow *window = GR_WINDOW( user_data );
+
+	g_signal_handlers_disconnect_by_func( clock, on_frame_clock_after_paint, window );
+
+	g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+		"MESSAGE", "First frame painted in %" G_GINT64_FORMAT " us", g_get_monotonic_time() - window->init_time,
+		NULL );
+
+	if( window->list == NULL && window->list_idle_id == 0 )
+		window->list_idle_id = g_idle_add( on_list_idle, window );
+}
+
+static void
+on_window_map(
+	GtkWidget *widget,
+	gpointer user_data )
+{
+	GrWindow *window = GR_WINDOW( user_data );
+	GdkFrameClock *clock;
+
+	g_signal_handlers_disconnect_by_func( widget, on_window_map, window );
+
+	clock = gtk_widget_get_frame_clock( widget );
+	if( clock != NULL )
+		g_signal_connect_object( G_OBJECT( clock ), "after-paint", G_CALLBACK( on_frame_clock_after_paint ), window, 0 );
+	else
+		gr_window_build_list( window );
+}
+
+static void
+on_compared_files_chunk(
+	const gchar* const *chunk,
+	gpointer user_data )
+{
+	GrWindow *window = GR_WINDOW( user_data );
+
+	gr_list_append_array( window->list, (const GStrv)chunk );
+}
+
+static void
+gr_window_cancel_compared_files(
+	GrWindow *self )
+{
+	if( self->files_cancellable == NULL )
+		return;
+
+	g_cancellable_cancel( self->files_cancellable );
+	g_clear_object( &self->files_cancellable );
+}
+
+/* append the next page of completions to the list */
+static void
+gr_window_list_page(
+	GrWindow *self )
+{
+	GStrvBuilder *builder;
+	const gchar *text;
+	GStrv arr;
+	guint n;
+
+	if( self->list_cursor == NULL )
+		return;
+
+	/* the cursor resumes where the previous page ended */
+	builder = g_strv_builder_new();
+	for( n = 0; n < LIST_PAGE_SIZE && ( text = gr_command_list_query_next( self->list_cursor ) ) != NULL; ++n )
+		g_strv_builder_add( builder, text );
+	arr = g_strv_builder_end( builder );
+	g_strv_builder_unref( builder );
+
+	gr_list_append_array( self->list, arr );
+	g_strfreev( arr );
+
+	/* a short page is the last one */
+	if( n < LIST_PAGE_SIZE )
+		g_clear_pointer( &self->list_cursor, gr_command_list_query_end );
+}
+
+static void
+on_list_end_reached(
+	GrList *self,
+	gpointer user_data )
+{
+	GrWindow *window = GR_WINDOW( user_data );
+
+	gr_window_list_page( window );
+}
+
+static void
+gr_window_show_entry(
+	GrWindow *self )
+{
+	gtk_widget_set_visible( GTK_WIDGET( self->entry ), TRUE );
+	if( self->list != NULL )
+		gtk_widget_set_visible( GTK_WIDGET( self->list ), FALSE );
+	gtk_widget_grab_focus( GTK_WIDGET( self->entry ) );
+	self->is_entry_visible = TRUE;
+}
+
+static void
+gr_window_show_list(
+	GrWindow *self )
+{
+	gtk_widget_set_visible( GTK_WIDGET( self->entry ), FALSE );
+	gtk_widget_set_visible( GTK_WIDGET( self->list ), TRUE );
+	gtk_widget_grab_focus( GTK_WIDGET( self->list ) );
+	self->is_entry_visible = FALSE;
+}
+
+static void
+gr_window_search_history(
 	GrWindow *self )
 {
 	GrCommandList *com_list;
 	gchar *text;
 	GStrv arr;
 
+	gr_window_cancel_compared_files( self );
+	g_clear_pointer( &self->list_cursor, gr_command_list_query_end );
+	gr_window_build_list( self );
+
+	/* list the history commands containing the typed text */
+	text = gr_entry_get_text_befor_cursor( self->entry );
+	com_list = gr_application_get_command_list( self->app );
+	arr = gr_command_list_search_history( com_list, text );
+	gr_list_set_array( self->list, arr );
+	g_strfreev( arr );
+	g_object_unref( G_OBJECT( com_list ) );
+	g_free( text );
+
+	gr_window_show_list( self );
+}
+
+static void
+gr_window_switch_widgets(
+	GrWindow *self )
+{
+	GrCommandList *com_list;
+	gchar *text;
+
 	if( self->is_entry_visible )
 	{
 		text = gr_entry_get_text_befor_cursor( self->entry );
-
+		gr_window_build_list( self );
 		com_list = gr_application_get_command_list( self->app );
-		arr = gr_command_list_get_compared_array( com_list, text );
+
+		/* the first page only, the list is rarely scrolled further */
+		gr_list_set_array( self->list, NULL );
+		g_clear_pointer( &self->list_cursor, gr_command_list_query_end );
+		self->list_cursor = gr_command_list_query_begin( com_list, text, 0, 0 );
+		gr_window_list_page( self );
+
+		/* files of a large directory are appended to the list as they are enumerated */
+		gr_window_cancel_compared_files( self );
+		self->files_cancellable = g_cancellable_new();
+		gr_command_list_get_compared_files_async( com_list, text, self->files_cancellable, on_compared_files_chunk, self );
 		g_free( text );
 		g_object_unref( G_OBJECT( com_list ) );
 
-		gr_list_set_array( self->list, arr );
-		g_strfreev( arr );
-
-		gtk_widget_set_visible( GTK_WIDGET( self->entry ), FALSE );
-		gtk_widget_set_visible( GTK_WIDGET( self->list ), TRUE );
-		gtk_widget_grab_focus( GTK_WIDGET( self->list ) );
+		gr_window_show_list( self );
 	}
 	else
 	{
+		gr_window_cancel_compared_files( self );
+		g_clear_pointer( &self->list_cursor, gr_command_list_query_end );
+
 		text = gr_list_get_selected_text( self->list );
 		gr_entry_set_text( self->entry, text );
 		g_free( text );
 
-		gtk_widget_set_visible( GTK_WIDGET( self->entry ), TRUE );
-		gtk_widget_set_visible( GTK_WIDGET( self->list ), FALSE );
-		gtk_widget_grab_focus( GTK_WIDGET( self->entry ) );
+		gr_window_show_entry( self );
 	}
-	self->is_entry_visible = !self->is_entry_visible;
 }
 
 static gboolean
@@ -111,9 +322,95 @@ on_event_key_pressed(
 		return GDK_EVENT_STOP;
 	}
 
+	if( keyval == GDK_KEY_r && ( state & GDK_CONTROL_MASK ) && window->is_entry_visible )
+	{
+		gr_window_search_history( window );
+		return GDK_EVENT_STOP;
+	}
+
 	return GDK_EVENT_PROPAGATE;
 }
 
+static void
+on_child_setup(
+	gpointer user_data )
+{
+	/* detach the child from the terminal and the session of the program */
+	setsid();
+}
+
+static gboolean
+gr_window_spawn_command(
+	GrWindow *self,
+	const gchar *command,
+	GError **error )
+{
+	const gchar *shell;
+	gchar *command_locale;
+	GStrv argv;
+	GSpawnFlags flags;
+	gboolean ret;
+
+	command_locale = g_filename_from_utf8( command, -1, NULL, NULL, error );
+	if( command_locale == NULL )
+		return FALSE;
+
+	/* split command line to arguments or pass it to the shell as is */
+	if( gr_application_get_shell( self->app ) )
+	{
+		shell = g_getenv( "SHELL" );
+		if( shell == NULL || *shell == '\0' )
+			shell = "/bin/sh";
+
+		argv = g_new( gchar*, 4 );
+		argv[0] = g_strdup( shell );
+		argv[1] = g_strdup( "-c" );
+		argv[2] = command_locale;
+		argv[3] = NULL;
+	}
+	else
+	{
+		ret = g_shell_parse_argv( command_locale, NULL, &argv, error );
+		g_free( command_locale );
+		if( !ret )
+			return FALSE;
+	}
+
+	/* without G_SPAWN_DO_NOT_REAP_CHILD the child is double-forked and reparented to init,
+	 * descriptors are not inherited and stdin is attached to /dev/null */
+	flags = G_SPAWN_SEARCH_PATH;
+	if( gr_application_get_silent( self->app ) )
+		flags |= G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
+
+	ret = g_spawn_async( NULL, argv, NULL, flags, on_child_setup, NULL, NULL, error );
+	g_strfreev( argv );
+
+	return ret;
+}
+
+static gboolean
+gr_window_launch_app_info(
+	GrWindow *self,
+	GAppInfo *app_info,
+	GError **error )
+{
+	GdkAppLaunchContext *context;
+	GSpawnFlags flags;
+	gboolean ret;
+
+	flags = G_SPAWN_SEARCH_PATH;
+	if( gr_application_get_silent( self->app ) )
+		flags |= G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL;
+
+	/* the desktop entry is launched detached as a parsed command */
+	context = gdk_display_get_app_launch_context( gtk_widget_get_display( GTK_WIDGET( self ) ) );
+	ret = g_desktop_app_info_launch_uris_as_manager( G_DESKTOP_APP_INFO( app_info ), NULL, G_APP_LAUNCH_CONTEXT( context ),
+		flags, on_child_setup, NULL, NULL, NULL, error );
+	g_object_unref( G_OBJECT( context ) );
+
+	return ret;
+}
+
 static void
 on_widget_activate(
 	GtkWidget *widget,
@@ -121,10 +418,10 @@ on_widget_activate(
 	gpointer user_data )
 {
 	GrWindow *window = GR_WINDOW( user_data );
-	gchar *command, *command_locale;
-	GSubprocessFlags flags;
-	GSubprocess *subproc;
+	gchar *command;
 	GrCommandList *com_list;
+	GAppInfo *app_info;
+	gboolean ret;
 	GError *error = NULL;
 
 	/* nothing to do */
@@ -142,28 +439,29 @@ on_widget_activate(
 		return;
 	}
 
-	if( gr_application_get_silent( window->app ) )
-		flags = G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_SILENCE;
+	/* do system call, the name of a desktop entry launches the entry */
+	com_list = gr_application_get_command_list( window->app );
+	app_info = gr_command_list_get_app_info( com_list, command );
+	if( app_info != NULL )
+	{
+		ret = gr_window_launch_app_info( window, app_info, &error );
+		g_object_unref( G_OBJECT( app_info ) );
+	}
 	else
-		flags = G_SUBPROCESS_FLAGS_NONE;
+		ret = gr_window_spawn_command( window, command, &error );
 
-	/* do system call */
-	command_locale = g_filename_from_utf8( command, -1, NULL, NULL, NULL );
-	subproc = g_subprocess_new( flags, &error, command_locale, NULL );
-	g_free(command_locale );
-	if( error != NULL )
+	if( !ret )
 	{
 		g_log_structured( G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
 			"MESSAGE", error->message,
 			NULL );
 		g_clear_error( &error );
 		g_free(command );
+		g_object_unref( G_OBJECT( com_list ) );
 		return;
 	}
-	g_object_unref( G_OBJECT( subproc ) );
 
 	/* store new command */
-	com_list = gr_application_get_command_list( window->app );
 	gr_command_list_push( com_list, command );
 	g_free(command );
 	g_object_unref( G_OBJECT( com_list ) );
@@ -176,7 +474,8 @@ gr_window_init(
 	GrWindow *self )
 {
 	GtkEventControllerKey *event_key;
-	GtkBox *box;
+
+	self->init_time = g_get_monotonic_time();
 
 	/* setup window */
 	gtk_window_set_title( GTK_WINDOW( self ), PROGRAM_NAME );
@@ -189,31 +488,48 @@ gr_window_init(
 	gtk_widget_add_controller( GTK_WIDGET( self ), GTK_EVENT_CONTROLLER( event_key ) );
 	g_signal_connect( G_OBJECT( event_key ), "key-pressed", G_CALLBACK( on_event_key_pressed ), self );
 
-	/* create widgets */
-	box = GTK_BOX( gtk_box_new( GTK_ORIENTATION_VERTICAL, 1 ) );
+	/* create widgets, the list is built later */
+	self->box = GTK_BOX( gtk_box_new( GTK_ORIENTATION_VERTICAL, 1 ) );
 
 	self->entry = gr_entry_new();
 	g_signal_connect( G_OBJECT( self->entry ), "activate", G_CALLBACK( on_widget_activate ), self );
 
-	self->list = gr_list_new();
-	g_signal_connect( G_OBJECT( self->list ), "activate", G_CALLBACK( on_widget_activate ), self );
+	self->list = NULL;
+	self->list_idle_id = 0;
+	g_signal_connect( G_OBJECT( self ), "map", G_CALLBACK( on_window_map ), self );
 
 	/* layout widgets */
-	gtk_window_set_child( GTK_WINDOW( self ), GTK_WIDGET( box ) );
-	gtk_box_append( box, GTK_WIDGET( self->entry ) );
-	gtk_box_append( box, GTK_WIDGET( self->list ) );
+	gtk_window_set_child( GTK_WINDOW( self ), GTK_WIDGET( self->box ) );
+	gtk_box_append( self->box, GTK_WIDGET( self->entry ) );
 
 	/* configure widgets */
 	gtk_widget_set_visible( GTK_WIDGET( self->entry ), TRUE );
-	gtk_widget_set_visible( GTK_WIDGET( self->list ), FALSE );
 	gtk_widget_grab_focus( GTK_WIDGET( self->entry ) );
 	self->is_entry_visible = TRUE;
+	self->files_cancellable = NULL;
+	self->list_cursor = NULL;
+}
+
+static void
+gr_window_dispose(
+	GObject *object )
+{
+	GrWindow *self = GR_WINDOW( object );
+
+	gr_window_cancel_compared_files( self );
+	g_clear_pointer( &self->list_cursor, gr_command_list_query_end );
+	g_clear_handle_id( &self->list_idle_id, g_source_remove );
+
+	G_OBJECT_CLASS( gr_window_parent_class )->dispose( object );
 }
 
 static void
 gr_window_class_init(
 	GrWindowClass *klass )
 {
+	GObjectClass *object_class = G_OBJECT_CLASS( klass );
+
+	object_class->dispose = gr_window_dispose;
 }
 
 GrWindow*
@@ -225,3 +541,56 @@ gr_window_new(
 	return GR_WINDOW( g_object_new( GR_TYPE_WINDOW, "application", app, NULL ) );
 }
 
+/* see gr_entry_get_latency_stats() */
+GVariant*
+gr_window_get_latency_stats(
+	GrWindow *self )
+{
+	g_return_val_if_fail( GR_IS_WINDOW( self ), NULL );
+
+	return gr_entry_get_latency_stats( self->entry );
+}
+
+/*
+ * Types a key through the paths of the key handlers, GTK has no API to inject key events: \t is
+ * Tab, \b is BackSpace, the others are inserted into the entry. Returns TRUE if the key went
+ * to the list.
+ */
+gboolean
+gr_window_type_key(
+	GrWindow *self,
+	const gchar *key )
+{
+	gboolean is_list;
+
+	g_return_val_if_fail( GR_IS_WINDOW( self ), FALSE );
+	g_return_val_if_fail( key != NULL, FALSE );
+
+	is_list = !self->is_entry_visible;
+
+	if( g_str_equal( key, "\t" ) )
+	{
+		is_list = self->is_entry_visible;
+		gr_window_switch_widgets( self );
+	}
+	/* the list ignores the other keys */
+	else if( !is_list && g_str_equal( key, "\b" ) )
+		gr_entry_delete_before_cursor( self->entry );
+	else if( !is_list )
+		gr_entry_insert_at_cursor( self->entry, key );
+
+	return is_list;
+}
+
+/* 0 until the list is built */
+guint
+gr_window_get_n_list_items(
+	GrWindow *self )
+{
+	g_return_val_if_fail( GR_IS_WINDOW( self ), 0 );
+
+	if( self->list == NULL )
+		return 0;
+
+	return gr_list_get_n_items( self->list );
+}
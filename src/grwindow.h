@@ -14,6 +14,10 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE( GrWindow, gr_window, GR, WINDOW, GtkApplicationWindow )
 
 GrWindow* gr_window_new( GrApplication *app );
+GVariant* gr_window_get_latency_stats( GrWindow *self );
+gboolean gr_window_type_key( GrWindow *self, const gchar *key );
+guint gr_window_get_n_list_items( GrWindow *self );
+void gr_window_build_list( GrWindow *self );
 
 G_END_DECLS
 
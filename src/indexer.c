@@ -0,0 +1,96 @@
+#include "config.h"
+#include "grpathindex.h"
+#include "grstats.h"
+
+#include <glib.h>
+#include <locale.h>
+#include <stdlib.h>
+
+#ifdef SYSTEM_INDEX_DIR
+#define INDEXER_OUTPUT_HELP "Directory to store the index in, " SYSTEM_INDEX_DIR " by default"
+#else
+#define INDEXER_OUTPUT_HELP "Directory to store the index in"
+#endif
+
+/*
+ * Builds the index of the binaries of the directories for all users, so every instance maps
+ * it instead of scanning the directories while they are not modified. Package managers run
+ * it after installing or removing binaries.
+ */
+int
+main(
+	int argc,
+	char *argv[] )
+{
+	gchar *output = NULL;
+	GStrv dirs = NULL;
+	gboolean stats = FALSE;
+
+	const GOptionEntry option_entries[] =
+	{
+		{ "output", 'o', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &output, INDEXER_OUTPUT_HELP, "DIR" },
+		{ "stats", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &stats, "Print statistics of the index", NULL },
+		{ G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY, &dirs, NULL, "[DIRECTORY...]" },
+		{ NULL }
+	};
+
+	GOptionContext *context;
+	GrPathIndex *index;
+	GVariant *index_stats;
+	gchar *text;
+	gint ret = EXIT_SUCCESS;
+	GError *error = NULL;
+
+	setlocale( LC_ALL, "" );
+
+	context = g_option_context_new( NULL );
+	g_option_context_set_summary( context, "Store the index of binaries of the directories for " PROGRAM_NAME "." );
+#ifdef SYSTEM_INDEX_DIRS
+	g_option_context_set_description( context, "The directories are " SYSTEM_INDEX_DIRS " by default." );
+#endif
+	g_option_context_add_main_entries( context, option_entries, NULL );
+	if( !g_option_context_parse( context, &argc, &argv, &error ) )
+	{
+		g_printerr( "%s\n", error->message );
+		g_error_free( error );
+		g_option_context_free( context );
+		return EXIT_FAILURE;
+	}
+	g_option_context_free( context );
+
+#ifdef SYSTEM_INDEX_DIR
+	if( output == NULL )
+		output = g_strdup( SYSTEM_INDEX_DIR );
+#endif
+#ifdef SYSTEM_INDEX_DIRS
+	if( dirs == NULL )
+		dirs = g_strsplit( SYSTEM_INDEX_DIRS, ":", -1 );
+#endif
+	if( output == NULL || dirs == NULL )
+	{
+		g_printerr( "No %s to index\n", output == NULL ? "output directory" : "directories" );
+		g_free( output );
+		g_strfreev( dirs );
+		return EXIT_FAILURE;
+	}
+
+	/* an index up to date is kept as it is */
+	index = gr_path_index_new_for_dirs( (const gchar* const*)dirs, output );
+	if( !gr_path_index_get_stored( index ) )
+		ret = EXIT_FAILURE;
+
+	if( stats )
+	{
+		index_stats = g_variant_ref_sink( gr_path_index_get_stats( index ) );
+		text = gr_stats_format( index_stats, FALSE );
+		g_print( "%s", text );
+		g_free( text );
+		g_variant_unref( index_stats );
+	}
+
+	g_object_unref( G_OBJECT( index ) );
+	g_free( output );
+	g_strfreev( dirs );
+
+	return ret;
+}
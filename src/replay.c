@@ -0,0 +1,473 @@
+#include "config.h"
+#include "grapplication.h"
+#include "grhistogram.h"
+#include "grstats.h"
+#include "grwindow.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gtk/gtk.h>
+#include <locale.h>
+#include <stdlib.h>
+
+#define REPLAY_DISPLAY ":5"
+#define REPLAY_KEYS "f\\t\\tfa\\t\\tfab\\b\\b\\t"
+#define REPLAY_ALPHABET_SIZE 26
+
+/* waits for broadwayd to listen, 50 ms at a time */
+#define REPLAY_DISPLAY_ATTEMPTS 100
+#define REPLAY_DISPLAY_INTERVAL 50000
+
+/* a scenario typing the keys into a window listing a number of commands */
+struct _GrReplay
+{
+	const gchar *keys;
+	const gchar *next;
+	gboolean eager_list; /* the list is built before the first frame */
+	guint idle_id;
+	gboolean started;
+	gint64 run_time; /* of the application */
+	gint64 first_frame; /* time from the application run to the first frame */
+	gint64 start; /* of the key not painted yet, 0 if none */
+	gchar *key;
+	gboolean is_list; /* the key went to the list */
+	GrHistogram *entry_latency;
+	GrHistogram *list_latency;
+	GVariantBuilder steps;
+
+	GrWindow *window;
+	GdkFrameClock *clock;
+};
+typedef struct _GrReplay GrReplay;
+
+static void
+remove_dir(
+	const gchar *path )
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *child;
+
+	dir = g_dir_open( path, 0, NULL );
+	if( dir != NULL )
+	{
+		while( ( name = g_dir_read_name( dir ) ) != NULL )
+		{
+			child = g_build_filename( path, name, NULL );
+			if( g_file_test( child, G_FILE_TEST_IS_DIR ) && !g_file_test( child, G_FILE_TEST_IS_SYMLINK ) )
+				remove_dir( child );
+			else
+				g_remove( child );
+			g_free( child );
+		}
+		g_dir_close( dir );
+	}
+	g_rmdir( path );
+}
+
+/*
+ * Fills the directory with n empty binaries named by three letters and a number, so every typed
+ * letter divides the completions by the size of the alphabet: "f" completes to n/26 of them,
+ * "fa" to n/676 and so on.
+ */
+static gboolean
+fill_bin_dir(
+	const gchar *bin_dir,
+	guint n )
+{
+	gchar *name, *path;
+	guint i;
+	gboolean ret = TRUE;
+
+	if( g_mkdir( bin_dir, 0755 ) != 0 )
+		return FALSE;
+
+	for( i = 0; i < n && ret; ++i )
+	{
+		name = g_strdup_printf( "%c%c%c%u",
+			'a' + i % REPLAY_ALPHABET_SIZE,
+			'a' + i / REPLAY_ALPHABET_SIZE % REPLAY_ALPHABET_SIZE,
+			'a' + i / ( REPLAY_ALPHABET_SIZE * REPLAY_ALPHABET_SIZE ) % REPLAY_ALPHABET_SIZE,
+			i );
+		path = g_build_filename( bin_dir, name, NULL );
+		ret = g_file_set_contents( path, "", 0, NULL ) && g_chmod( path, 0755 ) == 0;
+		g_free( path );
+		g_free( name );
+	}
+
+	return ret;
+}
+
+/* the time from every key to its frame, the window is closed and the application quits */
+static void
+replay_finish(
+	GrReplay *replay )
+{
+	replay->keys = NULL;
+	gtk_window_destroy( GTK_WINDOW( replay->window ) );
+}
+
+/* types the next key when idle, as a human would do between frames */
+static gboolean
+on_replay_idle(
+	gpointer user_data )
+{
+	GrReplay *replay = (GrReplay*)user_data;
+	const gchar *next;
+
+	replay->idle_id = 0;
+
+	if( *replay->next == '\0' )
+	{
+		replay_finish( replay );
+		return G_SOURCE_REMOVE;
+	}
+
+	next = g_utf8_next_char( replay->next );
+	replay->key = g_strndup( replay->next, (gsize)( next - replay->next ) );
+	replay->next = next;
+	replay->start = g_get_monotonic_time();
+	replay->is_list = gr_window_type_key( replay->window, replay->key );
+
+	/* a key changing nothing is painted too */
+	gtk_widget_queue_draw( GTK_WIDGET( replay->window ) );
+
+	return G_SOURCE_REMOVE;
+}
+
+/* the first key is typed after the first frame, the next one after the frame of the previous one */
+static void
+on_replay_after_paint(
+	GdkFrameClock *clock,
+	gpointer user_data )
+{
+	GrReplay *replay = (GrReplay*)user_data;
+	GVariantBuilder builder;
+	gint64 elapsed;
+
+	if( replay->keys == NULL )
+		return;
+
+	if( replay->start == 0 )
+	{
+		if( !replay->started )
+		{
+			replay->started = TRUE;
+			replay->first_frame = g_get_monotonic_time() - replay->run_time;
+			replay->idle_id = g_idle_add( on_replay_idle, replay );
+		}
+		return;
+	}
+
+	elapsed = g_get_monotonic_time() - replay->start;
+	replay->start = 0;
+	gr_histogram_record( replay->is_list ? replay->list_latency : replay->entry_latency, elapsed );
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "key", g_variant_new_take_string( g_steal_pointer( &replay->key ) ) );
+	g_variant_builder_add( &builder, "{sv}", "path", g_variant_new_string( replay->is_list ? "list" : "entry" ) );
+	g_variant_builder_add( &builder, "{sv}", "items", g_variant_new_uint32( replay->is_list ? gr_window_get_n_list_items( replay->window ) : 0 ) );
+	g_variant_builder_add( &builder, "{sv}", "time", g_variant_new_int64( elapsed ) );
+	g_variant_builder_add_value( &replay->steps, g_variant_builder_end( &builder ) );
+
+	if( replay->idle_id == 0 )
+		replay->idle_id = g_idle_add( on_replay_idle, replay );
+}
+
+static void
+on_window_map(
+	GtkWidget *widget,
+	gpointer user_data )
+{
+	GrReplay *replay = (GrReplay*)user_data;
+
+	g_signal_handlers_disconnect_by_func( widget, on_window_map, replay );
+
+	/* the first frame pays for the list instead of the first Tab */
+	if( replay->eager_list )
+		gr_window_build_list( replay->window );
+
+	replay->clock = g_object_ref( gtk_widget_get_frame_clock( widget ) );
+	g_signal_connect( G_OBJECT( replay->clock ), "after-paint", G_CALLBACK( on_replay_after_paint ), replay );
+}
+
+static void
+on_window_destroy(
+	GtkWidget *widget,
+	gpointer user_data )
+{
+	GrReplay *replay = (GrReplay*)user_data;
+
+	g_clear_handle_id( &replay->idle_id, g_source_remove );
+	if( replay->clock != NULL )
+	{
+		g_signal_handlers_disconnect_by_func( replay->clock, on_replay_after_paint, replay );
+		g_clear_object( &replay->clock );
+	}
+	replay->window = NULL;
+}
+
+static void
+on_window_added(
+	GtkApplication *app,
+	GtkWindow *window,
+	gpointer user_data )
+{
+	GrReplay *replay = (GrReplay*)user_data;
+
+	if( !GR_IS_WINDOW( window ) || replay->window != NULL )
+		return;
+
+	replay->window = GR_WINDOW( window );
+	g_signal_connect( G_OBJECT( window ), "map", G_CALLBACK( on_window_map ), replay );
+	g_signal_connect( G_OBJECT( window ), "destroy", G_CALLBACK( on_window_destroy ), replay );
+}
+
+/* runs a window of its own listing the binaries of bin_dir, NULL if the keys are not all typed */
+static GVariant*
+replay_scenario(
+	const gchar *keys,
+	const gchar *bin_dir,
+	guint n_commands,
+	gboolean eager_list )
+{
+	gchar *app_argv[] = { PROGRAM_NAME, "--no-config", "--no-history", NULL };
+
+	GrApplication *app;
+	GrReplay replay;
+	GVariantBuilder builder;
+	GVariant *steps;
+	gboolean typed;
+
+	g_setenv( PROGRAM_ENVIRONMENT_PATH, bin_dir, TRUE );
+
+	replay.keys = keys;
+	replay.next = keys;
+	replay.eager_list = eager_list;
+	replay.idle_id = 0;
+	replay.started = FALSE;
+	replay.run_time = 0;
+	replay.first_frame = 0;
+	replay.start = 0;
+	replay.key = NULL;
+	replay.is_list = FALSE;
+	replay.entry_latency = gr_histogram_new();
+	replay.list_latency = gr_histogram_new();
+	g_variant_builder_init( &replay.steps, G_VARIANT_TYPE( "aa{sv}" ) );
+	replay.window = NULL;
+	replay.clock = NULL;
+
+	/* the keys are typed into a window of its own, not into a running instance */
+	app = gr_application_new( PROGRAM_APP_ID );
+	g_application_set_flags( G_APPLICATION( app ), g_application_get_flags( G_APPLICATION( app ) ) | G_APPLICATION_NON_UNIQUE );
+	g_signal_connect( G_OBJECT( app ), "window-added", G_CALLBACK( on_window_added ), &replay );
+	replay.run_time = g_get_monotonic_time();
+	g_application_run( G_APPLICATION( app ), G_N_ELEMENTS( app_argv ) - 1, app_argv );
+	g_object_unref( G_OBJECT( app ) );
+
+	/* the window was closed before the keys were all typed */
+	typed = replay.keys == NULL;
+
+	steps = g_variant_builder_end( &replay.steps );
+	if( !typed )
+	{
+		g_variant_unref( g_variant_ref_sink( steps ) );
+		gr_histogram_free( replay.entry_latency );
+		gr_histogram_free( replay.list_latency );
+		g_free( replay.key );
+		return NULL;
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "commands", g_variant_new_uint32( n_commands ) );
+	g_variant_builder_add( &builder, "{sv}", "eager-list", g_variant_new_boolean( eager_list ) );
+	g_variant_builder_add( &builder, "{sv}", "first-frame", g_variant_new_int64( replay.first_frame ) );
+	g_variant_builder_add( &builder, "{sv}", "entry", gr_histogram_get_stats( replay.entry_latency ) );
+	g_variant_builder_add( &builder, "{sv}", "list", gr_histogram_get_stats( replay.list_latency ) );
+	g_variant_builder_add( &builder, "{sv}", "keys", steps );
+
+	gr_histogram_free( replay.entry_latency );
+	gr_histogram_free( replay.list_latency );
+	g_free( replay.key );
+
+	return g_variant_builder_end( &builder );
+}
+
+/* starts broadwayd on the display and waits for it to accept clients */
+static GSubprocess*
+start_broadway(
+	const gchar *display_name )
+{
+	GSubprocess *broadwayd;
+	GdkDisplay *display = NULL;
+	guint i;
+	GError *error = NULL;
+
+	broadwayd = g_subprocess_new( G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_SILENCE, &error, "broadwayd", display_name, NULL );
+	if( broadwayd == NULL )
+	{
+		g_printerr( "%s\n", error->message );
+		g_error_free( error );
+		return NULL;
+	}
+
+	g_setenv( "GDK_BACKEND", "broadway", TRUE );
+	g_setenv( "BROADWAY_DISPLAY", display_name, TRUE );
+
+	for( i = 0; i < REPLAY_DISPLAY_ATTEMPTS && display == NULL; ++i )
+	{
+		g_usleep( REPLAY_DISPLAY_INTERVAL );
+		display = gdk_display_open( display_name );
+	}
+
+	if( display == NULL || !gtk_init_check() )
+	{
+		g_printerr( "Cannot connect to broadwayd on %s\n", display_name );
+		g_subprocess_force_exit( broadwayd );
+		g_object_unref( G_OBJECT( broadwayd ) );
+		return NULL;
+	}
+	gdk_display_close( display );
+
+	return broadwayd;
+}
+
+/*
+ * Types the keys into windows listing more and more binaries on the headless Broadway backend
+ * of GDK and prints the time from every key to the frame painting it, so the cost of relayout,
+ * list rebinding and text shaping is measured against the number of completions on any machine.
+ */
+int
+main(
+	int argc,
+	char *argv[] )
+{
+	gchar *display_name = NULL, *keys = NULL;
+	GStrv commands = NULL;
+	gchar *default_commands[] = { "10", "1000", "10000", NULL };
+	gboolean eager_list = FALSE;
+
+	const GOptionEntry option_entries[] =
+	{
+		{ "display", 'd', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &display_name, "Display of broadwayd, " REPLAY_DISPLAY " by default", "DISPLAY" },
+		{ "keys", 'k', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &keys, "Keys to type, \\t is Tab and \\b is BackSpace, " REPLAY_KEYS " by default", "KEYS" },
+		{ "eager-list", 'e', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &eager_list, "Build the list before the first frame instead of when idle after it", NULL },
+		{ "commands", 'n', G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING_ARRAY, &commands, "Number of binaries of a scenario, repeated for every scenario, 10, 1000 and 10000 by default", "N" },
+		{ NULL }
+	};
+
+	GOptionContext *context;
+	GSubprocess *broadwayd;
+	GVariantBuilder builder, scenarios;
+	GVariant *stats, *scenario;
+	gchar *compressed, *tmp_dir, *bin_dir, *text;
+	const gchar* const *counts;
+	guint64 n;
+	guint i;
+	gint ret = EXIT_SUCCESS;
+	GError *error = NULL;
+
+	setlocale( LC_ALL, "" );
+
+	context = g_option_context_new( NULL );
+	g_option_context_set_summary( context, "Measure the time " PROGRAM_NAME " takes to paint every typed key." );
+	g_option_context_set_description( context, "The keys are typed into a window on a broadwayd of its own, once for every number of binaries in $" PROGRAM_ENVIRONMENT_PATH ". Nothing is launched." );
+	g_option_context_add_main_entries( context, option_entries, NULL );
+	if( !g_option_context_parse( context, &argc, &argv, &error ) )
+	{
+		g_printerr( "%s\n", error->message );
+		g_error_free( error );
+		g_option_context_free( context );
+		return EXIT_FAILURE;
+	}
+	g_option_context_free( context );
+
+	counts = commands != NULL ? (const gchar* const*)commands : (const gchar* const*)default_commands;
+	for( i = 0; counts[i] != NULL; ++i )
+		if( !g_ascii_string_to_unsigned( counts[i], 10, 0, G_MAXUINT, &n, &error ) )
+		{
+			g_printerr( "%s\n", error->message );
+			g_error_free( error );
+			g_free( display_name );
+			g_free( keys );
+			g_strfreev( commands );
+			return EXIT_FAILURE;
+		}
+
+	tmp_dir = g_dir_make_tmp( PROGRAM_NAME "-replay-XXXXXX", &error );
+	if( tmp_dir == NULL )
+	{
+		g_printerr( "%s\n", error->message );
+		g_error_free( error );
+		g_free( display_name );
+		g_free( keys );
+		g_strfreev( commands );
+		return EXIT_FAILURE;
+	}
+
+	/* nothing of the user is read, the runtime directory is kept for the socket of broadwayd */
+	g_setenv( "XDG_CACHE_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_CONFIG_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_DATA_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_DATA_DIRS", tmp_dir, TRUE );
+
+	broadwayd = start_broadway( display_name != NULL ? display_name : REPLAY_DISPLAY );
+	if( broadwayd == NULL )
+	{
+		remove_dir( tmp_dir );
+		g_free( tmp_dir );
+		g_free( display_name );
+		g_free( keys );
+		g_strfreev( commands );
+		return EXIT_FAILURE;
+	}
+
+	compressed = g_strcompress( keys != NULL ? keys : REPLAY_KEYS );
+
+	g_variant_builder_init( &scenarios, G_VARIANT_TYPE( "aa{sv}" ) );
+	for( i = 0; counts[i] != NULL && ret == EXIT_SUCCESS; ++i )
+	{
+		g_ascii_string_to_unsigned( counts[i], 10, 0, G_MAXUINT, &n, NULL );
+
+		/* a directory of every scenario, the index stored for another one is not reused */
+		bin_dir = g_strdup_printf( "%s/bin-%u", tmp_dir, i );
+		if( !fill_bin_dir( bin_dir, (guint)n ) )
+		{
+			g_printerr( "Cannot create %" G_GUINT64_FORMAT " binaries in %s\n", n, bin_dir );
+			ret = EXIT_FAILURE;
+		}
+		else if( ( scenario = replay_scenario( compressed, bin_dir, (guint)n, eager_list ) ) == NULL )
+		{
+			g_printerr( "The window of %" G_GUINT64_FORMAT " binaries was closed before the keys were typed\n", n );
+			ret = EXIT_FAILURE;
+		}
+		else
+			g_variant_builder_add_value( &scenarios, scenario );
+		g_free( bin_dir );
+	}
+
+	g_variant_builder_init( &builder, G_VARIANT_TYPE_VARDICT );
+	g_variant_builder_add( &builder, "{sv}", "keys", g_variant_new_string( keys != NULL ? keys : REPLAY_KEYS ) );
+	g_variant_builder_add( &builder, "{sv}", "scenarios", g_variant_builder_end( &scenarios ) );
+	stats = g_variant_ref_sink( g_variant_builder_end( &builder ) );
+	if( ret == EXIT_SUCCESS )
+	{
+		text = gr_stats_format( stats, TRUE );
+		g_print( "%s", text );
+		g_free( text );
+	}
+	g_variant_unref( stats );
+
+	g_subprocess_force_exit( broadwayd );
+	g_object_unref( G_OBJECT( broadwayd ) );
+	remove_dir( tmp_dir );
+	g_free( tmp_dir );
+	g_free( compressed );
+	g_free( display_name );
+	g_free( keys );
+	g_strfreev( commands );
+
+	return ret;
+}
@@ -0,0 +1,158 @@
+#include "config.h"
+#include "grcommandlist.h"
+
+#include <glib-object.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALLOCATIONS_ROUNDS 1000
+
+extern void* __libc_malloc( size_t size );
+extern void* __libc_calloc( size_t n, size_t size );
+extern void* __libc_realloc( void *ptr, size_t size );
+
+/* only the allocations of the thread typing are counted, the other threads load and monitor */
+static _Thread_local gboolean counting = FALSE;
+static _Thread_local guint n_allocations = 0;
+
+void*
+malloc(
+	size_t size )
+{
+	if( counting )
+		++n_allocations;
+
+	return __libc_malloc( size );
+}
+
+void*
+calloc(
+	size_t n,
+	size_t size )
+{
+	if( counting )
+		++n_allocations;
+
+	return __libc_calloc( n, size );
+}
+
+void*
+realloc(
+	void *ptr,
+	size_t size )
+{
+	if( counting )
+		++n_allocations;
+
+	return __libc_realloc( ptr, size );
+}
+
+static void
+remove_dir(
+	const gchar *path )
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *child;
+
+	dir = g_dir_open( path, 0, NULL );
+	if( dir != NULL )
+	{
+		while( ( name = g_dir_read_name( dir ) ) != NULL )
+		{
+			child = g_build_filename( path, name, NULL );
+			if( g_file_test( child, G_FILE_TEST_IS_DIR ) && !g_file_test( child, G_FILE_TEST_IS_SYMLINK ) )
+				remove_dir( child );
+			else
+				g_remove( child );
+			g_free( child );
+		}
+		g_dir_close( dir );
+	}
+	g_rmdir( path );
+}
+
+/*
+ * Types the prefixes of commands of the history and of $PATH like GrEntry does and counts the
+ * heap allocations of their completion, the first round maps the shards and builds the indexes.
+ */
+int
+main(
+	int argc,
+	char *argv[] )
+{
+	const gchar *commands[] = { "firefox", "find", "fish", "gimp", "git", NULL };
+	const gchar *history[] = { "firefox --private-window", "git status", "gimp", NULL };
+	const gchar *prefixes[] = { "f", "fi", "fin", "g", "gi", "git", "x", NULL };
+
+	GrCommandList *com_list;
+	const gchar *match;
+	gchar *tmp_dir, *bin_dir, *path;
+	gsize match_len;
+	guint i, round;
+	gint ret = EXIT_SUCCESS;
+	GError *error = NULL;
+
+	tmp_dir = g_dir_make_tmp( PROGRAM_NAME "-allocations-XXXXXX", &error );
+	if( tmp_dir == NULL )
+	{
+		g_printerr( "%s\n", error->message );
+		g_error_free( error );
+		return EXIT_FAILURE;
+	}
+
+	/* nothing of the user is read */
+	g_setenv( "XDG_CACHE_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_CONFIG_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_DATA_HOME", tmp_dir, TRUE );
+	g_setenv( "XDG_DATA_DIRS", tmp_dir, TRUE );
+
+	bin_dir = g_build_filename( tmp_dir, "bin", NULL );
+	g_mkdir( bin_dir, 0755 );
+	for( i = 0; commands[i] != NULL; ++i )
+	{
+		path = g_build_filename( bin_dir, commands[i], NULL );
+		g_file_set_contents( path, "", 0, NULL );
+		g_chmod( path, 0755 );
+		g_free( path );
+	}
+	g_setenv( PROGRAM_ENVIRONMENT_PATH, bin_dir, TRUE );
+
+	path = g_build_filename( tmp_dir, PROGRAM_HISTORY_FILE, NULL );
+	com_list = gr_command_list_new( path, 0, FALSE );
+	g_free( path );
+	for( i = 0; history[i] != NULL; ++i )
+		gr_command_list_push( com_list, history[i] );
+
+	for( round = 0; round <= ALLOCATIONS_ROUNDS; ++round )
+	{
+		counting = round > 0;
+		for( i = 0; prefixes[i] != NULL; ++i )
+			if( !gr_command_list_lookup_compared_string( com_list, prefixes[i], strlen( prefixes[i] ), &match, &match_len ) )
+				ret = EXIT_FAILURE;
+		counting = FALSE;
+	}
+
+	/* the history wins over $PATH */
+	gr_command_list_lookup_compared_string( com_list, "fi", 2, &match, &match_len );
+	if( g_strcmp0( match, "firefox --private-window" ) != 0 )
+	{
+		g_printerr( "fi is completed to %s\n", match != NULL ? match : "nothing" );
+		ret = EXIT_FAILURE;
+	}
+
+	if( n_allocations > 0 )
+	{
+		g_printerr( "%u allocations in %u lookups\n", n_allocations, ALLOCATIONS_ROUNDS * (guint)( G_N_ELEMENTS( prefixes ) - 1 ) );
+		ret = EXIT_FAILURE;
+	}
+
+	g_object_unref( G_OBJECT( com_list ) );
+	remove_dir( tmp_dir );
+	g_free( bin_dir );
+	g_free( tmp_dir );
+
+	return ret;
+}